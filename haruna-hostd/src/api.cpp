@@ -0,0 +1,327 @@
+#include "api.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "hostd.h"
+#include "websocket.h"
+
+#define API_MAX_LINE 4096
+#define API_MAX_OUT (1u << 20) // a client that stops reading is dropped
+
+api_server::~api_server()
+{
+    for (auto &kv : clients_)
+        close(kv.first);
+    if (unix_fd_ >= 0)
+    {
+        close(unix_fd_);
+        unlink(unix_path_.c_str());
+    }
+    if (ws_fd_ >= 0)
+        close(ws_fd_);
+}
+
+bool api_server::init(int epfd)
+{
+    epfd_ = epfd;
+    return epfd_ >= 0;
+}
+
+static bool watch_fd(int epfd, int op, int fd, uint32_t events)
+{
+    epoll_event ev = {};
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(epfd, op, fd, &ev) == 0;
+}
+
+bool api_server::listen_unix(const std::string &path)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        return false;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+    unlink(path.c_str()); // stale socket of a previous run
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0 ||
+        !watch_fd(epfd_, EPOLL_CTL_ADD, fd, EPOLLIN))
+    {
+        close(fd);
+        return false;
+    }
+    unix_fd_ = fd;
+    unix_path_ = path;
+    return true;
+}
+
+bool api_server::listen_ws(const std::string &host, uint16_t port, const std::string &origin)
+{
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.empty() ? "127.0.0.1" : host.c_str(), &addr.sin_addr) != 1)
+        return false;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0 ||
+        !watch_fd(epfd_, EPOLL_CTL_ADD, fd, EPOLLIN))
+    {
+        close(fd);
+        return false;
+    }
+    ws_fd_ = fd;
+    origin_ = origin;
+    return true;
+}
+
+bool api_server::owns(int fd) const
+{
+    return fd == unix_fd_ || fd == ws_fd_ || clients_.count(fd) != 0;
+}
+
+void api_server::handle(int fd, uint32_t events)
+{
+    if (fd == unix_fd_ || fd == ws_fd_)
+    {
+        accept_on(fd, fd == ws_fd_);
+        return;
+    }
+
+    auto it = clients_.find(fd);
+    if (it == clients_.end())
+        return;
+    api_client &c = it->second;
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        read_from(c);
+    if (!c.closing && (events & EPOLLOUT))
+        flush(c);
+    if (c.closing)
+    {
+        flush(c); // close frame / error reply, best effort
+        drop(fd);
+    }
+}
+
+void api_server::accept_on(int listen_fd, bool ws)
+{
+    while (true)
+    {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+        if (!watch_fd(epfd_, EPOLL_CTL_ADD, fd, EPOLLIN))
+        {
+            close(fd);
+            continue;
+        }
+        api_client &c = clients_[fd];
+        c.fd = fd;
+        c.id = next_id_++;
+        c.ws = ws;
+        c.upgraded = !ws;
+        c.name = "client" + std::to_string(c.id);
+    }
+}
+
+// pages served from this machine, or no page at all (scripts, curl)
+static bool local_origin(const std::string &origin)
+{
+    if (origin.empty())
+        return true;
+    size_t scheme = origin.find("://");
+    if (scheme == std::string::npos)
+        return false;
+    std::string host = origin.substr(scheme + 3);
+    host = host.substr(0, host.find(':'));
+    return host == "localhost" || host == "127.0.0.1" || host == "[::1]";
+}
+
+void api_server::read_from(api_client &c)
+{
+    char buf[4096];
+    while (true)
+    {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR))
+            break;
+        if (n <= 0)
+        {
+            c.closing = true;
+            c.out.clear();
+            return;
+        }
+        c.in.append(buf, (size_t)n);
+    }
+
+    if (!c.ws)
+    {
+        lines_from(c, c.in);
+        return;
+    }
+
+    if (!c.upgraded)
+    {
+        size_t end = c.in.find("\r\n\r\n");
+        if (end == std::string::npos)
+        {
+            if (c.in.size() > API_MAX_LINE)
+                c.closing = true;
+            return;
+        }
+        std::string request = c.in.substr(0, end + 4);
+        c.in.erase(0, end + 4);
+
+        std::string origin = http_header(request, "Origin");
+        bool allowed = origin_.empty() ? local_origin(origin) : origin == origin_;
+        std::string response = allowed ? ws_handshake(request) : "";
+        if (response.empty())
+        {
+            c.out = "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n";
+            c.closing = true;
+            return;
+        }
+        c.out += response;
+        c.upgraded = true;
+        flush(c);
+    }
+
+    while (!c.closing)
+    {
+        ws_frame frame;
+        ssize_t used = ws_parse(c.in, frame);
+        if (used == 0)
+            break;
+        if (used < 0 || !frame.fin)
+        {
+            // fragmented messages are not needed for single lines
+            c.out += ws_encode(WS_OP_CLOSE, std::string("\x03\xEA", 2)); // 1002
+            c.closing = true;
+            break;
+        }
+        c.in.erase(0, (size_t)used);
+
+        switch (frame.opcode)
+        {
+        case WS_OP_TEXT:
+            frame.payload.push_back('\n');
+            lines_from(c, frame.payload);
+            break;
+        case WS_OP_PING:
+            c.out += ws_encode(WS_OP_PONG, frame.payload);
+            flush(c);
+            break;
+        case WS_OP_CLOSE:
+            c.out += ws_encode(WS_OP_CLOSE, "");
+            c.closing = true;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void api_server::lines_from(api_client &c, std::string &buf)
+{
+    size_t start = 0;
+    size_t nl;
+    while (!c.closing && (nl = buf.find('\n', start)) != std::string::npos)
+    {
+        std::string line = buf.substr(start, nl - start);
+        start = nl + 1;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty() && on_line)
+            on_line(c, line);
+    }
+    buf.erase(0, start);
+    if (buf.size() > API_MAX_LINE)
+        c.closing = true;
+}
+
+void api_server::send(api_client &c, const std::string &line)
+{
+    if (c.closing || !c.upgraded)
+        return;
+    if (c.ws)
+        c.out += ws_encode(WS_OP_TEXT, line);
+    else
+        c.out += line + "\n";
+
+    if (c.out.size() > API_MAX_OUT)
+    {
+        log_error("%s: not reading, dropped", c.name.c_str());
+        c.out.clear();
+        c.closing = true;
+        shutdown(c.fd, SHUT_RDWR); // wakes the loop for this fd
+        return;
+    }
+    flush(c);
+}
+
+void api_server::flush(api_client &c)
+{
+    while (!c.out.empty())
+    {
+        ssize_t n = ::send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                break;
+            c.out.clear();
+            c.closing = true;
+            shutdown(c.fd, SHUT_RDWR);
+            return;
+        }
+        c.out.erase(0, (size_t)n);
+    }
+    bool want = !c.out.empty();
+    if (want != c.want_out)
+    {
+        c.want_out = want;
+        watch_fd(epfd_, EPOLL_CTL_MOD, c.fd, want ? EPOLLIN | EPOLLOUT : EPOLLIN);
+    }
+}
+
+void api_server::for_each(const std::function<void(api_client &)> &fn)
+{
+    for (auto &kv : clients_)
+        fn(kv.second);
+}
+
+api_client *api_server::find(int id)
+{
+    for (auto &kv : clients_)
+    {
+        if (kv.second.id == id)
+            return &kv.second;
+    }
+    return nullptr;
+}
+
+void api_server::drop(int fd)
+{
+    auto it = clients_.find(fd);
+    if (it == clients_.end())
+        return;
+    if (on_close)
+        on_close(it->second);
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    clients_.erase(it);
+}
@@ -0,0 +1,67 @@
+#ifndef API_H
+#define API_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <string>
+
+// Client connections: a Unix stream socket for local tools and a WebSocket
+// listener for the web UI. Both carry the same text protocol, one command or
+// reply per line (one line per text message on WebSocket), see README.md.
+struct api_client
+{
+    int fd = -1;
+    int id = 0;
+    bool ws = false;       // accepted on the WebSocket listener
+    bool upgraded = false; // handshake done
+    bool closing = false;
+    bool want_out = false; // EPOLLOUT armed
+    std::string in;
+    std::string out;
+
+    // set with "hello"
+    std::string name;
+    int priority = 0;
+    bool watch = false; // slave frames are forwarded
+};
+
+class api_server
+{
+public:
+    std::function<void(api_client &c, const std::string &line)> on_line;
+    std::function<void(api_client &c)> on_close;
+
+    ~api_server();
+
+    bool init(int epfd);
+    bool listen_unix(const std::string &path);
+    // host "" = loopback; origin "" = pages served from localhost only
+    bool listen_ws(const std::string &host, uint16_t port, const std::string &origin);
+
+    bool owns(int fd) const;
+    void handle(int fd, uint32_t events);
+
+    void send(api_client &c, const std::string &line);
+    void for_each(const std::function<void(api_client &)> &fn);
+    api_client *find(int id);
+    size_t count() const { return clients_.size(); }
+
+private:
+    void accept_on(int listen_fd, bool ws);
+    void read_from(api_client &c);
+    void flush(api_client &c);
+    void drop(int fd);
+    void lines_from(api_client &c, std::string &buf);
+
+    int epfd_ = -1;
+    int unix_fd_ = -1;
+    int ws_fd_ = -1;
+    int next_id_ = 1;
+    std::string unix_path_;
+    std::string origin_;
+    std::map<int, api_client> clients_; // by fd
+};
+
+#endif // API_H
@@ -0,0 +1,41 @@
+#ifndef HOSTD_H
+#define HOSTD_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+
+#include "boardlink.h"
+
+#define FRAME_LEN BOARDLINK_FRAME_LEN
+#define CONTROLLERS BOARDLINK_MAX_CONTROLLERS
+
+// Frame plus the low bytes of LX, LY, RX, RY (boardlink_axis16), all zero
+// for a plain 8 bit frame. The daemon keeps every frame in this form.
+#define FRAME16_LEN (FRAME_LEN + 4)
+
+// Nothing pressed, D-Pad released, sticks centered.
+static const uint8_t NEUTRAL_FRAME[FRAME16_LEN] = {0, 0, 0x0F, 128, 128, 128, 128, 0, 0, 0, 0};
+
+// Daemon clock: CLOCK_MONOTONIC. Frames are scheduled and reported in it.
+static inline uint64_t mono_ns(void)
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t mono_us(void)
+{
+    return mono_ns() / 1000u;
+}
+
+void log_info(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void log_error(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+std::string to_hex(const uint8_t *data, size_t len);
+// exactly len bytes of hex, false on anything else
+bool from_hex(const std::string &hex, uint8_t *out, size_t len);
+
+#endif // HOSTD_H
@@ -0,0 +1,661 @@
+#include <errno.h>
+#include <getopt.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "api.h"
+#include "hostd.h"
+#include "mux.h"
+#include "recording.h"
+#include "scheduler.h"
+#include "slave_link.h"
+
+#define HOUSEKEEPING_MS 50
+#define RECONNECT_MS 500
+// a quick burst after connecting, then a slow refresh to follow drift (same
+// as the web UI)
+#define SYNC_BURST 8
+#define SYNC_INTERVAL_MS 500
+
+// ---------- Logging / helpers ----------
+static void log_line(FILE *out, const char *level, const char *fmt, va_list ap)
+{
+    fprintf(out, "[%10.3f] %s", (double)mono_us() / 1e6, level);
+    vfprintf(out, fmt, ap);
+    fputc('\n', out);
+}
+
+void log_info(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    log_line(stdout, "", fmt, ap);
+    va_end(ap);
+    fflush(stdout);
+}
+
+void log_error(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    log_line(stderr, "error: ", fmt, ap);
+    va_end(ap);
+}
+
+std::string to_hex(const uint8_t *data, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < len; i++)
+    {
+        out.push_back(digits[data[i] >> 4]);
+        out.push_back(digits[data[i] & 15]);
+    }
+    return out;
+}
+
+bool from_hex(const std::string &hex, uint8_t *out, size_t len)
+{
+    if (hex.size() != len * 2)
+        return false;
+    for (size_t i = 0; i < len; i++)
+    {
+        char pair[3] = {hex[i * 2], hex[i * 2 + 1], 0};
+        char *end;
+        long v = strtol(pair, &end, 16);
+        if (*end)
+            return false;
+        out[i] = (uint8_t)v;
+    }
+    return true;
+}
+
+// 14 hex digits (8 bit frame) or 22 (frame + LX, LY, RX, RY low bytes)
+static bool parse_frame(const std::string &hex, uint8_t *out)
+{
+    memset(&out[FRAME_LEN], 0, FRAME16_LEN - FRAME_LEN);
+    return from_hex(hex, out, FRAME_LEN) || from_hex(hex, out, FRAME16_LEN);
+}
+
+// Short form while the low bytes are zero, so 8 bit clients see hex14.
+static std::string frame_hex(const uint8_t *frame)
+{
+    static const uint8_t no_lo[4] = {0, 0, 0, 0};
+    bool hires = memcmp(&frame[FRAME_LEN], no_lo, sizeof(no_lo)) != 0;
+    return to_hex(frame, hires ? FRAME16_LEN : FRAME_LEN);
+}
+
+static inline uint64_t ms_to_ns(double ms)
+{
+    return (uint64_t)(ms * 1e6);
+}
+
+// ---------- State ----------
+static slave_link slave;
+static scheduler timers;
+static api_server api;
+static controller_mux mux[CONTROLLERS];
+static uint8_t merged[CONTROLLERS][FRAME16_LEN];
+
+static std::string port_path = "/dev/ttyACM0";
+static int epfd = -1;
+static uint32_t slave_events = 0; // epoll interest of the slave port
+static int sync_burst = 0;
+
+// Recording playback on one controller, a source of its own next to the
+// client's live frame (mux key -client id).
+struct replay_run
+{
+    int client_id;
+    uint8_t controller;
+    std::vector<recording_sample> samples;
+    size_t next = 0;
+    uint64_t start_ns = 0;
+    uint64_t task = 0;
+};
+
+static std::map<std::pair<int, int>, replay_run> replays; // (client id, controller)
+static std::map<int, std::set<uint64_t>> client_tasks;    // pending "at" frames
+
+static void push(uint8_t c)
+{
+    uint8_t out[FRAME16_LEN];
+    if (!mux[c].merge(out))
+        return;
+    memcpy(merged[c], out, FRAME16_LEN);
+    slave.send_frame(c, out);
+}
+
+static void notify(int client_id, const std::string &line)
+{
+    api_client *cl = api.find(client_id);
+    if (cl)
+        api.send(*cl, line);
+}
+
+static int client_priority(int client_id)
+{
+    api_client *cl = api.find(client_id);
+    return cl ? cl->priority : 0;
+}
+
+// ---------- Replay ----------
+static void replay_step(int client_id, uint8_t c)
+{
+    auto it = replays.find(std::make_pair(client_id, (int)c));
+    if (it == replays.end())
+        return;
+    replay_run &r = it->second;
+
+    // samples closer together than the wakeup latency go out as one frame
+    uint64_t now = mono_ns();
+    int priority = client_priority(client_id);
+    while (r.next < r.samples.size() && r.start_ns + ms_to_ns(r.samples[r.next].time_ms) <= now)
+    {
+        // recordings are 8 bit
+        uint8_t frame[FRAME16_LEN] = {};
+        memcpy(frame, r.samples[r.next].frame, FRAME_LEN);
+        mux[c].set(-client_id, priority, frame);
+        r.next++;
+    }
+    push(c);
+
+    if (r.next < r.samples.size())
+    {
+        uint64_t due = r.start_ns + ms_to_ns(r.samples[r.next].time_ms);
+        r.task = timers.at(due, [client_id, c]()
+                           { replay_step(client_id, c); });
+        return;
+    }
+
+    // finished: the controller goes back to the live sources
+    replays.erase(it);
+    mux[c].remove(-client_id);
+    push(c);
+    notify(client_id, "ev replay_done " + std::to_string(c));
+}
+
+static void replay_stop(int client_id, int c)
+{
+    auto it = replays.find(std::make_pair(client_id, c));
+    if (it == replays.end())
+        return;
+    timers.cancel(it->second.task);
+    replays.erase(it);
+    mux[c].remove(-client_id);
+    push((uint8_t)c);
+}
+
+// ---------- Commands ----------
+static bool parse_controller(const std::string &s, uint8_t &c)
+{
+    char *end;
+    long v = strtol(s.c_str(), &end, 10);
+    if (s.empty() || *end || v < 0 || v >= CONTROLLERS)
+        return false;
+    c = (uint8_t)v;
+    return true;
+}
+
+// daemon clock ms, or +ms from now
+static bool parse_time(const std::string &s, uint64_t &ns)
+{
+    bool relative = !s.empty() && s[0] == '+';
+    char *end;
+    double ms = strtod(s.c_str() + (relative ? 1 : 0), &end);
+    if (s.empty() || *end || ms < 0)
+        return false;
+    ns = relative ? mono_ns() + ms_to_ns(ms) : ms_to_ns(ms);
+    return true;
+}
+
+static void command(api_client &cl, const std::string &line)
+{
+    std::istringstream ss(line);
+    std::vector<std::string> args;
+    for (std::string a; ss >> a;)
+        args.push_back(a);
+    if (args.empty())
+        return;
+
+    const std::string &cmd = args[0];
+    auto fail = [&](const char *why)
+    { api.send(cl, std::string("err ") + cmd + ": " + why); };
+    uint8_t c = 0;
+    uint8_t frame[FRAME16_LEN];
+
+    if (cmd == "hello")
+    {
+        if (args.size() > 1)
+            cl.name = args[1];
+        if (args.size() > 2)
+            cl.priority = atoi(args[2].c_str());
+        log_info("%s: client %d, priority %d", cl.name.c_str(), cl.id, cl.priority);
+        api.send(cl, "ok hello " + std::to_string(cl.id));
+    }
+    else if (cmd == "frame")
+    {
+        if (args.size() != 3 || !parse_controller(args[1], c) || !parse_frame(args[2], frame))
+            return fail("frame <controller> <14 or 22 hex digits>");
+        mux[c].set(cl.id, cl.priority, frame);
+        push(c);
+    }
+    else if (cmd == "at")
+    {
+        uint64_t due;
+        if (args.size() != 4 || !parse_time(args[1], due) || !parse_controller(args[2], c) ||
+            !parse_frame(args[3], frame))
+            return fail("at <ms|+ms> <controller> <14 or 22 hex digits>");
+
+        int id = cl.id;
+        std::vector<uint8_t> f(frame, frame + FRAME16_LEN);
+        auto task = std::make_shared<uint64_t>(0);
+        *task = timers.at(due, [id, c, f, task]()
+                          {
+                              client_tasks[id].erase(*task);
+                              mux[c].set(id, client_priority(id), f.data());
+                              push(c); });
+        client_tasks[id].insert(*task);
+        api.send(cl, "ok at " + std::to_string(*task));
+    }
+    else if (cmd == "cancel")
+    {
+        if (args.size() != 2)
+            return fail("cancel <id>");
+        uint64_t task = strtoull(args[1].c_str(), nullptr, 10);
+        if (!client_tasks[cl.id].erase(task))
+            return fail("no such task");
+        timers.cancel(task);
+        api.send(cl, "ok cancel");
+    }
+    else if (cmd == "replay")
+    {
+        uint64_t start = mono_ns();
+        if (args.size() < 3 || args.size() > 4 || !parse_controller(args[1], c) ||
+            (args.size() == 4 && !parse_time(args[3], start)))
+            return fail("replay <controller> <file> [ms|+ms]");
+
+        replay_run r;
+        std::string err;
+        if (!load_recording(args[2], r.samples, err))
+            return fail(err.c_str());
+        if (r.samples.empty())
+            return fail("empty recording");
+
+        replay_stop(cl.id, c);
+        r.client_id = cl.id;
+        r.controller = c;
+        r.start_ns = start;
+        int id = cl.id;
+        r.task = timers.at(start, [id, c]()
+                           { replay_step(id, c); });
+        char reply[96];
+        snprintf(reply, sizeof(reply), "ok replay %d %zu %.1f", c, r.samples.size(),
+                 r.samples.back().time_ms);
+        replays[std::make_pair(cl.id, (int)c)] = std::move(r);
+        api.send(cl, reply);
+    }
+    else if (cmd == "stop")
+    {
+        if (args.size() == 2 && !parse_controller(args[1], c))
+            return fail("stop [controller]");
+        for (int i = 0; i < CONTROLLERS; i++)
+        {
+            if (args.size() == 1 || i == c)
+                replay_stop(cl.id, i);
+        }
+        api.send(cl, "ok stop");
+    }
+    else if (cmd == "claim" || cmd == "release")
+    {
+        if (args.size() != 2 || !parse_controller(args[1], c))
+            return fail("claim|release <controller>");
+        mux[c].claim(cl.id, cl.priority, cmd == "claim");
+        push(c);
+        api.send(cl, "ok " + cmd);
+    }
+    else if (cmd == "get")
+    {
+        if (args.size() != 2 || !parse_controller(args[1], c))
+            return fail("get <controller>");
+        api.send(cl, "ok get " + std::to_string(c) + " " + frame_hex(merged[c]));
+    }
+    else if (cmd == "send")
+    {
+        // raw host -> slave frame: telemetry config, traces, stick paths ...
+        uint8_t payload[HOSTLINK_MAX_PAYLOAD];
+        uint8_t type;
+        size_t len = args.size() == 3 ? args[2].size() / 2 : 0;
+        if (args.size() != 3 || !from_hex(args[1], &type, 1) || len > HOSTLINK_MAX_PAYLOAD ||
+            !from_hex(args[2], payload, len))
+            return fail("send <type hex> <payload hex>");
+        if (!slave.send(type, payload, (uint8_t)len))
+            return fail("slave not connected");
+        api.send(cl, "ok send");
+    }
+    else if (cmd == "watch")
+    {
+        cl.watch = args.size() < 2 || args[1] != "off";
+        api.send(cl, std::string("ok watch ") + (cl.watch ? "on" : "off"));
+    }
+    else if (cmd == "clock")
+    {
+        char reply[128];
+        snprintf(reply, sizeof(reply), "ok clock %.3f %d %u %u", (double)mono_ns() / 1e6,
+                 slave.clock.synced() ? 1 : 0, slave.clock.offset_us, slave.clock.rtt_us);
+        api.send(cl, reply);
+    }
+    else if (cmd == "status")
+    {
+        // scheduling lateness since the previous status
+        uint64_t late_max_ns = timers.take_late_max();
+        char reply[160];
+        snprintf(reply, sizeof(reply), "ok status %d %s %zu %zu %.1f", slave.connected() ? 1 : 0,
+                 port_path.c_str(), api.count(), replays.size(), (double)late_max_ns / 1000.0);
+        api.send(cl, reply);
+    }
+    else
+    {
+        fail("unknown command");
+    }
+}
+
+static void client_closed(api_client &cl)
+{
+    auto tasks = client_tasks.find(cl.id);
+    if (tasks != client_tasks.end())
+    {
+        for (uint64_t task : tasks->second)
+            timers.cancel(task);
+        client_tasks.erase(tasks);
+    }
+    for (uint8_t c = 0; c < CONTROLLERS; c++)
+    {
+        replay_stop(cl.id, c);
+        mux[c].remove(cl.id);
+        push(c);
+    }
+    log_info("%s: gone", cl.name.c_str());
+}
+
+// ---------- Slave port ----------
+static void slave_watch(uint32_t events)
+{
+    if (events == slave_events)
+        return;
+    epoll_event ev = {};
+    ev.events = events;
+    ev.data.fd = slave.fd();
+    epoll_ctl(epfd, slave_events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, slave.fd(), &ev);
+    slave_events = events;
+}
+
+static void slave_lost(void)
+{
+    log_error("%s: lost", port_path.c_str());
+    epoll_ctl(epfd, EPOLL_CTL_DEL, slave.fd(), nullptr);
+    slave_events = 0;
+    slave.close();
+}
+
+static void slave_connect(void)
+{
+    if (!slave.open(port_path))
+        return;
+    log_info("%s: connected", port_path.c_str());
+    slave_watch(EPOLLIN);
+    sync_burst = SYNC_BURST;
+    // the slave starts out neutral, bring it up to date
+    for (uint8_t c = 0; c < CONTROLLERS; c++)
+    {
+        if (memcmp(merged[c], NEUTRAL_FRAME, FRAME16_LEN) != 0)
+            slave.send_frame(c, merged[c]);
+    }
+}
+
+static void slave_frame(uint8_t type, const uint8_t *payload, uint8_t len)
+{
+    char head[16];
+    snprintf(head, sizeof(head), "ev rx %02x ", type);
+    std::string line = head + to_hex(payload, len);
+    api.for_each([&](api_client &cl)
+                 {
+                     if (cl.watch)
+                         api.send(cl, line); });
+}
+
+static void slave_text(const std::string &text)
+{
+    log_info("slave: %s", text.c_str());
+    api.for_each([&](api_client &cl)
+                 {
+                     if (cl.watch)
+                         api.send(cl, "ev text " + text); });
+}
+
+static void housekeeping(void)
+{
+    static uint64_t last_try = 0;
+    static uint64_t last_sync = 0;
+    uint64_t now = mono_ns();
+
+    if (!slave.connected())
+    {
+        if (now - last_try >= ms_to_ns(RECONNECT_MS))
+        {
+            last_try = now;
+            slave_connect();
+        }
+        return;
+    }
+
+    uint64_t interval = sync_burst > 0 ? ms_to_ns(HOUSEKEEPING_MS) : ms_to_ns(SYNC_INTERVAL_MS);
+    if (now - last_sync >= interval)
+    {
+        last_sync = now;
+        if (sync_burst > 0)
+            sync_burst--;
+        slave.send_sync();
+    }
+}
+
+// ---------- MAIN ----------
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -p, --port PATH       slave CDC port (default /dev/ttyACM0)\n"
+            "  -s, --socket PATH     Unix socket (default $XDG_RUNTIME_DIR/haruna.sock)\n"
+            "  -w, --ws [HOST:]PORT  WebSocket listener, 0 = off (default 127.0.0.1:8765)\n"
+            "      --origin URL      only accept WebSocket pages from this origin\n"
+            "                        (default: pages served from localhost)\n"
+            "      --rt              SCHED_FIFO and locked memory for tighter timing\n",
+            argv0);
+}
+
+static void go_realtime(void)
+{
+    sched_param sp = {};
+    sp.sched_priority = 50;
+    if (sched_setscheduler(0, SCHED_FIFO, &sp) != 0)
+        log_error("SCHED_FIFO: %s (needs CAP_SYS_NICE)", strerror(errno));
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        log_error("mlockall: %s", strerror(errno));
+}
+
+int main(int argc, char **argv)
+{
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    std::string socket_path = std::string(runtime ? runtime : "/tmp") + "/haruna.sock";
+    std::string ws_host = "127.0.0.1";
+    int ws_port = 8765;
+    std::string origin;
+    bool realtime = false;
+
+    static const option options[] = {
+        {"port", required_argument, nullptr, 'p'},
+        {"socket", required_argument, nullptr, 's'},
+        {"ws", required_argument, nullptr, 'w'},
+        {"origin", required_argument, nullptr, 'o'},
+        {"rt", no_argument, nullptr, 'r'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:s:w:h", options, nullptr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            port_path = optarg;
+            break;
+        case 's':
+            socket_path = optarg;
+            break;
+        case 'w':
+        {
+            std::string v = optarg;
+            size_t colon = v.rfind(':');
+            if (colon != std::string::npos)
+            {
+                ws_host = v.substr(0, colon);
+                v = v.substr(colon + 1);
+            }
+            ws_port = atoi(v.c_str());
+            break;
+        }
+        case 'o':
+            origin = optarg;
+            break;
+        case 'r':
+            realtime = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    for (int c = 0; c < CONTROLLERS; c++)
+        memcpy(merged[c], NEUTRAL_FRAME, FRAME16_LEN);
+
+    // SIGINT / SIGTERM through the loop so the socket file gets removed
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+    int sig_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    int tick_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    itimerspec tick = {};
+    tick.it_interval.tv_nsec = HOUSEKEEPING_MS * 1000000L;
+    tick.it_value = tick.it_interval;
+    timerfd_settime(tick_fd, 0, &tick, nullptr);
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0 || sig_fd < 0 || tick_fd < 0 || !timers.init() || !api.init(epfd))
+    {
+        log_error("setup: %s", strerror(errno));
+        return 1;
+    }
+    for (int fd : {sig_fd, tick_fd, timers.fd()})
+    {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    if (!api.listen_unix(socket_path))
+    {
+        log_error("%s: %s", socket_path.c_str(), strerror(errno));
+        return 1;
+    }
+    log_info("listening on %s", socket_path.c_str());
+    if (ws_port > 0)
+    {
+        if (!api.listen_ws(ws_host, (uint16_t)ws_port, origin))
+        {
+            log_error("ws %s:%d: %s", ws_host.c_str(), ws_port, strerror(errno));
+            return 1;
+        }
+        log_info("websocket on %s:%d", ws_host.c_str(), ws_port);
+    }
+
+    api.on_line = command;
+    api.on_close = client_closed;
+    slave.on_frame = slave_frame;
+    slave.on_text = slave_text;
+    if (realtime)
+        go_realtime();
+    slave_connect();
+
+    bool running = true;
+    while (running)
+    {
+        epoll_event events[16];
+        int n = epoll_wait(epfd, events, 16, -1);
+        if (n < 0 && errno != EINTR)
+        {
+            log_error("epoll: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            int fd = events[i].data.fd;
+            uint32_t ev = events[i].events;
+            if (fd == timers.fd())
+            {
+                timers.run();
+            }
+            else if (fd == tick_fd)
+            {
+                uint64_t expirations;
+                (void)!read(tick_fd, &expirations, sizeof(expirations));
+                housekeeping();
+            }
+            else if (fd == sig_fd)
+            {
+                running = false;
+            }
+            else if (slave.connected() && fd == slave.fd())
+            {
+                bool ok = true;
+                if (ev & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    ok = slave.on_readable();
+                if (ok && (ev & EPOLLOUT))
+                    ok = slave.on_writable();
+                if (!ok)
+                    slave_lost();
+            }
+            else if (api.owns(fd))
+            {
+                api.handle(fd, ev);
+            }
+        }
+
+        if (slave.connected())
+            slave_watch(slave.want_write() ? EPOLLIN | EPOLLOUT : EPOLLIN);
+    }
+
+    log_info("bye");
+    return 0;
+}
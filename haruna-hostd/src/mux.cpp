@@ -0,0 +1,101 @@
+#include "mux.h"
+
+#include <string.h>
+
+controller_mux::source &controller_mux::get(int key, int priority)
+{
+    auto it = sources_.find(key);
+    if (it == sources_.end())
+    {
+        source s;
+        s.priority = priority;
+        s.claim = false;
+        s.seq = 0;
+        memcpy(s.frame, NEUTRAL_FRAME, FRAME16_LEN);
+        it = sources_.emplace(key, s).first;
+    }
+    it->second.priority = priority;
+    return it->second;
+}
+
+void controller_mux::set(int key, int priority, const uint8_t *frame)
+{
+    source &s = get(key, priority);
+    if (memcmp(s.frame, frame, FRAME16_LEN) == 0)
+        return;
+    memcpy(s.frame, frame, FRAME16_LEN);
+    s.seq = ++seq_;
+}
+
+void controller_mux::claim(int key, int priority, bool on)
+{
+    source &s = get(key, priority);
+    s.claim = on;
+    s.seq = ++seq_;
+}
+
+void controller_mux::remove(int key)
+{
+    sources_.erase(key);
+}
+
+bool controller_mux::merge(uint8_t *out)
+{
+    auto better = [](const source &s, const source *best)
+    {
+        return !best || s.priority > best->priority || (s.priority == best->priority && s.seq > best->seq);
+    };
+
+    const source *claimed = nullptr;
+    for (const auto &kv : sources_)
+    {
+        const source &s = kv.second;
+        if (s.claim && better(s, claimed))
+            claimed = &s;
+    }
+
+    if (claimed)
+    {
+        memcpy(out, claimed->frame, FRAME16_LEN);
+    }
+    else
+    {
+        memcpy(out, NEUTRAL_FRAME, FRAME16_LEN);
+        // D-Pad, left stick, right stick
+        const source *best[3] = {nullptr, nullptr, nullptr};
+        for (const auto &kv : sources_)
+        {
+            const source &s = kv.second;
+            out[0] |= s.frame[0];
+            out[1] |= s.frame[1];
+
+            bool off[3] = {
+                s.frame[2] != NEUTRAL_FRAME[2],
+                s.frame[3] != 128 || s.frame[4] != 128 || s.frame[7] || s.frame[8],
+                s.frame[5] != 128 || s.frame[6] != 128 || s.frame[9] || s.frame[10],
+            };
+            for (int i = 0; i < 3; i++)
+            {
+                if (off[i] && better(s, best[i]))
+                    best[i] = &s;
+            }
+        }
+        if (best[0])
+            out[2] = best[0]->frame[2];
+        // a stick's low bytes go with it
+        if (best[1])
+        {
+            memcpy(&out[3], &best[1]->frame[3], 2);
+            memcpy(&out[7], &best[1]->frame[7], 2);
+        }
+        if (best[2])
+        {
+            memcpy(&out[5], &best[2]->frame[5], 2);
+            memcpy(&out[9], &best[2]->frame[9], 2);
+        }
+    }
+
+    bool changed = memcmp(out, merged_, FRAME16_LEN) != 0;
+    memcpy(merged_, out, FRAME16_LEN);
+    return changed;
+}
@@ -0,0 +1,43 @@
+#ifndef MUX_H
+#define MUX_H
+
+#include <stdint.h>
+
+#include <map>
+
+#include "hostd.h"
+
+// One controller shared by several sources (API clients, replays), merged the
+// way the master merges its local input: buttons are OR'ed, the D-Pad and
+// each stick come from the highest priority source that has them off center,
+// the latest change winning among equals. While any source claims the
+// controller only the claiming sources count and the best one is used as-is.
+class controller_mux
+{
+public:
+    void set(int key, int priority, const uint8_t *frame);
+    void claim(int key, int priority, bool on);
+    void remove(int key);
+    bool has(int key) const { return sources_.count(key) != 0; }
+
+    // Frames are FRAME16_LEN long.
+    // Merged frame into out, true when it differs from the previous merge.
+    bool merge(uint8_t *out);
+
+private:
+    struct source
+    {
+        int priority;
+        bool claim;
+        uint64_t seq; // last change
+        uint8_t frame[FRAME16_LEN];
+    };
+
+    source &get(int key, int priority);
+
+    std::map<int, source> sources_;
+    uint64_t seq_ = 0;
+    uint8_t merged_[FRAME16_LEN] = {0, 0, 0x0F, 128, 128, 128, 128, 0, 0, 0, 0};
+};
+
+#endif // MUX_H
@@ -0,0 +1,72 @@
+#include "recording.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+// The export is a plain nested array of numbers, so it is read as a flat
+// list of numbers: 7 frame bytes then the time, per sample.
+bool load_recording(const std::string &path, std::vector<recording_sample> &out, std::string &err)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        err = "cannot open " + path;
+        return false;
+    }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    const std::string text = ss.str();
+
+    std::vector<double> numbers;
+    const char *p = text.c_str();
+    while (*p)
+    {
+        if (*p == '-' || (*p >= '0' && *p <= '9'))
+        {
+            char *end;
+            numbers.push_back(strtod(p, &end));
+            p = end;
+        }
+        else if (*p == '[' || *p == ']' || *p == ',' || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+        {
+            p++;
+        }
+        else
+        {
+            err = "not a recording export (unexpected '" + std::string(1, *p) + "')";
+            return false;
+        }
+    }
+    if (numbers.size() % (FRAME_LEN + 1) != 0)
+    {
+        err = "not a recording export (sample size)";
+        return false;
+    }
+
+    out.clear();
+    out.reserve(numbers.size() / (FRAME_LEN + 1));
+    for (size_t i = 0; i < numbers.size(); i += FRAME_LEN + 1)
+    {
+        recording_sample s;
+        for (int f = 0; f < FRAME_LEN; f++)
+        {
+            double v = numbers[i + f];
+            if (v < 0 || v > 255)
+            {
+                err = "frame byte out of range";
+                return false;
+            }
+            s.frame[f] = (uint8_t)v;
+        }
+        s.time_ms = numbers[i + FRAME_LEN];
+        out.push_back(s);
+    }
+    std::stable_sort(out.begin(), out.end(), [](const recording_sample &a, const recording_sample &b)
+                     { return a.time_ms < b.time_ms; });
+    for (size_t i = out.size(); i-- > 0;)
+        out[i].time_ms -= out[0].time_ms;
+    return true;
+}
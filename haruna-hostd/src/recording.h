@@ -0,0 +1,21 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "hostd.h"
+
+struct recording_sample
+{
+    double time_ms; // from the start of the recording
+    uint8_t frame[FRAME_LEN];
+};
+
+// Loads a recording exported from the web UI (Export button, JSON
+// [[frame[7], timeMs], ...]). Samples are sorted by time, the first at 0.
+bool load_recording(const std::string &path, std::vector<recording_sample> &out, std::string &err);
+
+#endif // RECORDING_H
@@ -0,0 +1,101 @@
+#include "scheduler.h"
+
+#include <errno.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hostd.h"
+
+scheduler::~scheduler()
+{
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+bool scheduler::init(void)
+{
+    fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    return fd_ >= 0;
+}
+
+uint64_t scheduler::at(uint64_t due_ns, task fn)
+{
+    uint64_t id = next_id_++;
+    bool first = tasks_.empty() || due_ns < tasks_.begin()->first.first;
+    tasks_.emplace(std::make_pair(due_ns, id), std::move(fn));
+    due_of_[id] = due_ns;
+    if (first)
+        rearm();
+    return id;
+}
+
+void scheduler::cancel(uint64_t id)
+{
+    auto it = due_of_.find(id);
+    if (it == due_of_.end())
+        return;
+    tasks_.erase(std::make_pair(it->second, id));
+    due_of_.erase(it);
+}
+
+static void sleep_until(uint64_t due_ns)
+{
+    timespec ts;
+    ts.tv_sec = (time_t)(due_ns / 1000000000ull);
+    ts.tv_nsec = (long)(due_ns % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+    {
+    }
+}
+
+void scheduler::run(void)
+{
+    uint64_t expirations;
+    (void)!read(fd_, &expirations, sizeof(expirations));
+
+    while (!tasks_.empty())
+    {
+        auto it = tasks_.begin();
+        uint64_t due = it->first.first;
+        uint64_t now = mono_ns();
+        if (due > now + SCHED_SPIN_NS)
+            break;
+        if (due > now)
+        {
+            sleep_until(due);
+            now = mono_ns();
+        }
+        if (now - due > late_max_)
+            late_max_ = now - due;
+
+        // the task may schedule or cancel others
+        task fn = std::move(it->second);
+        due_of_.erase(it->first.second);
+        tasks_.erase(it);
+        fn();
+    }
+    rearm();
+}
+
+uint64_t scheduler::take_late_max(void)
+{
+    uint64_t v = late_max_;
+    late_max_ = 0;
+    return v;
+}
+
+void scheduler::rearm(void)
+{
+    itimerspec its = {};
+    if (!tasks_.empty())
+    {
+        uint64_t due = tasks_.begin()->first.first;
+        uint64_t wake = due > SCHED_SPIN_NS ? due - SCHED_SPIN_NS : 0;
+        if (wake == 0)
+            wake = 1; // 0 would disarm
+        its.it_value.tv_sec = (time_t)(wake / 1000000000ull);
+        its.it_value.tv_nsec = (long)(wake % 1000000000ull);
+    }
+    timerfd_settime(fd_, TFD_TIMER_ABSTIME, &its, nullptr);
+}
@@ -0,0 +1,47 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+// Timed tasks on the daemon clock. A timerfd wakes the loop SCHED_SPIN_NS
+// before the earliest task and clock_nanosleep() (absolute) covers the rest,
+// so a task runs within the kernel's wakeup latency of its time instead of
+// the timer slack. With --rt (SCHED_FIFO) that is a few tens of us.
+#define SCHED_SPIN_NS 300000
+
+class scheduler
+{
+public:
+    using task = std::function<void()>;
+
+    ~scheduler();
+    bool init(void);
+    int fd() const { return fd_; }
+
+    // Runs fn at due_ns (mono_ns clock), right away if that already passed.
+    // Returns an id for cancel().
+    uint64_t at(uint64_t due_ns, task fn);
+    void cancel(uint64_t id);
+
+    // timerfd readable: runs every task that is due
+    void run(void);
+
+    // worst lateness since the last call, ns
+    uint64_t take_late_max(void);
+
+private:
+    void rearm(void);
+
+    int fd_ = -1;
+    uint64_t next_id_ = 1;
+    uint64_t late_max_ = 0;
+    std::map<std::pair<uint64_t, uint64_t>, task> tasks_; // (due, id)
+    std::unordered_map<uint64_t, uint64_t> due_of_;       // id -> due
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,238 @@
+#include "slave_link.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+enum
+{
+    ST_SYNC0 = 0,
+    ST_SYNC1,
+    ST_TYPE,
+    ST_LEN,
+    ST_PAYLOAD,
+    ST_CRC,
+};
+
+void clock_sync::add(const hostlink_sync_t &reply, uint64_t received_us)
+{
+    uint32_t t1 = reply.host_us;
+    uint32_t t4 = (uint32_t)received_us;
+    int32_t rtt = (int32_t)((t4 - t1) - (reply.tx_us - reply.rx_us));
+    if (rtt < 0)
+        return;
+    // both legs are offset + delay, take their midpoint without wrapping
+    uint32_t out = reply.rx_us - t1;
+    uint32_t back = reply.tx_us - t4;
+    uint32_t offset = out + (uint32_t)((int32_t)(back - out) / 2);
+
+    samples_offset[next] = (int32_t)offset;
+    samples_rtt[next] = (uint32_t)rtt;
+    next = (next + 1) % CLOCK_WINDOW;
+    if (count < CLOCK_WINDOW)
+        count++;
+
+    int best = 0;
+    for (int i = 1; i < count; i++)
+    {
+        if (samples_rtt[i] < samples_rtt[best])
+            best = i;
+    }
+    offset_us = (uint32_t)samples_offset[best];
+    rtt_us = samples_rtt[best];
+}
+
+bool slave_link::open(const std::string &path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    // CDC ACM ignores the baud rate, raw mode keeps the tty from eating bytes
+    termios tio;
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        cfsetspeed(&tio, B115200);
+        tio.c_cflag |= CLOCAL | CREAD;
+        // with O_NONBLOCK an empty read is EAGAIN, 0 only on hangup
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    tcflush(fd, TCIOFLUSH);
+
+    fd_ = fd;
+    state_ = ST_SYNC0;
+    out_.clear();
+    text_.clear();
+    clock.reset();
+    return true;
+}
+
+void slave_link::close()
+{
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+    out_.clear();
+}
+
+bool slave_link::send(uint8_t type, const void *payload, uint8_t len)
+{
+    if (fd_ < 0 || len > HOSTLINK_MAX_PAYLOAD)
+        return false;
+
+    uint8_t frame[HOSTLINK_MAX_FRAME];
+    frame[0] = HOSTLINK_H2D_SYNC0;
+    frame[1] = HOSTLINK_H2D_SYNC1;
+    frame[2] = type;
+    frame[3] = len;
+    if (len)
+        memcpy(&frame[4], payload, len);
+    frame[4 + len] = hostlink_crc8(0, &frame[2], 2u + len);
+    out_.append((const char *)frame, HOSTLINK_HEADER_LEN + len + 1u);
+    return on_writable();
+}
+
+bool slave_link::send_frame(uint8_t controller, const uint8_t *frame)
+{
+    static const uint8_t no_lo[4] = {0, 0, 0, 0};
+    if (memcmp(&frame[FRAME_LEN], no_lo, sizeof(no_lo)) != 0)
+    {
+        uint8_t payload[1 + FRAME16_LEN];
+        payload[0] = controller;
+        memcpy(&payload[1], frame, FRAME16_LEN);
+        return send(HOSTLINK_H_FRAME16, payload, sizeof(payload));
+    }
+
+    // 8 bit frames keep the short messages
+    if (controller == 0)
+        return send(HOSTLINK_H_FRAME, frame, FRAME_LEN);
+
+    uint8_t payload[1 + FRAME_LEN];
+    payload[0] = controller;
+    memcpy(&payload[1], frame, FRAME_LEN);
+    return send(HOSTLINK_H_FRAME_N, payload, sizeof(payload));
+}
+
+bool slave_link::send_sync(void)
+{
+    uint32_t host_us = (uint32_t)mono_us();
+    return send(HOSTLINK_H_SYNC, &host_us, sizeof(host_us));
+}
+
+bool slave_link::on_writable(void)
+{
+    while (!out_.empty())
+    {
+        ssize_t n = ::write(fd_, out_.data(), out_.size());
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                return true;
+            return false;
+        }
+        out_.erase(0, (size_t)n);
+    }
+    return true;
+}
+
+bool slave_link::on_readable(void)
+{
+    uint8_t buf[512];
+    while (true)
+    {
+        ssize_t n = ::read(fd_, buf, sizeof(buf));
+        if (n > 0)
+        {
+            for (ssize_t i = 0; i < n; i++)
+                parse(buf[i]);
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EINTR))
+            return true;
+        // 0 / EIO: the device went away
+        return false;
+    }
+}
+
+void slave_link::parse(uint8_t b)
+{
+    switch (state_)
+    {
+    case ST_SYNC0:
+        if (b == HOSTLINK_D2H_SYNC0)
+        {
+            state_ = ST_SYNC1;
+        }
+        else if (b == '\n')
+        {
+            if (!text_.empty() && text_.back() == '\r')
+                text_.pop_back();
+            if (!text_.empty() && on_text)
+                on_text(text_);
+            text_.clear();
+        }
+        else if (b < 0x80 && text_.size() < 256)
+        {
+            text_.push_back((char)b);
+        }
+        return;
+
+    case ST_SYNC1:
+        if (b == HOSTLINK_D2H_SYNC1)
+            state_ = ST_TYPE;
+        else if (b != HOSTLINK_D2H_SYNC0)
+            state_ = ST_SYNC0;
+        return;
+
+    case ST_TYPE:
+        type_ = b;
+        state_ = ST_LEN;
+        return;
+
+    case ST_LEN:
+        if (b > HOSTLINK_MAX_PAYLOAD)
+        {
+            state_ = ST_SYNC0;
+            return;
+        }
+        len_ = b;
+        idx_ = 0;
+        state_ = b ? ST_PAYLOAD : ST_CRC;
+        return;
+
+    case ST_PAYLOAD:
+        payload_[idx_++] = b;
+        if (idx_ >= len_)
+            state_ = ST_CRC;
+        return;
+
+    case ST_CRC:
+    default:
+    {
+        state_ = ST_SYNC0;
+        uint8_t hdr[2] = {type_, len_};
+        uint8_t crc = hostlink_crc8(0, hdr, 2);
+        crc = hostlink_crc8(crc, payload_, len_);
+        if (crc != b)
+        {
+            log_error("slave frame 0x%02x: bad crc", type_);
+            return;
+        }
+        if (type_ == HOSTLINK_D_SYNC && len_ == sizeof(hostlink_sync_t))
+        {
+            hostlink_sync_t reply;
+            memcpy(&reply, payload_, sizeof(reply));
+            clock.add(reply, mono_us());
+        }
+        if (on_frame)
+            on_frame(type_, payload_, len_);
+        return;
+    }
+    }
+}
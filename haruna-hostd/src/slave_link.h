@@ -0,0 +1,74 @@
+#ifndef SLAVE_LINK_H
+#define SLAVE_LINK_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+
+#include "hostd.h"
+#include "hostlink.h"
+
+// Host <-> slave clock sync, the same estimate as webapp-ts/src/clock.ts:
+// the sample with the smallest round trip out of the last CLOCK_WINDOW wins.
+// Host time is the daemon clock in us, the slave clock a wrapping u32.
+#define CLOCK_WINDOW 8
+
+struct clock_sync
+{
+    int32_t samples_offset[CLOCK_WINDOW];
+    uint32_t samples_rtt[CLOCK_WINDOW];
+    int count = 0;
+    int next = 0;
+    uint32_t offset_us = 0; // slave time - host time (mod 2^32)
+    uint32_t rtt_us = 0;
+
+    bool synced() const { return count > 0; }
+    void reset() { count = next = 0; }
+    void add(const hostlink_sync_t &reply, uint64_t received_us);
+    uint32_t to_slave(uint64_t host_us) const { return (uint32_t)host_us + offset_us; }
+};
+
+// CDC ACM port of the slave: raw tty, host -> slave frames out, slave -> host
+// frames (and the plain text lines it still prints) in.
+class slave_link
+{
+public:
+    std::function<void(uint8_t type, const uint8_t *payload, uint8_t len)> on_frame;
+    std::function<void(const std::string &line)> on_text;
+    clock_sync clock;
+
+    ~slave_link() { close(); }
+
+    bool open(const std::string &path);
+    void close();
+    int fd() const { return fd_; }
+    bool connected() const { return fd_ >= 0; }
+
+    // Queued and written as far as the port takes it, false when not connected.
+    bool send(uint8_t type, const void *payload, uint8_t len);
+    // FRAME16_LEN bytes, H_FRAME16 only when a low byte is set
+    bool send_frame(uint8_t controller, const uint8_t *frame);
+    bool send_sync(void);
+
+    // Readable / writable port. False once it is gone (unplugged).
+    bool on_readable(void);
+    bool on_writable(void);
+    bool want_write(void) const { return !out_.empty(); }
+
+private:
+    void parse(uint8_t b);
+
+    int fd_ = -1;
+    std::string out_;
+    std::string text_;
+
+    // AA 55 TYPE LEN PAYLOAD CRC8, the mirror of hostlink_parse_byte()
+    uint8_t state_ = 0;
+    uint8_t type_ = 0;
+    uint8_t len_ = 0;
+    uint8_t idx_ = 0;
+    uint8_t payload_[HOSTLINK_MAX_PAYLOAD];
+};
+
+#endif // SLAVE_LINK_H
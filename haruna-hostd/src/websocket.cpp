@@ -0,0 +1,213 @@
+#include "websocket.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+// ---------- SHA-1 / base64 (handshake only) ----------
+static inline uint32_t rol(uint32_t v, int n)
+{
+    return (v << n) | (v >> (32 - n));
+}
+
+static void sha1(const std::string &msg, uint8_t out[20])
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    std::string data = msg;
+    uint64_t bits = (uint64_t)msg.size() * 8;
+    data.push_back((char)0x80);
+    while (data.size() % 64 != 56)
+        data.push_back(0);
+    for (int i = 7; i >= 0; i--)
+        data.push_back((char)(bits >> (i * 8)));
+
+    for (size_t chunk = 0; chunk < data.size(); chunk += 64)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++)
+        {
+            const uint8_t *p = (const uint8_t *)&data[chunk + i * 4];
+            w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+        }
+        for (int i = 16; i < 80; i++)
+            w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++)
+        {
+            uint32_t f, k;
+            if (i < 20)
+            {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if (i < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (i < 60)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rol(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    for (int i = 0; i < 5; i++)
+    {
+        out[i * 4] = (uint8_t)(h[i] >> 24);
+        out[i * 4 + 1] = (uint8_t)(h[i] >> 16);
+        out[i * 4 + 2] = (uint8_t)(h[i] >> 8);
+        out[i * 4 + 3] = (uint8_t)h[i];
+    }
+}
+
+static std::string base64(const uint8_t *data, size_t len)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < len; i += 3)
+    {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < len)
+            v |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < len)
+            v |= data[i + 2];
+        out.push_back(table[(v >> 18) & 63]);
+        out.push_back(table[(v >> 12) & 63]);
+        out.push_back(i + 1 < len ? table[(v >> 6) & 63] : '=');
+        out.push_back(i + 2 < len ? table[v & 63] : '=');
+    }
+    return out;
+}
+
+std::string ws_accept_key(const std::string &key)
+{
+    uint8_t digest[20];
+    sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", digest);
+    return base64(digest, sizeof(digest));
+}
+
+std::string http_header(const std::string &request, const char *name)
+{
+    size_t name_len = strlen(name);
+    size_t pos = request.find("\r\n");
+    while (pos != std::string::npos)
+    {
+        size_t line = pos + 2;
+        size_t end = request.find("\r\n", line);
+        if (end == std::string::npos || end == line)
+            break;
+        if (end - line > name_len && request[line + name_len] == ':' &&
+            strncasecmp(&request[line], name, name_len) == 0)
+        {
+            size_t v = line + name_len + 1;
+            while (v < end && isspace((unsigned char)request[v]))
+                v++;
+            size_t e = end;
+            while (e > v && isspace((unsigned char)request[e - 1]))
+                e--;
+            return request.substr(v, e - v);
+        }
+        pos = end;
+    }
+    return "";
+}
+
+std::string ws_handshake(const std::string &request)
+{
+    if (request.compare(0, 4, "GET ") != 0)
+        return "";
+    std::string key = http_header(request, "Sec-WebSocket-Key");
+    if (key.empty())
+        return "";
+
+    return "HTTP/1.1 101 Switching Protocols\r\n"
+           "Upgrade: websocket\r\n"
+           "Connection: Upgrade\r\n"
+           "Sec-WebSocket-Accept: " +
+           ws_accept_key(key) + "\r\n\r\n";
+}
+
+ssize_t ws_parse(const std::string &buf, ws_frame &out)
+{
+    if (buf.size() < 2)
+        return 0;
+    const uint8_t *p = (const uint8_t *)buf.data();
+    out.fin = (p[0] & 0x80) != 0;
+    out.opcode = p[0] & 0x0F;
+    if (!(p[1] & 0x80))
+        return -1; // clients must mask
+
+    size_t pos = 2;
+    uint64_t len = p[1] & 0x7F;
+    if (len == 126)
+    {
+        if (buf.size() < pos + 2)
+            return 0;
+        len = (uint64_t)p[2] << 8 | p[3];
+        pos += 2;
+    }
+    else if (len == 127)
+    {
+        if (buf.size() < pos + 8)
+            return 0;
+        len = 0;
+        for (int i = 0; i < 8; i++)
+            len = len << 8 | p[2 + i];
+        pos += 8;
+    }
+    if (len > WS_MAX_MESSAGE)
+        return -1;
+    if (buf.size() < pos + 4 + len)
+        return 0;
+
+    const uint8_t *mask = &p[pos];
+    pos += 4;
+    out.payload.resize((size_t)len);
+    for (size_t i = 0; i < len; i++)
+        out.payload[i] = (char)(p[pos + i] ^ mask[i % 4]);
+    return (ssize_t)(pos + len);
+}
+
+std::string ws_encode(uint8_t opcode, const std::string &payload)
+{
+    std::string out;
+    out.push_back((char)(0x80 | opcode));
+    size_t len = payload.size();
+    if (len < 126)
+    {
+        out.push_back((char)len);
+    }
+    else if (len <= 0xFFFF)
+    {
+        out.push_back((char)126);
+        out.push_back((char)(len >> 8));
+        out.push_back((char)len);
+    }
+    else
+    {
+        out.push_back((char)127);
+        for (int i = 7; i >= 0; i--)
+            out.push_back((char)((uint64_t)len >> (i * 8)));
+    }
+    return out + payload;
+}
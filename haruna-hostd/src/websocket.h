@@ -0,0 +1,46 @@
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+
+// Just enough RFC 6455 for the web UI: the upgrade handshake and single frame
+// messages. Client frames are masked, server frames are not.
+enum
+{
+    WS_OP_CONT = 0x0,
+    WS_OP_TEXT = 0x1,
+    WS_OP_BINARY = 0x2,
+    WS_OP_CLOSE = 0x8,
+    WS_OP_PING = 0x9,
+    WS_OP_PONG = 0xA,
+};
+
+#define WS_MAX_MESSAGE 65536
+
+struct ws_frame
+{
+    uint8_t opcode;
+    bool fin;
+    std::string payload; // unmasked
+};
+
+// Value of an HTTP request header (case insensitive name), "" if missing.
+std::string http_header(const std::string &request, const char *name);
+
+// Sec-WebSocket-Accept for the client's Sec-WebSocket-Key.
+std::string ws_accept_key(const std::string &key);
+
+// Full "HTTP/1.1 101" response for an upgrade request, empty when the
+// request is not a WebSocket upgrade.
+std::string ws_handshake(const std::string &request);
+
+// One frame from the front of buf: bytes consumed, 0 while incomplete, -1 on
+// a protocol error (unmasked or oversized frame).
+ssize_t ws_parse(const std::string &buf, ws_frame &out);
+
+std::string ws_encode(uint8_t opcode, const std::string &payload);
+
+#endif // WEBSOCKET_H
@@ -39,9 +39,24 @@ extern "C"
         PIO pio;
         uint sm;
         ws2812_data_byte_t bytes[4];
-        uint32_t *data;
+        uint32_t *data; // back buffer, written by the set/fill functions
+
+        // Channel order resolved at init: source byte n of a color (R, G, B, W)
+        // lands at (color >> 8n & mask[n]) << shift[n] in the PIO word.
+        uint8_t shift[4];
+        uint8_t mask[4];
+
+        // DMA double buffering
+        uint32_t *frames[2];
+        uint8_t front;          // frame owned by the DMA
+        int dma_chan;           // -1 when no channel was available
+        uint64_t busy_until_us; // end of the latch time of the last frame
+        bool static_storage;    // set by ws2812_init_static()
     } ws2812_t;
 
+// Storage for ws2812_init_static(): both DMA frames of a strip
+#define WS2812_FRAMES_WORDS(length) (2 * (length))
+
     // Function prototypes
 
     // Initialization functions
@@ -52,6 +67,9 @@ extern "C"
     ws2812_t *ws2812_init_bytes_4(uint pin, uint length, PIO pio, uint sm,
                                   ws2812_data_byte_t b1, ws2812_data_byte_t b2,
                                   ws2812_data_byte_t b3, ws2812_data_byte_t b4);
+    // No heap: ws and frames (WS2812_FRAMES_WORDS(length) words) are owned by the caller
+    ws2812_t *ws2812_init_static(ws2812_t *ws, uint32_t *frames, uint pin, uint length, PIO pio, uint sm,
+                                 ws2812_data_format_t format);
 
     // Cleanup function
     void ws2812_free(ws2812_t *ws);
@@ -70,8 +88,13 @@ extern "C"
     void ws2812_fill_from(ws2812_t *ws, uint32_t color, uint first);
     void ws2812_fill_range(ws2812_t *ws, uint32_t color, uint first, uint count);
 
-    // Display function
+    // Display functions
+    // Blocking: waits for the previous frame, then sends the current one.
     void ws2812_show(ws2812_t *ws);
+    // Non-blocking: hands the current frame to DMA and returns immediately.
+    // Returns false (frame kept) while the previous frame is still going out.
+    bool ws2812_show_async(ws2812_t *ws);
+    bool ws2812_busy(ws2812_t *ws);
 
 #ifdef __cplusplus
 }
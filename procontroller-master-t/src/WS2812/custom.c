@@ -3,59 +3,69 @@
 
 ws2812_t *ledStrip = NULL;
 
-// HSV to RGB conversion function
-// h: hue (0.0 to 1.0), s: saturation (0.0 to 1.0), v: value/brightness (0.0 to 1.0)
-// Returns RGB values via pointers
-static void hsv_to_rgb(float h, float s, float v, uint8_t *r, uint8_t *g, uint8_t *b)
+// statically allocated, the firmware does not use the heap
+static ws2812_t ledStripState;
+static uint32_t ledStripFrames[WS2812_FRAMES_WORDS(WS2812_LENGTH)];
+
+// x / 255 for x <= 255 * 255 without a divide (Cortex-M0+ has neither FPU nor divider instruction)
+static inline uint8_t div255(uint32_t x)
 {
-    int i;
-    float f, p, q, t;
+    return (uint8_t)((x + 1 + (x >> 8)) >> 8);
+}
 
+// HSV to RGB conversion function, integer only
+// h: hue (0 to HSV_HUE_MAX, 256 steps per sector), s: saturation (0 to 255), v: value/brightness (0 to 255)
+// Returns RGB values via pointers
+#define HSV_HUE_MAX (6 * 256 - 1)
+static void hsv_to_rgb(uint16_t h, uint8_t s, uint8_t v, uint8_t *r, uint8_t *g, uint8_t *b)
+{
     if (s == 0)
     {
         // Achromatic (grey)
-        *r = *g = *b = (uint8_t)(v * 255);
+        *r = *g = *b = v;
         return;
     }
 
-    h *= 6.0f; // sector 0 to 5
-    i = (int)h;
-    f = h - i; // factorial part of h
-    p = v * (1 - s);
-    q = v * (1 - s * f);
-    t = v * (1 - s * (1 - f));
+    if (h > HSV_HUE_MAX)
+        h = HSV_HUE_MAX;
+
+    uint8_t sector = (uint8_t)(h >> 8); // sector 0 to 5
+    uint8_t f = (uint8_t)(h & 0xFF);    // fractional part of h
+    uint8_t p = div255((uint32_t)v * (255 - s));
+    uint8_t q = div255((uint32_t)v * (255 - div255((uint32_t)s * f)));
+    uint8_t t = div255((uint32_t)v * (255 - div255((uint32_t)s * (255 - f))));
 
-    switch (i)
+    switch (sector)
     {
     case 0:
-        *r = (uint8_t)(v * 255);
-        *g = (uint8_t)(t * 255);
-        *b = (uint8_t)(p * 255);
+        *r = v;
+        *g = t;
+        *b = p;
         break;
     case 1:
-        *r = (uint8_t)(q * 255);
-        *g = (uint8_t)(v * 255);
-        *b = (uint8_t)(p * 255);
+        *r = q;
+        *g = v;
+        *b = p;
         break;
     case 2:
-        *r = (uint8_t)(p * 255);
-        *g = (uint8_t)(v * 255);
-        *b = (uint8_t)(t * 255);
+        *r = p;
+        *g = v;
+        *b = t;
         break;
     case 3:
-        *r = (uint8_t)(p * 255);
-        *g = (uint8_t)(q * 255);
-        *b = (uint8_t)(v * 255);
+        *r = p;
+        *g = q;
+        *b = v;
         break;
     case 4:
-        *r = (uint8_t)(t * 255);
-        *g = (uint8_t)(p * 255);
-        *b = (uint8_t)(v * 255);
+        *r = t;
+        *g = p;
+        *b = v;
         break;
     default: // case 5:
-        *r = (uint8_t)(v * 255);
-        *g = (uint8_t)(p * 255);
-        *b = (uint8_t)(q * 255);
+        *r = v;
+        *g = p;
+        *b = q;
         break;
     }
 }
@@ -67,25 +77,29 @@ void rainbowWS2812(uint32_t percentage)
     if (ledStrip == NULL)
         return;
 
-    // Convert percentage (0-1000) to hue (0.0-1.0)
-    // Use 0.85 to avoid wrapping back to red at the end (stops at magenta)
-    float hue = (percentage / 1000.0f);
+    if (percentage > 1000)
+        percentage = 1000;
+
+    // Convert percentage (0-1000) to hue (0-HSV_HUE_MAX)
+    uint16_t hue = (uint16_t)((percentage * HSV_HUE_MAX) / 1000);
 
-    // Full saturation and brightness for vibrant colors
-    float saturation = 1.0f;
-    float brightness = 0.1f;
+    // Full saturation, 10% brightness
+    uint8_t saturation = 255;
+    uint8_t brightness = 26;
 
     uint8_t r, g, b;
     hsv_to_rgb(hue, saturation, brightness, &r, &g, &b);
 
-    // Set the LED color
+    // Set the LED color, sent by DMA on the next free slot
     ws2812_set_pixel_color_rgb(ledStrip, 0, r, g, b);
-    ws2812_show(ledStrip);
+    ws2812_show_async(ledStrip);
 }
 
 void initLEDStrip()
 {
-    ledStrip = ws2812_init_format(
+    ledStrip = ws2812_init_static(
+        &ledStripState,
+        ledStripFrames,
         WS2812_PIN,       // Data line is connected to pin 23. (GP23)
         WS2812_LENGTH,    // Strip is 1 LED long.
         pio0,             // Use PIO 0 for creating the state machine.
@@ -0,0 +1,117 @@
+#include "status_led.h"
+#include "WS2812/WS2812.h"
+#include "WS2812/custom.h"
+#include "pico/time.h"
+
+#define STATUS_LED_MAX_BRIGHTNESS 32
+#define STATUS_LED_HEALTHY_FPS 100 // full brightness at this frame rate
+
+status_led_metrics_t status_led = {0};
+
+static repeating_timer_t timer;
+static volatile status_led_state_t state = STATUS_LED_USB_DOWN;
+
+static uint32_t tick = 0;
+static uint32_t window_ok = 0;
+static uint32_t window_err = 0;
+static uint32_t fps = 0;
+static uint32_t err_permille = 0;
+
+// triangle wave 0..255 with the given period in ticks
+static uint8_t pulse(uint32_t period)
+{
+    uint32_t phase = (tick % period) * 512 / period;
+    return (uint8_t)(phase < 256 ? phase : 511 - phase);
+}
+
+static uint8_t scale(uint8_t level)
+{
+    return (uint8_t)((level * STATUS_LED_MAX_BRIGHTNESS) >> 8);
+}
+
+static void update_rates(void)
+{
+    if (tick % STATUS_LED_WINDOW_TICKS != 0)
+        return;
+
+    uint32_t ok = status_led.link_ok;
+    uint32_t err = status_led.link_err;
+    uint32_t d_ok = ok - window_ok;
+    uint32_t d_err = err - window_err;
+    window_ok = ok;
+    window_err = err;
+
+    fps = d_ok * 1000 / (STATUS_LED_WINDOW_TICKS * STATUS_LED_TICK_MS);
+    err_permille = (d_ok + d_err) ? d_err * 1000 / (d_ok + d_err) : 0;
+}
+
+static status_led_state_t classify(void)
+{
+    if (!status_led.usb_mounted)
+        return STATUS_LED_USB_DOWN;
+    if (!status_led.link_up)
+        return STATUS_LED_LINK_DOWN;
+    if (err_permille > 50)
+        return STATUS_LED_DEGRADED;
+    if (status_led.queue_depth > 1)
+        return STATUS_LED_BACKLOG;
+    if (status_led.macro_running)
+        return STATUS_LED_MACRO;
+    return STATUS_LED_HEALTHY;
+}
+
+static bool status_led_tick(repeating_timer_t *t)
+{
+    (void)t;
+    tick++;
+    update_rates();
+    state = classify();
+
+    uint8_t r = 0, g = 0, b = 0;
+    switch (state)
+    {
+    case STATUS_LED_USB_DOWN:
+        b = scale(pulse(100));
+        break;
+    case STATUS_LED_LINK_DOWN:
+        r = (tick / 12) & 1 ? STATUS_LED_MAX_BRIGHTNESS : 0;
+        break;
+    case STATUS_LED_DEGRADED:
+        r = STATUS_LED_MAX_BRIGHTNESS;
+        g = STATUS_LED_MAX_BRIGHTNESS / 3;
+        break;
+    case STATUS_LED_BACKLOG:
+        r = STATUS_LED_MAX_BRIGHTNESS;
+        g = STATUS_LED_MAX_BRIGHTNESS;
+        break;
+    case STATUS_LED_MACRO:
+        r = b = scale(pulse(25));
+        break;
+    case STATUS_LED_HEALTHY:
+    default:
+    {
+        uint32_t level = 64 + fps * 191 / STATUS_LED_HEALTHY_FPS;
+        g = scale((uint8_t)(level > 255 ? 255 : level));
+        break;
+    }
+    }
+
+    // DMA driven, skips the tick if the previous frame is still going out
+    ws2812_set_pixel_color_rgb(ledStrip, 0, r, g, b);
+    ws2812_show_async(ledStrip);
+    return true;
+}
+
+void status_led_init(void)
+{
+    initLEDStrip();
+    if (ledStrip == NULL)
+        return;
+
+    add_repeating_timer_ms(-STATUS_LED_TICK_MS, status_led_tick, NULL, &timer);
+}
+
+status_led_state_t status_led_state(void)
+{
+    return state;
+}
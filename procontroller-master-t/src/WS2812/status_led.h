@@ -0,0 +1,47 @@
+#ifndef STATUS_LED_H
+#define STATUS_LED_H
+
+#include "pico/types.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define STATUS_LED_TICK_MS 20
+#define STATUS_LED_WINDOW_TICKS 50 // rates are measured over 1s
+
+    // Written by the main loop, read from the timer callback.
+    typedef struct
+    {
+        volatile uint32_t link_ok;  // successful board link / host frames (cumulative)
+        volatile uint32_t link_err; // failed transactions / parse errors (cumulative)
+        volatile uint8_t queue_depth;
+        volatile bool link_up;
+        volatile bool usb_mounted;
+        volatile bool macro_running;
+    } status_led_metrics_t;
+
+    extern status_led_metrics_t status_led;
+
+    typedef enum
+    {
+        STATUS_LED_USB_DOWN = 0, // blue, slow pulse
+        STATUS_LED_LINK_DOWN,    // red, 2Hz blink
+        STATUS_LED_DEGRADED,     // orange, error rate above 5%
+        STATUS_LED_BACKLOG,      // yellow, frames waiting
+        STATUS_LED_MACRO,        // magenta pulse
+        STATUS_LED_HEALTHY,      // green, brightness follows frame rate
+    } status_led_state_t;
+
+    // Sets up the strip (initLEDStrip) and starts the repeating timer.
+    void status_led_init(void);
+    status_led_state_t status_led_state(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STATUS_LED_H
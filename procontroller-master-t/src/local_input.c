@@ -0,0 +1,183 @@
+#include "local_input.h"
+#include "procon.h"
+#include "pico/time.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+
+#define BUTTON_COUNT 14
+#define DPAD_COUNT 4
+
+// ADC clock is 48 MHz, one conversion takes 96 cycles. Four inputs at
+// ~2 kHz each is plenty for sticks and keeps the DMA traffic tiny.
+#define ADC_INPUTS 4
+#define ADC_SAMPLE_HZ 8000
+#define ADC_RING_BITS 4 // 16 byte ring: 4 samples per input, averaged
+#define ADC_RING_LEN (1u << ADC_RING_BITS)
+#define ADC_DMA_RESTART 0x10000000u
+
+static const int8_t button_pins[BUTTON_COUNT] = LOCAL_INPUT_BUTTON_PINS;
+static const int8_t dpad_pins[DPAD_COUNT] = LOCAL_INPUT_DPAD_PINS;
+
+// ---------- Buttons ----------
+static repeating_timer_t debounce_timer;
+static uint32_t pin_mask = 0;
+static uint32_t stable = 0; // debounced level per GPIO, 1 = pressed
+static uint8_t hold_ms[32] = {0};
+
+static bool debounce_tick(repeating_timer_t *t)
+{
+    (void)t;
+    uint32_t pressed = ~gpio_get_all() & pin_mask;
+    uint32_t diff = pressed ^ stable;
+    for (uint32_t pins = pin_mask; pins; pins &= pins - 1)
+    {
+        uint32_t pin = (uint32_t)__builtin_ctz(pins);
+        if (!(diff & (1u << pin)))
+        {
+            hold_ms[pin] = 0;
+            continue;
+        }
+        if (++hold_ms[pin] >= LOCAL_INPUT_DEBOUNCE_MS)
+        {
+            hold_ms[pin] = 0;
+            stable ^= 1u << pin;
+        }
+    }
+    return true;
+}
+
+static void buttons_init(void)
+{
+    for (int i = 0; i < BUTTON_COUNT + DPAD_COUNT; i++)
+    {
+        int pin = i < BUTTON_COUNT ? button_pins[i] : dpad_pins[i - BUTTON_COUNT];
+        if (pin < 0)
+            continue;
+        gpio_init((uint)pin);
+        gpio_set_dir((uint)pin, GPIO_IN);
+        gpio_pull_up((uint)pin);
+        pin_mask |= 1u << pin;
+    }
+    add_repeating_timer_ms(-1, debounce_tick, NULL, &debounce_timer);
+}
+
+// ---------- Sticks ----------
+static uint8_t adc_ring[ADC_RING_LEN] __attribute__((aligned(ADC_RING_LEN)));
+static int adc_dma = -1;
+
+// the transfer count is finite, re-arm once it runs out (~9 hours at 8 kHz)
+static void adc_dma_irq(void)
+{
+    if (!(dma_hw->ints1 & (1u << adc_dma)))
+        return;
+    dma_hw->ints1 = 1u << adc_dma;
+    dma_channel_set_trans_count((uint)adc_dma, ADC_DMA_RESTART, true);
+}
+
+static void sticks_init(void)
+{
+    adc_init();
+    for (uint n = 0; n < ADC_INPUTS; n++)
+    {
+        if (LOCAL_INPUT_AXIS_MASK & (1u << n))
+            adc_gpio_init(26 + n);
+    }
+
+    // all four inputs are converted so ring slot i always belongs to input
+    // i % 4, unused ones are simply ignored
+    adc_select_input(0);
+    adc_set_round_robin((1u << ADC_INPUTS) - 1);
+    adc_fifo_setup(true, true, 1, false, true); // DREQ at 1 sample, 8 bit
+    adc_set_clkdiv(48000000.0f / ADC_SAMPLE_HZ - 1.0f);
+
+    adc_dma = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config((uint)adc_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, ADC_RING_BITS);
+    channel_config_set_dreq(&c, DREQ_ADC);
+    dma_channel_configure((uint)adc_dma, &c, adc_ring, &adc_hw->fifo, ADC_DMA_RESTART, false);
+
+    dma_channel_set_irq1_enabled((uint)adc_dma, true);
+    irq_add_shared_handler(DMA_IRQ_1, adc_dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    dma_channel_start((uint)adc_dma);
+    adc_run(true);
+}
+
+// Mean of the ring in 8.8 fixed point: the averaged samples resolve steps
+// below the ADC's 8 bits.
+static uint16_t read_axis(uint n)
+{
+    if (!(LOCAL_INPUT_AXIS_MASK & (1u << n)))
+        return 32768;
+
+    uint32_t sum = 0;
+    for (uint i = n; i < ADC_RING_LEN; i += ADC_INPUTS)
+        sum += adc_ring[i];
+    uint32_t v = (sum << 8) / (ADC_RING_LEN / ADC_INPUTS);
+
+    if (LOCAL_INPUT_AXIS_INVERT & (1u << n))
+        v = 0xFF00 - v;
+    if (v > 32768 - LOCAL_INPUT_DEADZONE * 256 && v < 32768 + LOCAL_INPUT_DEADZONE * 256)
+        v = 32768;
+    return (uint16_t)v;
+}
+
+void local_input_init(void)
+{
+    buttons_init();
+    sticks_init();
+}
+
+void local_input_read(local_input_t *out)
+{
+    uint32_t pressed = stable;
+
+    out->buttons = 0;
+    for (int i = 0; i < BUTTON_COUNT; i++)
+    {
+        if (button_pins[i] >= 0 && (pressed & (1u << button_pins[i])))
+            out->buttons |= (uint16_t)(1u << i);
+    }
+
+    // up, right, down, left -> bit 3..0
+    out->dpad = 0;
+    for (int i = 0; i < DPAD_COUNT; i++)
+    {
+        if (dpad_pins[i] >= 0 && (pressed & (1u << dpad_pins[i])))
+            out->dpad |= (uint8_t)(1u << (DPAD_COUNT - 1 - i));
+    }
+
+    for (uint n = 0; n < 4; n++)
+        out->axis[n] = read_axis(n);
+}
+
+uint8_t local_input_dpad_hat(uint8_t dpad)
+{
+    switch (dpad)
+    {
+    case LOCAL_INPUT_DPAD_UP:
+        return NSGAMEPAD_DPAD_UP;
+    case LOCAL_INPUT_DPAD_UP | LOCAL_INPUT_DPAD_RIGHT:
+        return NSGAMEPAD_DPAD_UP_RIGHT;
+    case LOCAL_INPUT_DPAD_RIGHT:
+        return NSGAMEPAD_DPAD_RIGHT;
+    case LOCAL_INPUT_DPAD_DOWN | LOCAL_INPUT_DPAD_RIGHT:
+        return NSGAMEPAD_DPAD_DOWN_RIGHT;
+    case LOCAL_INPUT_DPAD_DOWN:
+        return NSGAMEPAD_DPAD_DOWN;
+    case LOCAL_INPUT_DPAD_DOWN | LOCAL_INPUT_DPAD_LEFT:
+        return NSGAMEPAD_DPAD_DOWN_LEFT;
+    case LOCAL_INPUT_DPAD_LEFT:
+        return NSGAMEPAD_DPAD_LEFT;
+    case LOCAL_INPUT_DPAD_UP | LOCAL_INPUT_DPAD_LEFT:
+        return NSGAMEPAD_DPAD_UP_LEFT;
+    default: // released or opposite directions
+        return NSGAMEPAD_DPAD_CENTERED;
+    }
+}
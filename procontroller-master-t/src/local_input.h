@@ -0,0 +1,56 @@
+#ifndef LOCAL_INPUT_H
+#define LOCAL_INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// ---------- Buttons / sticks wired to the master ----------
+// Built with -DHARUNA_LOCAL_INPUT=ON. Buttons are active low (pull-ups, switch
+// to GND), debounced from a 1 ms timer IRQ. Sticks are sampled round-robin by
+// the ADC into a DMA ring, no CPU involved until the state is read.
+
+// GPIO per bit of the report's button field (NSButtons order in procon.h:
+// Y B A X L R ZL ZR - + LS RS HOME CAPTURE), -1 = not wired
+#define LOCAL_INPUT_BUTTON_PINS {6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19}
+// up, right, down, left
+#define LOCAL_INPUT_DPAD_PINS {20, 21, 22, 1}
+
+// ADC input n (GP26 + n) drives LX, LY, RX, RY. Axes left out of the mask stay
+// centered. RY is off by default: ADC3 is VSYS / 3 on a stock Pico, add 0x08
+// once GP29 is wired to a stick.
+#define LOCAL_INPUT_AXIS_MASK 0x07
+#define LOCAL_INPUT_AXIS_INVERT 0x0A // LY, RY: pushing up reads high
+#define LOCAL_INPUT_DEADZONE 8       // around 128 (8 bit steps), reported as exactly centered
+
+#define LOCAL_INPUT_DEBOUNCE_MS 5 // a pin has to hold its level this long
+
+#define LOCAL_INPUT_DPAD_UP (1u << 3)
+#define LOCAL_INPUT_DPAD_RIGHT (1u << 2)
+#define LOCAL_INPUT_DPAD_DOWN (1u << 1)
+#define LOCAL_INPUT_DPAD_LEFT (1u << 0)
+
+    typedef struct
+    {
+        uint16_t buttons; // report bit layout
+        uint8_t dpad;     // LOCAL_INPUT_DPAD_* bitmask
+        uint16_t axis[4]; // LX, LY, RX, RY, boardlink_axis16 scale (32768 = center)
+    } local_input_t;
+
+    void local_input_init(void);
+
+    // Latest debounced buttons and filtered sticks (main loop).
+    void local_input_read(local_input_t *out);
+
+    // LOCAL_INPUT_DPAD_* bitmask -> hid hat value (0x0F = released)
+    uint8_t local_input_dpad_hat(uint8_t dpad);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOCAL_INPUT_H
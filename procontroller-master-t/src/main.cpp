@@ -21,10 +21,13 @@
 #include "bsp/board_api.h"
 #include "class/hid/hid.h"
 #include "class/hid/hid_device.h"
-#include <vector>
 
 #include "WS2812/WS2812.h"
 #include "WS2812/custom.h"
+#include "WS2812/status_led.h"
+#include "boardlink.h"
+#include "local_input.h"
+#include "perf.h"
 #include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
@@ -37,12 +40,81 @@
 #define I2C_SCL_PIN 5
 #define I2C_BAUD 100000
 
-#define SLAVE_ADDR 0x55
+#define SLAVE_ADDR BOARDLINK_SLAVE_ADDR
 
-HID_NSGamepadReport_Data_t gamepad_report = {0};
+// Controller index straps, read once at boot. Tie a pin to GND to set its
+// bit (open = 0), so a single master needs no wiring.
+#define INDEX_PIN0 2
+#define INDEX_PIN1 3
+
+static uint8_t controller_index = 0;
+
+// Report as the master builds it. Sticks are 16 bit (boardlink_axis16()
+// scale) and only cut down to the descriptor's 8 bit when the HID report is
+// filled in, so hi-res host frames, stick paths and local sticks keep their
+// precision up to the last step.
+typedef struct
+{
+    uint16_t buttons;
+    uint8_t dPad;
+    uint16_t axis[4]; // LX, LY, RX, RY, 32768 = center
+} pad_report_t;
+
+// Nothing pressed, D-Pad released, sticks centered: what the console sees
+// until the first frame arrives over the board link.
+static const pad_report_t neutral_report = {0, NSGAMEPAD_DPAD_CENTERED, {32768, 32768, 32768, 32768}};
+
+static pad_report_t report_state = neutral_report;
+
+// report_state in the descriptor's layout, last one queued
+HID_NSGamepadReport_Data_t gamepad_report = {0, NSGAMEPAD_DPAD_CENTERED, 128, 128, 128, 128, 0};
+
+#if HARUNA_LOCAL_INPUT
+// Last frame from the slave, merged with the local buttons / sticks before
+// every report. Falls back to neutral while the board link is down so the
+// board still works as a plain hand controller.
+static pad_report_t remote_report = neutral_report;
+static pad_report_t *const frame_target = &remote_report;
+#else
+static pad_report_t *const frame_target = &report_state;
+#endif
 
 void hid_task(void);
 
+// ---------- Status block (relayed to the host by the slave) ----------
+#define STATUS_PERIOD_MS 100
+
+static boardlink_status_t link_status = {0};
+static bool status_dirty = true;
+static uint32_t last_complete_us = 0;
+
+// worst case durations since the last status push
+static uint32_t loop_max_us = 0;
+static uint32_t report_max_us = 0;
+static uint32_t sched_late_max_us = 0;
+
+// data age of the reports fetched since the last status push
+static uint32_t link_data_us = 0;   // when the last good poll read finished
+static uint32_t queued_data_us = 0; // link_data_us of the report in the endpoint
+static uint32_t age_sum_us = 0;
+static uint32_t age_count = 0;
+static uint32_t age_max_us = 0;
+static uint8_t age_hist[BOARDLINK_AGE_BUCKETS] = {0};
+
+static void age_record(uint32_t age_us)
+{
+    uint32_t bucket = 0;
+    while (bucket < BOARDLINK_AGE_BUCKETS - 1 && age_us >= (BOARDLINK_AGE_BUCKET0_US << bucket))
+        bucket++;
+    if (age_hist[bucket] < 0xFF)
+        age_hist[bucket]++;
+
+    age_sum_us += age_us;
+    age_count++;
+    if (age_us > age_max_us)
+        age_max_us = age_us;
+}
+
 static void i2c_master_init(void)
 {
     i2c_init(I2C_PORT, I2C_BAUD);
@@ -52,9 +124,29 @@ static void i2c_master_init(void)
     gpio_pull_up(I2C_SCL_PIN);
 }
 
-static bool i2c_write_all(const uint8_t *data, size_t len, uint32_t timeout_us)
+static void read_controller_index(void)
+{
+    const uint pins[] = {INDEX_PIN0, INDEX_PIN1};
+    for (uint i = 0; i < sizeof(pins) / sizeof(pins[0]); i++)
+    {
+        gpio_init(pins[i]);
+        gpio_set_dir(pins[i], GPIO_IN);
+        gpio_pull_up(pins[i]);
+    }
+    sleep_us(10); // let the pull-ups settle
+
+    uint8_t index = 0;
+    for (uint i = 0; i < sizeof(pins) / sizeof(pins[0]); i++)
+    {
+        if (!gpio_get(pins[i]))
+            index |= (uint8_t)(1u << i);
+    }
+    controller_index = index % BOARDLINK_MAX_CONTROLLERS;
+}
+
+static bool i2c_write_all(const uint8_t *data, size_t len, bool nostop, uint32_t timeout_us)
 {
-    int r = i2c_write_timeout_us(I2C_PORT, SLAVE_ADDR, data, len, false, timeout_us);
+    int r = i2c_write_timeout_us(I2C_PORT, SLAVE_ADDR, data, len, nostop, timeout_us);
     return r == (int)len;
 }
 
@@ -74,61 +166,955 @@ static void capture_i2c_error(void)
     i2c0->hw->clr_tx_abrt;
 }
 
+// ---------- USB report profile ----------
+typedef struct
+{
+    uint32_t sum_us;
+    uint32_t samples;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint16_t count[BOARDLINK_PROFILE_BUCKETS];
+} hist_acc_t;
+
+static hist_acc_t prof_poll = {0};
+static hist_acc_t prof_queue = {0};
+static uint16_t prof_skipped = 0;
+static uint32_t queued_us = 0; // when the report in the endpoint was queued
+
+static void HARUNA_HOT(hist_add)(hist_acc_t *h, uint32_t us)
+{
+    uint32_t bucket = 0;
+    while (bucket < BOARDLINK_PROFILE_BUCKETS - 1 && us >= BOARDLINK_PROFILE_EDGE_US(bucket))
+        bucket++;
+    if (h->count[bucket] < 0xFFFF)
+        h->count[bucket]++;
+
+    if (!h->samples || us < h->min_us)
+        h->min_us = us;
+    if (us > h->max_us)
+        h->max_us = us;
+    h->sum_us += us;
+    h->samples++;
+}
+
+static void hist_fill(boardlink_hist_t *out, const hist_acc_t *h)
+{
+    out->min_us = (uint16_t)MIN(h->min_us, 0xFFFFu);
+    out->avg_us = (uint16_t)MIN(h->samples ? h->sum_us / h->samples : 0, 0xFFFFu);
+    out->max_us = (uint16_t)MIN(h->max_us, 0xFFFFu);
+    memcpy(out->count, h->count, sizeof(out->count));
+}
+
+static void profile_push(uint32_t now)
+{
+    static uint32_t last_push = 0;
+    if (now - last_push < BOARDLINK_PROFILE_PERIOD_MS)
+        return;
+
+    boardlink_profile_t profile;
+    profile.skipped = prof_skipped;
+    hist_fill(&profile.poll, &prof_poll);
+    hist_fill(&profile.queue, &prof_queue);
+
+    uint8_t msg[1 + sizeof(boardlink_profile_t)];
+    msg[0] = BOARDLINK_CMD_PROFILE | controller_index;
+    memcpy(&msg[1], &profile, sizeof(profile));
+
+    if (i2c_write_all(msg, sizeof(msg), false, 5000))
+    {
+        last_push = now;
+        memset(&prof_poll, 0, sizeof(prof_poll));
+        memset(&prof_queue, 0, sizeof(prof_queue));
+        prof_skipped = 0;
+    }
+    else
+    {
+        capture_i2c_error();
+    }
+}
+
+static void status_push(uint32_t now)
+{
+    static uint32_t last_push = 0;
+    if (!status_dirty && now - last_push < STATUS_PERIOD_MS)
+        return;
+
+    uint8_t msg[1 + sizeof(boardlink_status_t)];
+    msg[0] = BOARDLINK_CMD_STATUS | controller_index;
+    link_status.t_us = time_us_32();
+    link_status.loop_max_us = (uint16_t)MIN(loop_max_us, 0xFFFFu);
+    link_status.report_max_us = (uint16_t)MIN(report_max_us, 0xFFFFu);
+    link_status.sched_late_max_us = (uint16_t)MIN(sched_late_max_us, 0xFFFFu);
+    link_status.age_avg_us = (uint16_t)MIN(age_count ? age_sum_us / age_count : 0, 0xFFFFu);
+    link_status.age_max_us = (uint16_t)MIN(age_max_us, 0xFFFFu);
+    memcpy(link_status.age_hist, age_hist, sizeof(age_hist));
+    memcpy(&msg[1], &link_status, sizeof(link_status));
+
+    if (i2c_write_all(msg, sizeof(msg), false, 5000))
+    {
+        status_dirty = false;
+        last_push = now;
+        loop_max_us = 0;
+        report_max_us = 0;
+        sched_late_max_us = 0;
+        age_sum_us = 0;
+        age_count = 0;
+        age_max_us = 0;
+        memset(age_hist, 0, sizeof(age_hist));
+    }
+    else
+    {
+        capture_i2c_error();
+    }
+}
+
+// Buttons0, Buttons1, DPAD, LX, LY, RX, RY -> report_state (remote_report
+// with local input). lo holds the sticks' low bytes (BOARDLINK_SYNC_HIRES),
+// NULL widens the 8 bit ones.
+static void HARUNA_HOT(apply_frame)(const uint8_t *in, const uint8_t *lo)
+{
+    frame_target->buttons = (uint16_t)in[0] | ((uint16_t)in[1] << 8);
+    frame_target->dPad = in[2];
+    for (int n = 0; n < 4; n++)
+        frame_target->axis[n] = lo ? (uint16_t)(in[3 + n] << 8 | lo[n]) : boardlink_axis16(in[3 + n]);
+}
+
+// ---------- Slave clock / scheduled frames ----------
+// time between starting a read and the slave's read request (address byte)
+#define ADDR_BYTE_US (9u * 1000000u / I2C_BAUD)
+#define CLOCK_WINDOW_US 1000000
+
+static bool clock_valid = false;
+static int32_t slave_offset_us = 0; // slave time - master time
+static int32_t window_min_us = 0;
+static uint32_t window_start_us = 0;
+
+// The slave stamps a read when its ISR gets to it, so samples are only ever
+// late. The smallest offset of each window is taken as the clock.
+static void clock_sample(uint32_t slave_us, uint32_t read_start_us)
+{
+    int32_t sample = (int32_t)(slave_us - (read_start_us + ADDR_BYTE_US));
+    if (!clock_valid)
+    {
+        clock_valid = true;
+        slave_offset_us = sample;
+        window_min_us = sample;
+        window_start_us = read_start_us;
+        return;
+    }
+    if ((int32_t)(sample - window_min_us) < 0)
+        window_min_us = sample;
+    if (read_start_us - window_start_us >= CLOCK_WINDOW_US)
+    {
+        slave_offset_us = window_min_us;
+        window_min_us = sample;
+        window_start_us = read_start_us;
+    }
+}
+
+typedef struct
+{
+    uint32_t at_us; // slave time
+    uint8_t frame[BOARDLINK_FRAME_LEN];
+} sched_entry_t;
+
+static sched_entry_t sched_queue[BOARDLINK_SCHED_DEPTH];
+static uint8_t sched_head = 0;
+static uint8_t sched_count = 0;
+
+static void sched_pop_apply(uint32_t late_us)
+{
+    apply_frame(sched_queue[sched_head].frame, NULL);
+    sched_head = (uint8_t)((sched_head + 1) % BOARDLINK_SCHED_DEPTH);
+    sched_count--;
+    if (late_us > sched_late_max_us)
+        sched_late_max_us = late_us;
+}
+
+static void sched_push(uint32_t at_us, const uint8_t *frame)
+{
+    // full: the oldest entry is due first, apply it now
+    if (sched_count == BOARDLINK_SCHED_DEPTH)
+        sched_pop_apply(0);
+
+    sched_entry_t *e = &sched_queue[(sched_head + sched_count) % BOARDLINK_SCHED_DEPTH];
+    e->at_us = at_us;
+    memcpy(e->frame, frame, BOARDLINK_FRAME_LEN);
+    sched_count++;
+}
+
+// Applies every scheduled frame that is due, right before a report.
+static void HARUNA_HOT(sched_run)(uint32_t now_us)
+{
+    uint32_t slave_now = now_us + (uint32_t)slave_offset_us;
+    while (sched_count)
+    {
+        int32_t late = (int32_t)(slave_now - sched_queue[sched_head].at_us);
+        if (late < 0)
+            break;
+        sched_pop_apply((uint32_t)late);
+    }
+}
+
+// ---------- Report trace ----------
+// While the slave asks for it (BOARDLINK_SYNC_TRACE), every report the console
+// fetched that differs from the previous one is queued here with its slave
+// time and pushed to the slave a block at a time.
+#define TRACE_RING 32
+
+static bool trace_on = false;
+static boardlink_trace_entry_t trace_ring[TRACE_RING];
+static uint8_t trace_head = 0;
+static uint8_t trace_count = 0;
+static uint8_t trace_lost = 0;
+static bool trace_busy = false; // slave still holds the previous block (BOARDLINK_SYNC_TRACE_BUSY)
+static uint8_t queued_frame[BOARDLINK_FRAME_LEN];  // report in the endpoint, wire layout
+static uint8_t fetched_frame[BOARDLINK_FRAME_LEN]; // last report the console took
+
+static void trace_enable(bool on)
+{
+    if (on == trace_on)
+        return;
+    trace_on = on;
+    trace_head = 0;
+    trace_count = 0;
+    trace_lost = 0;
+    // the first fetch after enabling is always recorded (initial state)
+    memset(fetched_frame, 0xFF, sizeof(fetched_frame));
+}
+
+static void HARUNA_HOT(trace_record)(uint32_t now_us)
+{
+    if (!trace_on || !clock_valid)
+        return;
+    if (memcmp(queued_frame, fetched_frame, BOARDLINK_FRAME_LEN) == 0)
+        return;
+    memcpy(fetched_frame, queued_frame, BOARDLINK_FRAME_LEN);
+
+    if (trace_count == TRACE_RING)
+    {
+        if (trace_lost < 0xFF)
+            trace_lost++;
+        return;
+    }
+    boardlink_trace_entry_t *e = &trace_ring[(trace_head + trace_count) % TRACE_RING];
+    e->slave_us = now_us + (uint32_t)slave_offset_us;
+    memcpy(e->frame, fetched_frame, BOARDLINK_FRAME_LEN);
+    trace_count++;
+}
+
+static void trace_push(void)
+{
+    if (!trace_on || trace_busy || (!trace_count && !trace_lost))
+        return;
+
+    boardlink_trace_t block;
+    memset(&block, 0, sizeof(block));
+    block.count = (uint8_t)MIN(trace_count, BOARDLINK_TRACE_ENTRIES);
+    block.lost = trace_lost;
+    for (uint8_t i = 0; i < block.count; i++)
+        block.entries[i] = trace_ring[(trace_head + i) % TRACE_RING];
+
+    uint8_t msg[1 + sizeof(boardlink_trace_t)];
+    msg[0] = BOARDLINK_CMD_TRACE | controller_index;
+    memcpy(&msg[1], &block, sizeof(block));
+
+    if (i2c_write_all(msg, sizeof(msg), false, 5000))
+    {
+        trace_head = (uint8_t)((trace_head + block.count) % TRACE_RING);
+        trace_count -= block.count;
+        trace_lost = 0;
+    }
+    else
+    {
+        capture_i2c_error();
+    }
+}
+
+// ---------- Stick paths ----------
+// Segments from the host (see boardlink_path_t), evaluated for the time the
+// report goes out. Progress and positions are 16.16 / Q15 fixed point, the
+// sine table is built once with the float ROM routines.
+#define PATH_ONE (1u << 16) // progress 1.0
+#define SINE_STEPS 256      // per turn
+
+typedef struct
+{
+    boardlink_path_t seg[BOARDLINK_PATH_DEPTH]; // at_us resolved for chained ones
+    uint8_t head;
+    uint8_t count;
+    uint32_t end_us; // slave time the last queued segment ends
+} path_queue_t;
+
+static int16_t sine_q15[SINE_STEPS + 1];
+static path_queue_t paths[2];
+static bool path_waiting = false; // the slave has segments for us
+
+static void path_init(void)
+{
+    for (int i = 0; i <= SINE_STEPS; i++)
+        sine_q15[i] = (int16_t)lroundf(32767.0f * sinf((float)i * 6.2831853f / SINE_STEPS));
+}
+
+static inline uint32_t mul_q16(uint32_t a, uint32_t b)
+{
+    return (uint32_t)(((uint64_t)a * b) >> 16);
+}
+
+static int32_t sin_q15(uint16_t angle)
+{
+    uint32_t i = angle >> 8;
+    int32_t frac = angle & 0xFF;
+    return sine_q15[i] + (((sine_q15[i + 1] - sine_q15[i]) * frac) >> 8);
+}
+
+static uint32_t path_ease(uint8_t ease, uint32_t p)
+{
+    switch (ease)
+    {
+    case BOARDLINK_EASE_IN:
+        return mul_q16(p, p);
+    case BOARDLINK_EASE_OUT:
+        return PATH_ONE - mul_q16(PATH_ONE - p, PATH_ONE - p);
+    case BOARDLINK_EASE_IN_OUT:
+        return mul_q16(mul_q16(p, p), 3 * PATH_ONE - 2 * p);
+    default:
+        return p;
+    }
+}
+
+static inline uint16_t clamp_axis(int32_t v)
+{
+    return (uint16_t)(v < 0 ? 0 : v > 0xFFFF ? 0xFFFF : v);
+}
+
+// Position at eased progress e (PATH_ONE lands exactly on the end point),
+// in 16 bit so slow segments move between the 8 bit steps of their points.
+static void path_point(const boardlink_path_t *s, uint32_t e, uint16_t *x, uint16_t *y)
+{
+    int32_t ax = boardlink_axis16(s->a[0]);
+    int32_t ay = boardlink_axis16(s->a[1]);
+    if (s->shape == BOARDLINK_PATH_LINE)
+    {
+        *x = clamp_axis(ax + (int32_t)(((int64_t)(boardlink_axis16(s->b[0]) - ax) * e) >> 16));
+        *y = clamp_axis(ay + (int32_t)(((int64_t)(boardlink_axis16(s->b[1]) - ay) * e) >> 16));
+        return;
+    }
+    uint16_t angle = (uint16_t)(s->angle0 + (int32_t)(((int64_t)s->sweep * e) >> 16));
+    *x = clamp_axis(ax + (((s->b[0] << 8) * sin_q15((uint16_t)(angle + 0x4000))) >> 15));
+    *y = clamp_axis(ay - (((s->b[1] << 8) * sin_q15(angle)) >> 15));
+}
+
+static void path_push(const boardlink_path_t *p)
+{
+    if (p->shape == BOARDLINK_PATH_CLEAR)
+    {
+        paths[0].count = 0;
+        paths[1].count = 0;
+        return;
+    }
+    if ((p->shape != BOARDLINK_PATH_LINE && p->shape != BOARDLINK_PATH_ARC) || p->stick > BOARDLINK_STICK_RIGHT)
+        return;
+
+    path_queue_t *q = &paths[p->stick];
+    if (q->count == BOARDLINK_PATH_DEPTH)
+        return; // path_fetch only reads with room left
+    boardlink_path_t *e = &q->seg[(q->head + q->count) % BOARDLINK_PATH_DEPTH];
+    *e = *p;
+    if (p->flags & BOARDLINK_PATH_CHAIN)
+    {
+        // right after the previous segment, or now if that one is long over
+        uint32_t slave_now = time_us_32() + (uint32_t)slave_offset_us;
+        bool ahead = q->count || (int32_t)(q->end_us - slave_now) > 0;
+        e->at_us = ahead ? q->end_us : slave_now;
+    }
+    q->end_us = e->at_us + e->duration_us;
+    q->count++;
+}
+
+// One segment per link poll, while both sticks have room for it.
+static void path_fetch(void)
+{
+    if (!path_waiting || paths[0].count == BOARDLINK_PATH_DEPTH || paths[1].count == BOARDLINK_PATH_DEPTH)
+        return;
+
+    const uint8_t cmd = BOARDLINK_CMD_PATH | controller_index;
+    boardlink_path_t seg;
+    if (!i2c_write_all(&cmd, 1, true, 3000) || !i2c_read_all((uint8_t *)&seg, sizeof(seg), 3000))
+    {
+        capture_i2c_error();
+        return;
+    }
+    path_push(&seg);
+}
+
+// Writes the active segment of each stick into the frame, at master time at_us.
+static void HARUNA_HOT(path_run)(uint32_t at_us)
+{
+    uint32_t slave_at = at_us + (uint32_t)slave_offset_us;
+    for (uint8_t stick = 0; stick < 2; stick++)
+    {
+        path_queue_t *q = &paths[stick];
+        while (q->count)
+        {
+            const boardlink_path_t *s = &q->seg[q->head];
+            int32_t elapsed = (int32_t)(slave_at - s->at_us);
+            if (elapsed < 0)
+                break;
+
+            uint32_t p = PATH_ONE;
+            if ((uint32_t)elapsed < s->duration_us)
+                p = (uint32_t)(((uint64_t)elapsed << 16) / s->duration_us);
+
+            uint16_t *axis = &frame_target->axis[stick == BOARDLINK_STICK_LEFT ? 0 : 2];
+            path_point(s, path_ease(s->ease, p), &axis[0], &axis[1]);
+            if (p < PATH_ONE)
+                break;
+            q->head = (uint8_t)((q->head + 1) % BOARDLINK_PATH_DEPTH);
+            q->count--;
+        }
+    }
+}
+
+// ---------- USB frame (SOF) phase ----------
+// The gamepad endpoint has bInterval 1, so the console sends an IN token every
+// frame and takes a queued report at the first one. Once the SOF grid is
+// known, the board link is read so that it finishes SOF_GUARD_US before a
+// frame starts and the report is queued right after it, instead of resending
+// whatever the last 10 ms poll got. At 100 kHz a poll (BOARDLINK_POLL_LEN
+// bytes) takes ~1.8 ms, so that is every second frame; a faster bus gets
+// closer to every frame.
+#ifndef HARUNA_SOF_ALIGN
+#define HARUNA_SOF_ALIGN 1
+#endif
+
+#define SOF_GUARD_US 60       // report queued this long before the frame starts
+#define SOF_FETCH_WAIT_US 500 // after the frame start, for the completion
+#define SOF_WINDOW_US 1000000
+#define SOF_FRAME_MASK 0x7FF // the hardware frame number is 11 bits
+
+static bool sof_valid = false;
+static bool sof_locked = false;  // a full window was measured
+static uint32_t sof_count = 0;   // last raw frame number
+static uint32_t sof_frame = 0;   // extended frame number of the latest SOF
+static uint32_t sof_anchor_frame = 0;
+static uint32_t sof_anchor_us = 0;            // estimated start of sof_anchor_frame
+static uint32_t sof_period_q16 = 1000u << 16; // frame length in master us, 16.16
+static int32_t sof_window_min = 0;
+
+static void set_usb_state(uint8_t set, uint8_t clear);
+
+static void sof_reset(void)
+{
+    sof_valid = false;
+    sof_locked = false;
+    set_usb_state(0, BOARDLINK_USB_SOF_LOCKED);
+}
+
+// Start of an (extended) frame in master time.
+static uint32_t sof_time(uint32_t frame)
+{
+    return sof_anchor_us + (uint32_t)(((uint64_t)(frame - sof_anchor_frame) * sof_period_q16) >> 16);
+}
+
+// Frame running at master time t.
+static uint32_t sof_frame_at(uint32_t t)
+{
+    int32_t dt = (int32_t)(t - sof_anchor_us);
+    if (dt <= 0)
+        return sof_anchor_frame;
+    return sof_anchor_frame + (uint32_t)(((uint64_t)dt << 16) / sof_period_q16);
+}
+
+// Runs from tud_task, so every SOF is seen late. The earliest one of each
+// window marks the grid, the distance between two windows gives the frame
+// length in master time (the console's clock is not ours).
+void tud_sof_cb(uint32_t frame_count)
+{
+    uint32_t now = time_us_32();
+    if (!sof_valid)
+    {
+        sof_valid = true;
+        sof_count = frame_count;
+        sof_frame = 0;
+        sof_anchor_frame = 0;
+        sof_anchor_us = now;
+        sof_window_min = INT32_MAX;
+        return;
+    }
+
+    sof_frame += (frame_count - sof_count) & SOF_FRAME_MASK;
+    sof_count = frame_count;
+    int32_t late = (int32_t)(now - sof_time(sof_frame));
+    if (late < sof_window_min)
+        sof_window_min = late;
+
+    if (now - sof_anchor_us < SOF_WINDOW_US)
+        return;
+
+    uint32_t start = sof_time(sof_frame) + (uint32_t)sof_window_min;
+    if (sof_locked)
+    {
+        uint32_t period = (uint32_t)(((uint64_t)(start - sof_anchor_us) << 16) / (sof_frame - sof_anchor_frame));
+        // USB allows +-500 ppm, anything further off is a bad window
+        if (period > (999u << 16) && period < (1001u << 16))
+            sof_period_q16 = period;
+    }
+    sof_anchor_us = start;
+    sof_anchor_frame = sof_frame;
+    sof_window_min = INT32_MAX;
+    sof_locked = true;
+    set_usb_state(BOARDLINK_USB_SOF_LOCKED, 0);
+}
+
+static bool sof_ready(void)
+{
+    return HARUNA_SOF_ALIGN && sof_locked && tud_mounted() && !tud_suspended();
+}
+
+// time a poll takes (command, register, length, repeated start, read);
+// follows slower reads at once and faster ones slowly
+static uint32_t link_read_us = (BOARDLINK_POLL_LEN + 5) * 9u * 1000000u / I2C_BAUD;
+static uint32_t aligned_frame = 0; // frame the next report is aimed at
+static uint32_t aligned_read_at = 0;
+
+static void aligned_plan(uint32_t now_us)
+{
+    aligned_frame = sof_frame_at(now_us + link_read_us + SOF_GUARD_US) + 1;
+    aligned_read_at = sof_time(aligned_frame) - SOF_GUARD_US - link_read_us;
+}
+
+#if HARUNA_LOCAL_INPUT
+static inline uint16_t pick_axis(uint16_t remote, uint16_t local)
+{
+    return remote != 32768 ? remote : local;
+}
+
+// Buttons are OR'ed. The host's dpad / sticks win whenever they are off
+// center, so automation can still take over a hand-held board.
+static void HARUNA_HOT(merge_local_input)(void)
+{
+    local_input_t in;
+    local_input_read(&in);
+
+    report_state.buttons = remote_report.buttons | in.buttons;
+    report_state.dPad = remote_report.dPad != NSGAMEPAD_DPAD_CENTERED
+                            ? remote_report.dPad
+                            : local_input_dpad_hat(in.dpad);
+    for (int n = 0; n < 4; n++)
+        report_state.axis[n] = pick_axis(remote_report.axis[n], in.axis[n]);
+}
+#endif
+
+static uint32_t poll_ms = 10;
+static uint8_t last_frame[BOARDLINK_FRAME_LEN] = {0};
+
+// Low bytes of the polled frame's sticks. A host frame that lands between
+// the poll and this read mixes old high and new low bytes, less than one
+// 8 bit step off, and is still FRESH for the next poll.
+static bool axis_lo_fetch(uint8_t *lo)
+{
+    const uint8_t cmd[3] = {(uint8_t)(BOARDLINK_CMD_READ | controller_index), BOARDLINK_REG(axis_lo), 4};
+    if (!i2c_write_all(cmd, sizeof(cmd), true, 3000) || !i2c_read_all(lo, 4, 3000))
+    {
+        capture_i2c_error();
+        return false;
+    }
+    return true;
+}
+static bool sched_waiting = false; // the last poll saw a due scheduled frame
+
+// One short READ for this controller (frame, slave clock, flags); applies the
+// frame. A due scheduled frame is left for sched_fetch().
+static bool HARUNA_HOT(link_poll)(void)
+{
+    const uint8_t cmd_read[3] = {(uint8_t)(BOARDLINK_CMD_READ | controller_index), 0, BOARDLINK_POLL_LEN};
+    uint8_t inData[BOARDLINK_POLL_LEN] = {0};
+
+    uint32_t t_start = time_us_32();
+    // repeated start: the slave answers for this controller only
+    if (!i2c_write_all(cmd_read, sizeof(cmd_read), true, 3000))
+        return false;
+
+    uint32_t read_start = time_us_32();
+    if (!i2c_read_all(inData, sizeof(inData), 3000))
+        return false;
+
+    // 성공적으로 읽음
+    link_data_us = time_us_32();
+    uint32_t took = link_data_us - t_start;
+    link_read_us = took > link_read_us ? took : link_read_us - (link_read_us - took) / 16;
+
+    boardlink_sync_t sync = {};
+    memcpy(&sync, &inData[BOARDLINK_FRAME_LEN], BOARDLINK_POLL_LEN - BOARDLINK_FRAME_LEN);
+    clock_sample(sync.slave_us, read_start);
+
+    // new host frame; a changed one counts too, in case the read that
+    // carried FRESH was lost
+    if ((sync.flags & BOARDLINK_SYNC_FRESH) ||
+        memcmp(last_frame, inData, BOARDLINK_FRAME_LEN) != 0)
+    {
+        memcpy(last_frame, inData, BOARDLINK_FRAME_LEN);
+        uint8_t lo[4];
+        bool hires = (sync.flags & BOARDLINK_SYNC_HIRES) && axis_lo_fetch(lo);
+        apply_frame(inData, hires ? lo : NULL);
+    }
+    sched_waiting = (sync.flags & BOARDLINK_SYNC_SCHED) != 0;
+    trace_enable((sync.flags & BOARDLINK_SYNC_TRACE) != 0);
+    trace_busy = (sync.flags & BOARDLINK_SYNC_TRACE_BUSY) != 0;
+    path_waiting = (sync.flags & BOARDLINK_SYNC_PATH) != 0;
+    // scheduled frames due / path segments / trace backlog: come back sooner
+    poll_ms = (sched_waiting || sync.sched_pending || path_waiting || trace_count > BOARDLINK_TRACE_ENTRIES) ? 1 : 10;
+    return true;
+}
+
+// The scheduled frame the last poll flagged, read as flags .. sched_frame so
+// the slave dequeues it. Runs after the report, it is due 30 ms out at most.
+static void sched_fetch(void)
+{
+    if (!sched_waiting)
+        return;
+    sched_waiting = false;
+
+    const uint8_t cmd[3] = {(uint8_t)(BOARDLINK_CMD_READ | controller_index), BOARDLINK_SCHED_REG,
+                            (uint8_t)BOARDLINK_SCHED_LEN};
+    boardlink_sync_t sync;
+    uint8_t *tail = (uint8_t *)&sync + offsetof(boardlink_sync_t, flags);
+    if (!i2c_write_all(cmd, sizeof(cmd), true, 3000) || !i2c_read_all(tail, BOARDLINK_SCHED_LEN, 3000))
+    {
+        capture_i2c_error();
+        return;
+    }
+    if (sync.flags & BOARDLINK_SYNC_SCHED)
+        sched_push(sync.sched_at_us, sync.sched_frame);
+}
+
+#if HARUNA_LINK_TEST
+// ---------- Link test (HARUNA_LINK_TEST) ----------
+// Replaces the poll. TEST transactions against the slave, paced at the rate
+// from its register map (or back to back), every byte checked against
+// boardlink_test_byte(). Each BOARDLINK_TEST_WINDOW_MS the counters and
+// latency percentiles go to the slave as a boardlink_test_report_t and the
+// config is read again, bus speed included.
+#define TEST_SAMPLES 512 // latency reservoir per window
+#define TEST_DEFAULT_LEN 16
+
+static boardlink_test_report_t test_report = {0};
+static uint16_t test_lat[TEST_SAMPLES];
+static uint32_t test_lat_seen = 0; // completed transactions of the window
+static uint32_t test_lat_max = 0;
+static uint32_t test_rng = 0x2545F491u;
+static uint32_t test_window_us = 0;
+static uint32_t test_next_us = 0;
+static uint8_t test_seq = 0;
+static uint32_t test_baud = 0; // requested, test_report.baud is what the divider gives
+
+static uint32_t test_random(void)
+{
+    // xorshift32
+    test_rng ^= test_rng << 13;
+    test_rng ^= test_rng >> 17;
+    test_rng ^= test_rng << 5;
+    return test_rng;
+}
+
+// uniform sample of the window's latencies (reservoir sampling), the
+// maximum is kept exactly
+static void test_latency(uint32_t us)
+{
+    uint16_t v = (uint16_t)MIN(us, 0xFFFFu);
+    if (test_lat_seen < TEST_SAMPLES)
+        test_lat[test_lat_seen] = v;
+    else
+    {
+        uint32_t j = test_random() % (test_lat_seen + 1);
+        if (j < TEST_SAMPLES)
+            test_lat[j] = v;
+    }
+    test_lat_seen++;
+    if (us > test_lat_max)
+        test_lat_max = us;
+}
+
+static int test_lat_cmp(const void *a, const void *b)
+{
+    return (int)*(const uint16_t *)a - (int)*(const uint16_t *)b;
+}
+
+// config from the slave's register map; keeps the previous one if the read fails
+static void test_configure(void)
+{
+    const uint8_t cmd[3] = {(uint8_t)(BOARDLINK_CMD_READ | controller_index), BOARDLINK_REG(test_rate_hz),
+                            (uint8_t)(sizeof(boardlink_regs_t) - BOARDLINK_REG(test_rate_hz))};
+    boardlink_regs_t regs;
+    uint8_t *tail = (uint8_t *)&regs + BOARDLINK_REG(test_rate_hz);
+    if (!i2c_write_all(cmd, sizeof(cmd), true, 5000) || !i2c_read_all(tail, cmd[2], 5000))
+    {
+        capture_i2c_error();
+        return;
+    }
+
+    uint32_t baud = regs.test_khz ? regs.test_khz * 1000u : I2C_BAUD;
+    if (baud != test_baud)
+    {
+        test_baud = baud;
+        test_report.baud = i2c_set_baudrate(I2C_PORT, baud);
+    }
+    test_report.rate_hz = regs.test_rate_hz;
+    test_report.len = (uint8_t)MIN(regs.test_len ? regs.test_len : TEST_DEFAULT_LEN, BOARDLINK_TEST_MAX);
+    test_report.mode = regs.test_mode <= BOARDLINK_TEST_WRITE ? regs.test_mode : (uint8_t)BOARDLINK_TEST_BOTH;
+}
+
+static void HARUNA_HOT(test_transaction)(bool write)
+{
+    uint8_t len = test_report.len;
+    uint8_t seq = test_seq++;
+    uint8_t msg[3 + BOARDLINK_TEST_MAX];
+    msg[0] = BOARDLINK_CMD_TEST | controller_index;
+    msg[1] = seq;
+    msg[2] = len;
+    for (uint8_t i = 0; write && i < len; i++)
+        msg[3 + i] = boardlink_test_byte(seq, i);
+
+    // four times the wire time, clock stretching included
+    uint32_t timeout_us = 4u * (len + 5u) * 9u * 1000000u / test_report.baud + 500u;
+    uint8_t in[BOARDLINK_TEST_MAX];
+    int want = write ? 3 + len : len;
+    int r;
+
+    test_report.transactions++;
+    uint32_t t_start = time_us_32();
+    if (write)
+    {
+        r = i2c_write_timeout_us(I2C_PORT, SLAVE_ADDR, msg, (size_t)want, false, timeout_us);
+    }
+    else
+    {
+        // repeated start like GET
+        r = i2c_write_timeout_us(I2C_PORT, SLAVE_ADDR, msg, 3, true, timeout_us);
+        if (r == 3)
+            r = i2c_read_timeout_us(I2C_PORT, SLAVE_ADDR, in, len, false, timeout_us);
+    }
+    uint32_t took = time_us_32() - t_start;
+
+    bool good = r == want;
+    if (r == PICO_ERROR_TIMEOUT)
+        test_report.timeout++;
+    else if (!good)
+        test_report.nak++;
+    for (uint8_t i = 0; good && !write && i < len; i++)
+        good = in[i] == boardlink_test_byte(seq, i);
+    if (r == want && !good)
+        test_report.bad_data++;
+
+    if (good)
+    {
+        test_report.ok++;
+        test_latency(took);
+        status_led.link_ok++;
+    }
+    else
+    {
+        if (r != want)
+            capture_i2c_error();
+        status_led.link_err++;
+    }
+    status_led.link_up = good;
+}
+
+static uint16_t test_percentile(uint32_t n, uint32_t pct)
+{
+    return n ? test_lat[(n - 1) * pct / 100] : 0;
+}
+
+static void test_window_end(uint32_t now_us)
+{
+    uint32_t n = MIN(test_lat_seen, (uint32_t)TEST_SAMPLES);
+    qsort(test_lat, n, sizeof(test_lat[0]), test_lat_cmp);
+
+    test_report.window_us = now_us - test_window_us;
+    test_report.lat_p50_us = test_percentile(n, 50);
+    test_report.lat_p90_us = test_percentile(n, 90);
+    test_report.lat_p99_us = test_percentile(n, 99);
+    test_report.lat_max_us = (uint16_t)MIN(test_lat_max, 0xFFFFu);
+    test_report.slave_rx_ok = 0;
+    test_report.slave_rx_bad = 0;
+
+    // the slave relays it as HOSTLINK_D_LINK_TEST; a lost report is just a lost window
+    uint8_t msg[1 + sizeof(boardlink_test_report_t)];
+    msg[0] = BOARDLINK_CMD_TEST_REPORT | controller_index;
+    memcpy(&msg[1], &test_report, sizeof(test_report));
+    if (!i2c_write_all(msg, sizeof(msg), false, 10000))
+        capture_i2c_error();
+
+    test_report.transactions = 0;
+    test_report.ok = 0;
+    test_report.bad_data = 0;
+    test_report.nak = 0;
+    test_report.timeout = 0;
+    test_lat_seen = 0;
+    test_lat_max = 0;
+    test_window_us = time_us_32();
+    test_configure();
+}
+
+// Main loop of a link test build. The console still gets (neutral) reports.
+static void link_test_main(void)
+{
+    uint32_t led_last = 0;
+    bool led = false;
+    test_baud = I2C_BAUD;
+    test_report.baud = i2c_set_baudrate(I2C_PORT, I2C_BAUD);
+    test_report.len = TEST_DEFAULT_LEN;
+    test_window_us = time_us_32();
+    test_next_us = test_window_us;
+    test_configure();
+
+    while (1)
+    {
+        tud_task();
+        hid_task();
+
+        // back to back, or as many as are due, for 1 ms between USB tasks
+        uint32_t slice_start = time_us_32();
+        uint32_t now_us = slice_start;
+        while (now_us - slice_start < 1000)
+        {
+            if (test_report.rate_hz)
+            {
+                if ((int32_t)(now_us - test_next_us) < 0)
+                    break;
+                test_next_us += 1000000u / test_report.rate_hz;
+                // more than 10 ms behind: the rate is beyond the bus, don't catch up
+                if ((int32_t)(now_us - test_next_us) > 10000)
+                    test_next_us = now_us;
+            }
+            bool write = test_report.mode == BOARDLINK_TEST_WRITE ||
+                         (test_report.mode == BOARDLINK_TEST_BOTH && (test_seq & 1));
+            test_transaction(write);
+            now_us = time_us_32();
+        }
+
+        if (now_us - test_window_us >= BOARDLINK_TEST_WINDOW_MS * 1000u)
+            test_window_end(now_us);
+
+        // fast blink while the last transaction went through
+        uint32_t now = board_millis();
+        if (now - led_last >= (status_led.link_up ? 100u : 1000u))
+        {
+            led_last = now;
+            gpio_put(PICO_DEFAULT_LED_PIN, led);
+            led = !led;
+        }
+
+        if (test_report.rate_hz)
+        {
+            int32_t wait = (int32_t)(test_next_us - time_us_32());
+            if (wait > 0)
+                sleep_us((uint64_t)MIN(wait, 1000));
+        }
+    }
+}
+#endif
+
+static void report_tick(void);
+
+// Report for aligned_frame, right after the link read. Stays in tud_task
+// until the console fetched it so the completion, and the data age, are
+// timed closely.
+static void HARUNA_HOT(aligned_send)(void)
+{
+    report_tick();
+    uint32_t until = sof_time(aligned_frame) + SOF_FETCH_WAIT_US;
+    while (!tud_hid_n_ready(ITF_NUM_GAMEPAD) && (int32_t)(time_us_32() - until) < 0)
+        tud_task();
+}
+
 int main(void)
 {
     board_init();
+    read_controller_index();
     i2c_master_init();
+#if HARUNA_LOCAL_INPUT
+    local_input_init();
+#endif
+    path_init();
     tusb_init();
+    tud_sof_cb_enable(HARUNA_SOF_ALIGN);
 
     gpio_init(PICO_DEFAULT_LED_PIN);
     gpio_set_dir(PICO_DEFAULT_LED_PIN, GPIO_OUT);
+    status_led_init();
+
+#if HARUNA_LINK_TEST
+    link_test_main();
+#endif
 
     uint32_t last = 0;
     uint32_t blink_ms = 1000;
-    static const uint8_t CMD_GET = 0x10;
+    bool aligned = false;
 
     while (1)
     {
+        uint32_t loop_start = time_us_32();
         tud_task();
-        hid_task();
 
         uint32_t now = board_millis();
+        bool polled = false;
+        bool ok = false;
 
-        // 10ms 마다 데이터 요청
-        if (now - last >= 10)
+        if (sof_ready())
+        {
+            // read the link just in time for the frame the report goes out in
+            if (!aligned)
+            {
+                aligned = true;
+                aligned_plan(loop_start);
+            }
+            if ((int32_t)(loop_start - aligned_read_at) >= 0)
+            {
+                polled = true;
+                ok = link_poll();
+                aligned_send();
+            }
+        }
+        else
         {
-            last = now;
+            aligned = false;
+            hid_task();
+            // 10ms 마다 데이터 요청 (scheduled frames / path segments waiting: every 1ms)
+            if (now - last >= poll_ms)
+            {
+                last = now;
+                polled = true;
+                ok = link_poll();
+            }
+        }
+
+        if (polled)
+        {
+            blink_ms = ok ? 100 : 1000;
 
-            bool ok = true;
-            uint8_t inData[7] = {0};
-            ok &= i2c_write_all(&CMD_GET, 1, 3000);
+            if (ok)
+                status_led.link_ok++;
+            else
+                status_led.link_err++;
+            status_led.link_up = ok;
+#if HARUNA_LOCAL_INPUT
+            if (!ok)
+                remote_report = neutral_report;
+#endif
 
             if (ok)
             {
-                ok &= i2c_read_all(inData, 7, 3000);
-                if (ok)
-                {
-                    // 성공적으로 읽음
-                    // 데이터 파싱
-                    uint16_t buttons = (uint16_t)inData[0] | ((uint16_t)inData[1] << 8);
-                    uint8_t dpad = inData[2];
-                    uint8_t leftX = inData[3];
-                    uint8_t leftY = inData[4];
-                    uint8_t rightX = inData[5];
-                    uint8_t rightY = inData[6];
-
-                    gamepad_report.buttons = buttons;
-                    gamepad_report.dPad = dpad;
-                    gamepad_report.leftXAxis = leftX;
-                    gamepad_report.leftYAxis = leftY;
-                    gamepad_report.rightXAxis = rightX;
-                    gamepad_report.rightYAxis = rightY;
-                }
+                status_push(now);
+                profile_push(now);
+                trace_push();
+                sched_fetch();
+                path_fetch();
             }
-
-        done:
-
-            blink_ms = ok ? 100 : 1000;
+            if (aligned)
+                aligned_plan(time_us_32());
         }
 
         // LED heartbeat
@@ -141,32 +1127,116 @@ int main(void)
             s = !s;
         }
 
-        sleep_ms(1);
+        uint32_t loop_us = time_us_32() - loop_start;
+        if (loop_us > loop_max_us)
+            loop_max_us = loop_us;
+
+        if (aligned)
+        {
+            // tud_task still has to run every frame
+            int32_t wait = (int32_t)(aligned_read_at - time_us_32());
+            if (wait > 0)
+                sleep_us((uint64_t)MIN(wait, 1000));
+        }
+        else
+        {
+            sleep_ms(1);
+        }
+    }
+}
+
+static void set_usb_state(uint8_t set, uint8_t clear)
+{
+    uint8_t state = (uint8_t)((link_status.usb_state & ~clear) | set);
+    if (state != link_status.usb_state)
+    {
+        link_status.usb_state = state;
+        status_dirty = true;
     }
+    status_led.usb_mounted = (state & BOARDLINK_USB_MOUNTED) && !(state & BOARDLINK_USB_SUSPENDED);
 }
 
-void tud_mount_cb(void) {}
-void tud_umount_cb(void) {}
-void tud_suspend_cb(bool remote_wakeup_en) { (void)remote_wakeup_en; }
-void tud_resume_cb(void) {}
+void tud_mount_cb(void)
+{
+    set_usb_state(BOARDLINK_USB_MOUNTED, BOARDLINK_USB_SUSPENDED);
+}
+
+void tud_umount_cb(void)
+{
+    last_complete_us = 0;
+    sof_reset();
+    set_usb_state(0, BOARDLINK_USB_MOUNTED | BOARDLINK_USB_SUSPENDED);
+}
+
+void tud_suspend_cb(bool remote_wakeup_en)
+{
+    last_complete_us = 0;
+    sof_reset();
+    set_usb_state(BOARDLINK_USB_SUSPENDED | (remote_wakeup_en ? BOARDLINK_USB_REMOTE_WAKEUP : 0),
+                  BOARDLINK_USB_REMOTE_WAKEUP);
+}
+
+void tud_resume_cb(void)
+{
+    set_usb_state(0, BOARDLINK_USB_SUSPENDED);
+}
 
 // ========================
 // HID Task
 // ========================
 
-void send_gamepad_report(void)
+// report_state -> the descriptor's report, sticks cut down to 8 bit here
+static void HARUNA_HOT(fill_gamepad_report)(void)
 {
-    // skip if hid is not ready
+    gamepad_report.buttons = report_state.buttons;
+    gamepad_report.dPad = report_state.dPad;
+    gamepad_report.leftXAxis = (uint8_t)(report_state.axis[0] >> 8);
+    gamepad_report.leftYAxis = (uint8_t)(report_state.axis[1] >> 8);
+    gamepad_report.rightXAxis = (uint8_t)(report_state.axis[2] >> 8);
+    gamepad_report.rightYAxis = (uint8_t)(report_state.axis[3] >> 8);
+}
+
+void HARUNA_HOT(send_gamepad_report)(void)
+{
+    if (!tud_mounted() || tud_suspended())
+        return;
+
+    uint32_t t_enter = time_us_32();
+
+    // skip if hid is not ready (previous report not fetched by the host yet)
     if (tud_hid_n_ready(ITF_NUM_GAMEPAD))
     {
-        tud_hid_n_report(ITF_NUM_GAMEPAD, 0, &gamepad_report, sizeof(gamepad_report));
+        fill_gamepad_report();
+        if (tud_hid_n_report(ITF_NUM_GAMEPAD, 0, &gamepad_report, sizeof(gamepad_report)))
+        {
+            link_status.frames_sent++;
+            queued_data_us = link_data_us;
+            queued_us = t_enter;
+            queued_frame[0] = (uint8_t)(gamepad_report.buttons & 0xFF);
+            queued_frame[1] = (uint8_t)(gamepad_report.buttons >> 8);
+            queued_frame[2] = gamepad_report.dPad;
+            queued_frame[3] = gamepad_report.leftXAxis;
+            queued_frame[4] = gamepad_report.leftYAxis;
+            queued_frame[5] = gamepad_report.rightXAxis;
+            queued_frame[6] = gamepad_report.rightYAxis;
+        }
+    }
+    else
+    {
+        link_status.frames_skipped++;
+        if (prof_skipped < 0xFFFF)
+            prof_skipped++;
     }
+
+    uint32_t dt = time_us_32() - t_enter;
+    if (dt > report_max_us)
+        report_max_us = dt;
 }
 
 void hid_task(void)
 {
-    // Poll every 10ms
-    const uint32_t interval_ms = 10;
+    // Keep the endpoint armed every frame so report completions follow the host poll rate
+    const uint32_t interval_ms = 1;
     static uint32_t start_ms = 0;
 
     uint32_t now = board_millis();
@@ -174,33 +1244,83 @@ void hid_task(void)
         return;
     start_ms = now;
 
+    report_tick();
+}
+
+// Scheduled frames, stick paths and local input, then the report. Paths are
+// evaluated for the frame the report is aimed at when the SOF grid is known.
+static void HARUNA_HOT(report_tick)(void)
+{
+    uint32_t now = time_us_32();
+    sched_run(now);
+    path_run(sof_ready() ? sof_time(aligned_frame) : now);
+#if HARUNA_LOCAL_INPUT
+    merge_local_input();
+#endif
     send_gamepad_report();
 }
 
-void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len)
+void HARUNA_HOT(tud_hid_report_complete_cb)(uint8_t instance, uint8_t const *report, uint16_t len)
 {
     (void)len;
     (void)report;
     (void)instance;
     // Don't send from callback, let hid_task() and keyboard_task() handle periodic sending
+
+    uint32_t now = time_us_32();
+    if (last_complete_us != 0)
+    {
+        uint32_t dt = now - last_complete_us;
+        if (dt > 0xFFFF)
+            dt = 0xFFFF;
+        hist_add(&prof_poll, dt);
+        link_status.poll_us_last = (uint16_t)dt;
+        link_status.poll_us_avg = link_status.poll_us_avg
+                                      ? (uint16_t)(link_status.poll_us_avg + ((int32_t)dt - link_status.poll_us_avg) / 8)
+                                      : (uint16_t)dt;
+    }
+    last_complete_us = now;
+
+    // time_us_32 starts at reset
+    if (!link_status.boot_report_ms)
+    {
+        link_status.boot_report_ms = (uint16_t)MAX(MIN(now / 1000u, 0xFFFFu), 1u);
+        status_dirty = true;
+    }
+
+    hist_add(&prof_queue, now - queued_us);
+    trace_record(now);
+
+    // upper bound: includes the time until tud_task got to the completion
+    if (queued_data_us != 0)
+        age_record(now - queued_data_us);
 }
 
 uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen)
 {
     (void)instance;
     (void)report_id;
-    (void)report_type;
-    (void)buffer;
-    (void)reqlen;
 
-    return 0;
+    if (report_type != HID_REPORT_TYPE_INPUT)
+        return 0;
+
+    fill_gamepad_report();
+    uint16_t len = reqlen < sizeof(gamepad_report) ? reqlen : (uint16_t)sizeof(gamepad_report);
+    memcpy(buffer, &gamepad_report, len);
+    return len;
 }
 
 void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize)
 {
     (void)instance;
-    (void)report_id;
     (void)report_type;
-    (void)buffer;
-    (void)bufsize;
+
+    // rumble / player LED etc. Keep the head of the report for the host to decode.
+    uint16_t n = bufsize < BOARDLINK_OUT_REPORT_MAX ? bufsize : BOARDLINK_OUT_REPORT_MAX;
+    memset(link_status.out_report, 0, sizeof(link_status.out_report));
+    memcpy(link_status.out_report, buffer, n);
+    link_status.out_report_id = report_id;
+    link_status.out_report_len = bufsize > 0xFF ? 0xFF : (uint8_t)bufsize;
+    link_status.out_report_seq++;
+    status_dirty = true;
 }
\ No newline at end of file
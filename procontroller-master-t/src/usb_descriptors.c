@@ -2,6 +2,7 @@
 #include "usb_descriptors.h"
 #include "class/hid/hid.h"
 #include "device/usbd.h"
+#include "pico/unique_id.h"
 
 //--------------------------------------------------------------------+
 // Device Descriptors
@@ -168,9 +169,12 @@ char const *string_desc_arr[] =
         (const char[]){0x09, 0x04}, // 0: is supported language is English (0x0409)
         "Nintendo Co., Ltd",        // 1: Manufacturer
         "Pro Controller",           // 2: Product
-        "000000000001",             // 3: Serials
+        NULL,                       // 3: Serials, from the flash unique id
 };
 
+// Distinct per board, so consoles and hosts can tell several masters apart
+static char serial_str[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+
 static uint16_t _desc_str[32];
 
 // Invoked when received GET STRING DESCRIPTOR request
@@ -195,6 +199,12 @@ uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid)
       return NULL;
 
     const char *str = string_desc_arr[index];
+    if (index == 3)
+    {
+      if (!serial_str[0])
+        pico_get_unique_board_id_string(serial_str, sizeof(serial_str));
+      str = serial_str;
+    }
 
     // Cap at max char
     chr_count = strlen(str);
@@ -0,0 +1,46 @@
+# Lean firmware build profile
+#
+#   cmake -DHARUNA_PERF_BUILD=ON ..
+#
+# Turns off C++ exceptions and RTTI, moves the functions marked HARUNA_HOT()
+# (see src/perf.h) into RAM and checks after linking that nothing pulled in
+# the heap. A <target>.size.txt report is written next to the ELF in both
+# profiles so the two can be compared.
+#
+# Include this after project() and before pico_sdk_init().
+
+option(HARUNA_PERF_BUILD "No exceptions/RTTI, RAM resident hot paths, no heap" OFF)
+
+if(HARUNA_PERF_BUILD)
+    set(PICO_CXX_ENABLE_EXCEPTIONS 0)
+    set(PICO_CXX_ENABLE_RTTI 0)
+else()
+    set(PICO_CXX_ENABLE_EXCEPTIONS 1)
+    set(PICO_CXX_ENABLE_RTTI 1)
+endif()
+
+set(HARUNA_PERF_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+function(haruna_build_profile target)
+    if(HARUNA_PERF_BUILD)
+        target_compile_definitions(${target} PRIVATE HARUNA_PERF_BUILD=1)
+        target_compile_options(${target} PRIVATE
+            $<$<COMPILE_LANGUAGE:CXX>:-fno-exceptions -fno-rtti>)
+    endif()
+    target_link_options(${target} PRIVATE -Wl,--print-memory-usage)
+
+    get_filename_component(_tool_dir ${CMAKE_C_COMPILER} DIRECTORY)
+    find_program(HARUNA_SIZE arm-none-eabi-size HINTS ${_tool_dir})
+    find_program(HARUNA_NM arm-none-eabi-nm HINTS ${_tool_dir})
+    if(HARUNA_SIZE AND HARUNA_NM)
+        add_custom_command(TARGET ${target} POST_BUILD
+            COMMAND ${CMAKE_COMMAND}
+                -DELF=$<TARGET_FILE:${target}>
+                -DSIZE=${HARUNA_SIZE}
+                -DNM=${HARUNA_NM}
+                -DPERF=${HARUNA_PERF_BUILD}
+                -DOUT=$<TARGET_FILE_DIR:${target}>/${target}.size.txt
+                -P ${HARUNA_PERF_DIR}/size_report.cmake
+            VERBATIM)
+    endif()
+endfunction()
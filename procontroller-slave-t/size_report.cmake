@@ -0,0 +1,53 @@
+# Post build size report, run by haruna_build_profile() in perf_build.cmake
+#
+# Inputs: ELF, SIZE, NM, PERF, OUT
+
+execute_process(COMMAND ${SIZE} -A ${ELF} OUTPUT_VARIABLE _sections)
+execute_process(COMMAND ${NM} -C --size-sort -S ${ELF} OUTPUT_VARIABLE _symbols)
+
+set(_flash 0)
+set(_ram 0)
+string(REPLACE "\n" ";" _lines "${_sections}")
+foreach(_line IN LISTS _lines)
+    if(_line MATCHES "^\\.(boot2|text|rodata|binary_info|ARM\\.exidx|ARM\\.extab)[ \t]+([0-9]+)")
+        math(EXPR _flash "${_flash} + ${CMAKE_MATCH_2}")
+    elseif(_line MATCHES "^\\.(data|bss|ram_vector_table|uninitialized_data|scratch_x|scratch_y)[ \t]+([0-9]+)")
+        math(EXPR _ram "${_ram} + ${CMAKE_MATCH_2}")
+    endif()
+    if(_line MATCHES "^\\.data[ \t]+([0-9]+)")
+        # .data is stored in flash as well
+        math(EXPR _flash "${_flash} + ${CMAKE_MATCH_1}")
+    endif()
+endforeach()
+
+# functions copied to RAM by __not_in_flash_func() end up in .data
+set(_ram_funcs "")
+set(_heap "")
+string(REPLACE "\n" ";" _lines "${_symbols}")
+foreach(_line IN LISTS _lines)
+    if(_line MATCHES "^2[0-9a-f]+ ([0-9a-f]+) [Tt] (.+)$")
+        string(APPEND _ram_funcs "  ${CMAKE_MATCH_2} (0x${CMAKE_MATCH_1} bytes)\n")
+    endif()
+    if(_line MATCHES " [Tt] (malloc|_malloc_r|operator new)")
+        set(_heap "${CMAKE_MATCH_1}")
+    endif()
+endforeach()
+
+if(_heap STREQUAL "")
+    set(_heap_text "not linked")
+else()
+    set(_heap_text "LINKED (${_heap})")
+endif()
+
+file(WRITE ${OUT}
+    "elf:          ${ELF}\n"
+    "perf build:   ${PERF}\n"
+    "flash:        ${_flash} bytes\n"
+    "static ram:   ${_ram} bytes\n"
+    "heap:         ${_heap_text}\n"
+    "ram functions:\n${_ram_funcs}")
+message(STATUS "size report: flash ${_flash} B, static ram ${_ram} B, heap ${_heap_text}")
+
+if(PERF AND NOT _heap STREQUAL "")
+    message(FATAL_ERROR "perf build links ${_heap}, the firmware must not use the heap")
+endif()
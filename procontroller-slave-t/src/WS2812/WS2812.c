@@ -1,5 +1,7 @@
 #include "WS2812.h"
 #include "WS2812.pio.h"
+#include "hardware/dma.h"
+#include "pico/stdlib.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -10,12 +12,34 @@
 #endif
 
 // Internal helper function (equivalent to the private initialize method)
-static void ws2812_initialize(ws2812_t *ws, uint pin, uint length, PIO pio, uint sm,
+// frames: caller owned storage for 2 * length words, or NULL to allocate
+static void ws2812_initialize(ws2812_t *ws, uint32_t *frames, uint pin, uint length, PIO pio, uint sm,
                               ws2812_data_byte_t b1, ws2812_data_byte_t b2,
                               ws2812_data_byte_t b3, ws2812_data_byte_t b4);
 
 // Internal helper function (equivalent to the private convertData method)
-static uint32_t ws2812_convert_data(ws2812_t *ws, uint32_t rgbw);
+static inline uint32_t ws2812_convert_data(const ws2812_t *ws, uint32_t rgbw);
+
+// 1.25us per bit at 800kHz, plus the >280us low time that latches the frame
+#define WS2812_US_PER_PIXEL_BITS(bits) (((bits) * 5 + 3) / 4)
+#define WS2812_LATCH_US 300
+
+static void ws2812_initialize_format(ws2812_t *ws, uint32_t *frames, uint pin, uint length, PIO pio, uint sm,
+                                     ws2812_data_format_t format)
+{
+    switch (format)
+    {
+    case WS2812_FORMAT_RGB:
+        ws2812_initialize(ws, frames, pin, length, pio, sm, WS2812_BYTE_NONE, WS2812_BYTE_RED, WS2812_BYTE_GREEN, WS2812_BYTE_BLUE);
+        break;
+    case WS2812_FORMAT_GRB:
+        ws2812_initialize(ws, frames, pin, length, pio, sm, WS2812_BYTE_NONE, WS2812_BYTE_GREEN, WS2812_BYTE_RED, WS2812_BYTE_BLUE);
+        break;
+    case WS2812_FORMAT_WRGB:
+        ws2812_initialize(ws, frames, pin, length, pio, sm, WS2812_BYTE_WHITE, WS2812_BYTE_RED, WS2812_BYTE_GREEN, WS2812_BYTE_BLUE);
+        break;
+    }
+}
 
 // Initialization functions
 ws2812_t *ws2812_init(uint pin, uint length, PIO pio, uint sm)
@@ -25,7 +49,7 @@ ws2812_t *ws2812_init(uint pin, uint length, PIO pio, uint sm)
     {
         return NULL;
     }
-    ws2812_initialize(ws, pin, length, pio, sm, WS2812_BYTE_NONE, WS2812_BYTE_GREEN, WS2812_BYTE_RED, WS2812_BYTE_BLUE);
+    ws2812_initialize(ws, NULL, pin, length, pio, sm, WS2812_BYTE_NONE, WS2812_BYTE_GREEN, WS2812_BYTE_RED, WS2812_BYTE_BLUE);
     return ws;
 }
 
@@ -37,18 +61,18 @@ ws2812_t *ws2812_init_format(uint pin, uint length, PIO pio, uint sm, ws2812_dat
         return NULL;
     }
 
-    switch (format)
+    ws2812_initialize_format(ws, NULL, pin, length, pio, sm, format);
+    return ws;
+}
+
+ws2812_t *ws2812_init_static(ws2812_t *ws, uint32_t *frames, uint pin, uint length, PIO pio, uint sm,
+                             ws2812_data_format_t format)
+{
+    if (ws == NULL || frames == NULL)
     {
-    case WS2812_FORMAT_RGB:
-        ws2812_initialize(ws, pin, length, pio, sm, WS2812_BYTE_NONE, WS2812_BYTE_RED, WS2812_BYTE_GREEN, WS2812_BYTE_BLUE);
-        break;
-    case WS2812_FORMAT_GRB:
-        ws2812_initialize(ws, pin, length, pio, sm, WS2812_BYTE_NONE, WS2812_BYTE_GREEN, WS2812_BYTE_RED, WS2812_BYTE_BLUE);
-        break;
-    case WS2812_FORMAT_WRGB:
-        ws2812_initialize(ws, pin, length, pio, sm, WS2812_BYTE_WHITE, WS2812_BYTE_RED, WS2812_BYTE_GREEN, WS2812_BYTE_BLUE);
-        break;
+        return NULL;
     }
+    ws2812_initialize_format(ws, frames, pin, length, pio, sm, format);
     return ws;
 }
 
@@ -60,7 +84,7 @@ ws2812_t *ws2812_init_bytes_3(uint pin, uint length, PIO pio, uint sm,
     {
         return NULL;
     }
-    ws2812_initialize(ws, pin, length, pio, sm, b1, b1, b2, b3);
+    ws2812_initialize(ws, NULL, pin, length, pio, sm, b1, b1, b2, b3);
     return ws;
 }
 
@@ -73,7 +97,7 @@ ws2812_t *ws2812_init_bytes_4(uint pin, uint length, PIO pio, uint sm,
     {
         return NULL;
     }
-    ws2812_initialize(ws, pin, length, pio, sm, b1, b2, b3, b4);
+    ws2812_initialize(ws, NULL, pin, length, pio, sm, b1, b2, b3, b4);
     return ws;
 }
 
@@ -82,16 +106,25 @@ void ws2812_free(ws2812_t *ws)
 {
     if (ws != NULL)
     {
-        if (ws->data != NULL)
+        if (ws->dma_chan >= 0)
+        {
+            dma_channel_wait_for_finish_blocking((uint)ws->dma_chan);
+            dma_channel_unclaim((uint)ws->dma_chan);
+        }
+        if (ws->static_storage)
         {
-            free(ws->data);
+            return; // ws2812_init_static(): memory belongs to the caller
+        }
+        if (ws->frames[0] != NULL)
+        {
+            free(ws->frames[0]);
         }
         free(ws);
     }
 }
 
 // Internal helper function (equivalent to the private initialize method)
-static void ws2812_initialize(ws2812_t *ws, uint pin, uint length, PIO pio, uint sm,
+static void ws2812_initialize(ws2812_t *ws, uint32_t *frames, uint pin, uint length, PIO pio, uint sm,
                               ws2812_data_byte_t b1, ws2812_data_byte_t b2,
                               ws2812_data_byte_t b3, ws2812_data_byte_t b4)
 {
@@ -99,11 +132,19 @@ static void ws2812_initialize(ws2812_t *ws, uint pin, uint length, PIO pio, uint
     ws->length = length;
     ws->pio = pio;
     ws->sm = sm;
-    ws->data = (uint32_t *)malloc(length * sizeof(uint32_t));
-    if (ws->data != NULL)
+    ws->static_storage = frames != NULL;
+
+    // both frames in one block: frames[0] | frames[1]
+    ws->frames[0] = frames != NULL ? frames : (uint32_t *)malloc(2 * length * sizeof(uint32_t));
+    ws->frames[1] = ws->frames[0] != NULL ? ws->frames[0] + length : NULL;
+    if (ws->frames[0] != NULL)
     {
-        memset(ws->data, 0, length * sizeof(uint32_t));
+        memset(ws->frames[0], 0, 2 * length * sizeof(uint32_t));
     }
+    ws->front = 0;
+    ws->data = ws->frames[1];
+    ws->busy_until_us = 0;
+
     ws->bytes[0] = b1;
     ws->bytes[1] = b2;
     ws->bytes[2] = b3;
@@ -112,6 +153,31 @@ static void ws2812_initialize(ws2812_t *ws, uint pin, uint length, PIO pio, uint
     uint offset = pio_add_program(pio, &ws2812_program);
     uint bits = (b1 == WS2812_BYTE_NONE ? 24 : 32);
 
+    // Resolve the channel order once. The PIO shifts out MSB first, so byte
+    // position n (0 = first on the wire) sits at bit 24 - 8n. In 24 bit mode
+    // the first byte slot is unused and b2..b4 go out.
+    memset(ws->shift, 0, sizeof(ws->shift));
+    memset(ws->mask, 0, sizeof(ws->mask));
+    for (uint n = (bits == 24 ? 1 : 0); n < 4; n++)
+    {
+        if (ws->bytes[n] == WS2812_BYTE_NONE)
+            continue;
+        uint src = (uint)ws->bytes[n] - WS2812_BYTE_RED; // R=0, G=1, B=2, W=3
+        ws->shift[src] = (uint8_t)(bits == 24 ? 32 - 8 * n : 24 - 8 * n);
+        ws->mask[src] = 0xFF;
+    }
+
+    ws->dma_chan = dma_claim_unused_channel(false);
+    if (ws->dma_chan >= 0)
+    {
+        dma_channel_config c = dma_channel_get_default_config((uint)ws->dma_chan);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+        channel_config_set_read_increment(&c, true);
+        channel_config_set_write_increment(&c, false);
+        channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+        dma_channel_configure((uint)ws->dma_chan, &c, &pio->txf[sm], NULL, 0, false);
+    }
+
 #ifdef DEBUG
     printf("WS2812 / Initializing SM %u with offset %X at pin %u and %u data bits...\n", sm, offset, pin, bits);
 #endif
@@ -120,29 +186,12 @@ static void ws2812_initialize(ws2812_t *ws, uint pin, uint length, PIO pio, uint
 }
 
 // Internal helper function (equivalent to the private convertData method)
-static uint32_t ws2812_convert_data(ws2812_t *ws, uint32_t rgbw)
+static inline uint32_t ws2812_convert_data(const ws2812_t *ws, uint32_t rgbw)
 {
-    uint32_t result = 0;
-    for (uint b = 0; b < 4; b++)
-    {
-        switch (ws->bytes[b])
-        {
-        case WS2812_BYTE_RED:
-            result |= (rgbw & 0xFF);
-            break;
-        case WS2812_BYTE_GREEN:
-            result |= (rgbw & 0xFF00) >> 8;
-            break;
-        case WS2812_BYTE_BLUE:
-            result |= (rgbw & 0xFF0000) >> 16;
-            break;
-        case WS2812_BYTE_WHITE:
-            result |= (rgbw & 0xFF000000) >> 24;
-            break;
-        }
-        result <<= 8;
-    }
-    return result;
+    return ((rgbw & ws->mask[0]) << ws->shift[0]) |
+           (((rgbw >> 8) & ws->mask[1]) << ws->shift[1]) |
+           (((rgbw >> 16) & ws->mask[2]) << ws->shift[2]) |
+           (((rgbw >> 24) & ws->mask[3]) << ws->shift[3]);
 }
 
 // Color utility functions
@@ -212,12 +261,29 @@ void ws2812_fill_range(ws2812_t *ws, uint32_t color, uint first, uint count)
     }
 }
 
-// Display function
-void ws2812_show(ws2812_t *ws)
+// Display functions
+bool ws2812_busy(ws2812_t *ws)
+{
+    if (ws == NULL)
+    {
+        return false;
+    }
+    if (ws->dma_chan >= 0 && dma_channel_is_busy((uint)ws->dma_chan))
+    {
+        return true;
+    }
+    return time_us_64() < ws->busy_until_us;
+}
+
+bool ws2812_show_async(ws2812_t *ws)
 {
     if (ws == NULL || ws->data == NULL)
     {
-        return;
+        return false;
+    }
+    if (ws2812_busy(ws))
+    {
+        return false;
     }
 
 #ifdef DEBUG
@@ -227,8 +293,39 @@ void ws2812_show(ws2812_t *ws)
     }
 #endif
 
-    for (uint i = 0; i < ws->length; i++)
+    // back buffer becomes the frame on the wire, keep drawing on a copy of it
+    uint8_t back = (uint8_t)(ws->front ^ 1);
+    ws->front = back;
+    ws->data = ws->frames[back ^ 1];
+    memcpy(ws->data, ws->frames[back], ws->length * sizeof(uint32_t));
+
+    uint bits = (ws->bytes[0] == WS2812_BYTE_NONE ? 24 : 32);
+    ws->busy_until_us = time_us_64() + (uint64_t)ws->length * WS2812_US_PER_PIXEL_BITS(bits) + WS2812_LATCH_US;
+
+    if (ws->dma_chan >= 0)
+    {
+        dma_channel_transfer_from_buffer_now((uint)ws->dma_chan, ws->frames[back], ws->length);
+    }
+    else
+    {
+        // no DMA channel left, fall back to feeding the FIFO from the CPU
+        for (uint i = 0; i < ws->length; i++)
+        {
+            pio_sm_put_blocking(ws->pio, ws->sm, ws->frames[back][i]);
+        }
+    }
+    return true;
+}
+
+void ws2812_show(ws2812_t *ws)
+{
+    if (ws == NULL || ws->data == NULL)
     {
-        pio_sm_put_blocking(ws->pio, ws->sm, ws->data[i]);
+        return;
     }
-}
\ No newline at end of file
+
+    while (!ws2812_show_async(ws))
+    {
+        tight_loop_contents();
+    }
+}
@@ -1,10 +1,13 @@
 #include "pico/types.h"
+#include "WS2812/WS2812.h"
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+    extern ws2812_t *ledStrip;
+
     void rainbowWS2812(uint32_t percentage);
     void initLEDStrip();
 
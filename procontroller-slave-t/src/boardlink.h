@@ -0,0 +1,280 @@
+#ifndef BOARDLINK_H
+#define BOARDLINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// ---------- Master <-> Slave I2C link ----------
+// Keep identical in procontroller-master-t and procontroller-slave-t.
+
+#define BOARDLINK_SLAVE_ADDR 0x55
+
+// Several masters can share the bus, one per console. The low nibble of a
+// command is the master's controller index, GET is followed by a repeated
+// start so no other master can slip in before the read.
+#define BOARDLINK_MAX_CONTROLLERS 4
+#define BOARDLINK_CMD_MASK 0xF0
+#define BOARDLINK_CMD_INDEX(cmd) ((uint8_t)((cmd) & 0x0F))
+
+    enum
+    {
+        BOARDLINK_CMD_GET = 0x10,         // | index, master then reads that controller's 7 byte frame + boardlink_sync_t
+        BOARDLINK_CMD_STATUS = 0x20,      // | index, followed by boardlink_status_t
+        BOARDLINK_CMD_PROFILE = 0x30,     // | index, followed by boardlink_profile_t
+        BOARDLINK_CMD_TRACE = 0x40,       // | index, followed by boardlink_trace_t
+        BOARDLINK_CMD_PATH = 0x50,        // | index, master then reads one boardlink_path_t (repeated start like GET)
+        BOARDLINK_CMD_READ = 0x60,        // | index, reg, len, master then reads len bytes of boardlink_regs_t from reg (repeated start)
+        BOARDLINK_CMD_TEST = 0x70,        // | index, seq, len, then len pattern bytes, or a repeated start read of len pattern bytes
+        BOARDLINK_CMD_TEST_REPORT = 0x80, // | index, followed by boardlink_test_report_t
+    };
+
+#define BOARDLINK_PACKED __attribute__((packed, aligned(1)))
+
+#define BOARDLINK_USB_MOUNTED (1u << 0)
+#define BOARDLINK_USB_SUSPENDED (1u << 1)
+#define BOARDLINK_USB_REMOTE_WAKEUP (1u << 2)
+#define BOARDLINK_USB_SOF_LOCKED (1u << 3) // reports are timed against the console's USB frames
+
+#define BOARDLINK_OUT_REPORT_MAX 8
+
+// Data age of a report: board link read -> report fetched by the console.
+// Bucket n counts ages below BOARDLINK_AGE_BUCKET0_US << n, the last one
+// everything above.
+#define BOARDLINK_AGE_BUCKETS 8
+#define BOARDLINK_AGE_BUCKET0_US 125u
+
+#define BOARDLINK_FRAME_LEN 7
+
+// 16 bit sticks: an axis is frame[3 + n] << 8 | axis_lo[n] (boardlink_regs_t),
+// 32768 = center. The frame byte is the high byte, so an 8 bit reader just
+// drops the low one, and 8 bit values widen without loss.
+    static inline uint16_t boardlink_axis16(uint8_t v)
+    {
+        return (uint16_t)(v << 8 | (v > 128 ? v : 0));
+    }
+
+// Scheduled frames ("apply at slave time T"). The slave hands a frame to the
+// master once T is less than BOARDLINK_SCHED_LEAD_US away, the master applies
+// it on the first report tick at or after T.
+#define BOARDLINK_SCHED_DEPTH 16
+#define BOARDLINK_SCHED_LEAD_US 30000
+
+#define BOARDLINK_SYNC_FRESH (1u << 0) // frame is new since the previous read
+#define BOARDLINK_SYNC_SCHED (1u << 1) // a scheduled frame is due, sched_* hold it
+#define BOARDLINK_SYNC_TRACE (1u << 2) // host wants the report trace (BOARDLINK_CMD_TRACE)
+#define BOARDLINK_SYNC_PATH (1u << 3)  // stick path segments waiting (BOARDLINK_CMD_PATH)
+#define BOARDLINK_SYNC_HIRES (1u << 4) // the frame's sticks have low bytes, read axis_lo
+#define BOARDLINK_SYNC_TRACE_BUSY (1u << 5) // previous trace block not relayed yet, hold the next one
+
+    // Follows the 7 byte frame in every GET read.
+    typedef struct BOARDLINK_PACKED
+    {
+        uint32_t slave_us;     // slave time when the read request arrived
+        uint8_t flags;         // BOARDLINK_SYNC_*
+        uint8_t sched_pending; // more scheduled frames due soon, read again
+        uint32_t sched_at_us;  // slave time to apply sched_frame at
+        uint8_t sched_frame[BOARDLINK_FRAME_LEN];
+    } boardlink_sync_t;
+
+#define BOARDLINK_GET_LEN (BOARDLINK_FRAME_LEN + sizeof(boardlink_sync_t))
+
+// Register map, one per controller. READ returns any span of it, so a poll
+// only moves the bytes it needs; the first BOARDLINK_GET_LEN bytes are what
+// GET returns. A read has GET's side effects for the part it covers:
+// - frame and flags together clear BOARDLINK_SYNC_FRESH
+// - all of sched_frame takes the scheduled frame off the slave's queue
+// New registers go at the end, existing offsets never move.
+#define BOARDLINK_REGS_VERSION 3
+
+#define BOARDLINK_LINK_HOST (1u << 0)    // host has the slave's CDC port open
+#define BOARDLINK_LINK_USB_PAD (1u << 1) // gamepad on the slave's PIO USB port
+
+    typedef struct BOARDLINK_PACKED
+    {
+        uint8_t frame[BOARDLINK_FRAME_LEN];
+        boardlink_sync_t sync;
+        uint8_t frame_seq;      // +1 for every new frame of this controller
+        uint8_t sched_queued;   // scheduled frames queued on the slave, due or not
+        uint8_t path_queued;    // path segments not fetched yet
+        uint8_t link_flags;     // BOARDLINK_LINK_*
+        uint32_t host_frames;   // host messages taken by the slave, all controllers
+        uint16_t frame_drops;   // host frames replaced before their master read them
+        uint16_t parse_errors;  // bad host messages
+        uint16_t sched_lead_ms; // config: how far ahead scheduled frames are handed over
+        uint8_t version;        // BOARDLINK_REGS_VERSION
+        uint8_t size;           // sizeof(boardlink_regs_t) on the slave
+        // version 2: link test config (HARUNA_LINK_TEST masters), 0 = default
+        uint16_t test_rate_hz; // transactions per second, 0 = back to back
+        uint16_t test_khz;     // bus speed, 0 = 100 kHz
+        uint8_t test_len;      // payload bytes, 1..BOARDLINK_TEST_MAX, 0 = 16
+        uint8_t test_mode;     // BOARDLINK_TEST_*
+        // version 3: low bytes of the frame's LX, LY, RX, RY (BOARDLINK_SYNC_HIRES)
+        uint8_t axis_lo[4];
+    } boardlink_regs_t;
+
+#define BOARDLINK_REG(field) ((uint8_t)offsetof(boardlink_regs_t, field))
+// frame, slave clock, flags, sched_pending: a poll while nothing is scheduled
+#define BOARDLINK_POLL_LEN BOARDLINK_REG(sync.sched_at_us)
+// flags .. sched_frame: fetches the due scheduled frame without the frame
+#define BOARDLINK_SCHED_REG BOARDLINK_REG(sync.flags)
+#define BOARDLINK_SCHED_LEN (BOARDLINK_GET_LEN - BOARDLINK_SCHED_REG)
+
+    // Master state pushed to the slave, relayed to the host as-is.
+    typedef struct BOARDLINK_PACKED
+    {
+        uint32_t t_us;          // master time of the snapshot
+        uint8_t usb_state;      // BOARDLINK_USB_*
+        uint8_t out_report_seq; // bumps on every SET_REPORT from the console
+        uint8_t out_report_id;
+        uint8_t out_report_len; // full length, payload is truncated to BOARDLINK_OUT_REPORT_MAX
+        uint16_t poll_us_last;  // last interval between two completed IN reports
+        uint16_t poll_us_avg;   // moving average (1/8)
+        uint32_t frames_sent;
+        uint32_t frames_skipped; // report due but endpoint still busy
+        uint8_t out_report[BOARDLINK_OUT_REPORT_MAX];
+        uint16_t loop_max_us;       // longest main loop pass since the previous status
+        uint16_t report_max_us;     // longest send_gamepad_report() since the previous status
+        uint16_t sched_late_max_us; // worst scheduled frame lateness since the previous status
+        uint16_t age_avg_us;        // data age of the reports fetched since the previous status
+        uint16_t age_max_us;
+        uint8_t age_hist[BOARDLINK_AGE_BUCKETS]; // reports per age bucket, saturates at 255
+        uint16_t boot_report_ms;                 // boot -> first report fetched by the console, 0 until then
+    } boardlink_status_t;
+
+// USB report profile, pushed every BOARDLINK_PROFILE_PERIOD_MS and covering
+// that period. Bucket n counts samples below BOARDLINK_PROFILE_EDGE_US(n), the
+// last one everything above; 1 ms polls land in bucket 2, 8 ms ones in 5.
+#define BOARDLINK_PROFILE_PERIOD_MS 1000
+#define BOARDLINK_PROFILE_BUCKETS 8
+#define BOARDLINK_PROFILE_EDGE_US(n) (375u << (n))
+
+    typedef struct BOARDLINK_PACKED
+    {
+        uint16_t min_us; // 0 when count is empty
+        uint16_t avg_us;
+        uint16_t max_us;
+        uint16_t count[BOARDLINK_PROFILE_BUCKETS];
+    } boardlink_hist_t;
+
+    typedef struct BOARDLINK_PACKED
+    {
+        uint16_t skipped;       // report due but endpoint still busy
+        boardlink_hist_t poll;  // between two completed IN reports
+        boardlink_hist_t queue; // tud_hid_report() -> completion
+    } boardlink_profile_t;
+
+// Report trace: every report the console fetched whose content differs from
+// the one before, stamped in slave time so the host can put it on its clock.
+#define BOARDLINK_TRACE_ENTRIES 4
+
+    typedef struct BOARDLINK_PACKED
+    {
+        uint32_t slave_us; // completion of the IN transfer
+        uint8_t frame[BOARDLINK_FRAME_LEN];
+    } boardlink_trace_entry_t;
+
+    typedef struct BOARDLINK_PACKED
+    {
+        uint8_t count; // valid entries
+        uint8_t lost;  // entries dropped on the master since the previous block
+        boardlink_trace_entry_t entries[BOARDLINK_TRACE_ENTRIES];
+    } boardlink_trace_t;
+
+// Stick paths: instead of every intermediate value the host sends segments
+// (ramps, arcs, circles) and the master evaluates them in fixed point for
+// every report. Segments of one stick run in the order they were sent; while
+// one is active it owns the stick's axes, afterwards the stick stays on its
+// end point until the next host frame moves it.
+#define BOARDLINK_PATH_DEPTH 8 // queued segments per stick on the master
+
+    enum
+    {
+        BOARDLINK_STICK_LEFT = 0,
+        BOARDLINK_STICK_RIGHT = 1,
+    };
+
+    enum
+    {
+        BOARDLINK_PATH_NONE = 0,  // nothing queued (empty read)
+        BOARDLINK_PATH_LINE = 1,  // a -> b
+        BOARDLINK_PATH_ARC = 2,   // ellipse around a with radii b, from angle0 over sweep
+        BOARDLINK_PATH_CLEAR = 3, // drops every queued segment of the controller, sticks stay put
+    };
+
+    // progress -> position; IN_OUT is smoothstep
+    enum
+    {
+        BOARDLINK_EASE_LINEAR = 0,
+        BOARDLINK_EASE_IN = 1,
+        BOARDLINK_EASE_OUT = 2,
+        BOARDLINK_EASE_IN_OUT = 3,
+    };
+
+#define BOARDLINK_PATH_CHAIN (1u << 0) // starts when the stick's previous segment ends, at_us is ignored
+
+    // Angles are 1/65536 turn, 0 points right and a quarter turn up (report
+    // Y is 0 at the top). A circle at R turns/s for d s is sweep R * d * 65536.
+    typedef struct BOARDLINK_PACKED
+    {
+        uint32_t at_us; // slave time the segment starts
+        uint32_t duration_us;
+        uint8_t stick; // BOARDLINK_STICK_*
+        uint8_t shape; // BOARDLINK_PATH_*
+        uint8_t ease;  // BOARDLINK_EASE_*
+        uint8_t flags; // BOARDLINK_PATH_CHAIN
+        uint8_t a[2];  // x, y. LINE: start, ARC: center
+        uint8_t b[2];  // x, y. LINE: end, ARC: radii
+        uint16_t angle0;
+        int32_t sweep; // positive = counterclockwise
+    } boardlink_path_t;
+
+// Link test (masters built with HARUNA_LINK_TEST): instead of polling, the
+// master runs TEST transactions against the slave and verifies every byte.
+// A read returns, and a write must carry, boardlink_test_byte(seq, i) for
+// i = 0 .. len - 1, so a dropped, repeated or shifted byte is caught. Every
+// BOARDLINK_TEST_WINDOW_MS the master pushes a boardlink_test_report_t.
+#define BOARDLINK_TEST_MAX 32
+#define BOARDLINK_TEST_WINDOW_MS 1000
+
+    enum
+    {
+        BOARDLINK_TEST_BOTH = 0,  // reads and writes alternate
+        BOARDLINK_TEST_READ = 1,  // slave -> master
+        BOARDLINK_TEST_WRITE = 2, // master -> slave, checked by the slave
+    };
+
+    static inline uint8_t boardlink_test_byte(uint8_t seq, uint8_t i)
+    {
+        return (uint8_t)(((uint8_t)(seq + i) * 151u) ^ (uint8_t)(i << 4) ^ 0x5Au);
+    }
+
+    typedef struct BOARDLINK_PACKED
+    {
+        uint32_t window_us; // master time the window covered
+        uint32_t baud;      // actual bus speed (i2c_set_baudrate)
+        uint16_t rate_hz;   // configured, 0 = back to back
+        uint8_t len;
+        uint8_t mode;          // BOARDLINK_TEST_*
+        uint32_t transactions; // started in the window
+        uint32_t ok;           // completed and, for reads, verified
+        uint16_t bad_data;     // read completed with a wrong byte
+        uint16_t nak;          // address / data NAK, arbitration lost
+        uint16_t timeout;
+        uint16_t lat_p50_us; // start -> last byte, completed transactions
+        uint16_t lat_p90_us;
+        uint16_t lat_p99_us;
+        uint16_t lat_max_us;
+        uint32_t slave_rx_ok;  // filled in by the slave: writes that verified
+        uint16_t slave_rx_bad; // filled in by the slave: writes that didn't
+    } boardlink_test_report_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOARDLINK_H
@@ -0,0 +1,103 @@
+#include "hostlink.h"
+#include <string.h>
+
+enum
+{
+    ST_SYNC0 = 0,
+    ST_SYNC1,
+    ST_TYPE,
+    ST_LEN,
+    ST_PAYLOAD,
+    ST_CRC,
+};
+
+// CRC-8, poly 0x07, init 0x00
+uint8_t hostlink_crc8(uint8_t crc, const uint8_t *data, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t b = 0; b < 8; b++)
+        {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+void hostlink_parser_reset(hostlink_parser_t *p)
+{
+    p->state = ST_SYNC0;
+    p->idx = 0;
+}
+
+hostlink_result_t hostlink_parse_byte(hostlink_parser_t *p, uint8_t b, uint8_t *err)
+{
+    switch (p->state)
+    {
+    case ST_SYNC0:
+        if (b == HOSTLINK_H2D_SYNC0)
+            p->state = ST_SYNC1;
+        return HOSTLINK_NONE;
+
+    case ST_SYNC1:
+        if (b == HOSTLINK_H2D_SYNC1)
+            p->state = ST_TYPE;
+        else if (b != HOSTLINK_H2D_SYNC0)
+            p->state = ST_SYNC0;
+        return HOSTLINK_NONE;
+
+    case ST_TYPE:
+        p->type = b;
+        p->state = ST_LEN;
+        return HOSTLINK_NONE;
+
+    case ST_LEN:
+        if (b > HOSTLINK_MAX_PAYLOAD)
+        {
+            hostlink_parser_reset(p);
+            *err = HOSTLINK_ERR_LEN;
+            return HOSTLINK_ERROR;
+        }
+        p->len = b;
+        p->idx = 0;
+        p->state = b ? ST_PAYLOAD : ST_CRC;
+        return HOSTLINK_NONE;
+
+    case ST_PAYLOAD:
+        p->payload[p->idx++] = b;
+        if (p->idx >= p->len)
+            p->state = ST_CRC;
+        return HOSTLINK_NONE;
+
+    case ST_CRC:
+    default:
+    {
+        uint8_t hdr[2] = {p->type, p->len};
+        uint8_t crc = hostlink_crc8(0, hdr, 2);
+        crc = hostlink_crc8(crc, p->payload, p->len);
+        hostlink_parser_reset(p);
+        if (crc != b)
+        {
+            *err = HOSTLINK_ERR_CRC;
+            return HOSTLINK_ERROR;
+        }
+        return HOSTLINK_OK;
+    }
+    }
+}
+
+uint32_t hostlink_encode(uint8_t *out, uint8_t type, const void *payload, uint8_t len)
+{
+    if (len > HOSTLINK_MAX_PAYLOAD)
+        return 0;
+
+    out[0] = HOSTLINK_D2H_SYNC0;
+    out[1] = HOSTLINK_D2H_SYNC1;
+    out[2] = type;
+    out[3] = len;
+    if (len)
+        memcpy(&out[4], payload, len);
+    out[4 + len] = hostlink_crc8(0, &out[2], 2u + len);
+    return HOSTLINK_HEADER_LEN + len + 1u;
+}
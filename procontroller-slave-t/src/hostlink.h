@@ -0,0 +1,175 @@
+#ifndef HOSTLINK_H
+#define HOSTLINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// ---------- Framing ----------
+// SYNC0 SYNC1 TYPE LEN PAYLOAD[LEN] CRC8(TYPE..PAYLOAD)
+//
+// Host -> slave frames start with 55 AA, slave -> host frames with AA 55.
+// The ASCII text ("SLAVE UP\r\n") still printed on the same CDC port never
+// contains 0xAA, so a slave -> host frame is told apart by its first byte.
+#define HOSTLINK_H2D_SYNC0 0x55
+#define HOSTLINK_H2D_SYNC1 0xAA
+#define HOSTLINK_D2H_SYNC0 0xAA
+#define HOSTLINK_D2H_SYNC1 0x55
+
+#define HOSTLINK_HEADER_LEN 4
+#define HOSTLINK_MAX_PAYLOAD 56 // a full frame (61 bytes) fits one 64 byte USB packet and the CDC RX FIFO
+#define HOSTLINK_MAX_FRAME (HOSTLINK_HEADER_LEN + HOSTLINK_MAX_PAYLOAD + 1)
+
+    // Host -> slave
+    enum
+    {
+        HOSTLINK_H_FRAME = 0x01,      // 7 bytes: Buttons0, Buttons1, DPAD, LX, LY, RX, RY (controller 0)
+        HOSTLINK_H_TELEM_CFG = 0x02,  // hostlink_telem_cfg_t
+        HOSTLINK_H_HOST_STATE = 0x03, // 1 byte HOSTLINK_HS_* flags
+        HOSTLINK_H_FRAME_N = 0x04,    // 1 byte controller index + the 7 byte frame
+        HOSTLINK_H_SYNC = 0x05,       // u32 host time (us), answered with HOSTLINK_D_SYNC
+        HOSTLINK_H_FRAME_AT = 0x06,   // hostlink_frame_at_t
+        HOSTLINK_H_TRACE = 0x07,      // 1 byte controller mask: masters that send their report trace
+        HOSTLINK_H_PATH = 0x08,       // 1 byte controller index + boardlink_path_t
+        HOSTLINK_H_LINK_TEST = 0x09,  // hostlink_link_test_t
+        HOSTLINK_H_FRAME16 = 0x0A,    // 1 byte controller index + 7 byte frame + low bytes of LX, LY, RX, RY
+    };
+
+    // Slave -> host
+    enum
+    {
+        HOSTLINK_D_TELEM = 0x81,          // hostlink_telem_t
+        HOSTLINK_D_EVENTS = 0x82,         // n * hostlink_event_t
+        HOSTLINK_D_MASTER_STATUS = 0x83,  // 1 byte controller index + boardlink_status_t, relayed from that master
+        HOSTLINK_D_SYNC = 0x84,           // hostlink_sync_t
+        HOSTLINK_D_MASTER_PROFILE = 0x85, // 1 byte controller index + boardlink_profile_t, relayed from that master
+        HOSTLINK_D_TRACE = 0x86,          // 1 byte controller index + boardlink_trace_t, relayed from that master
+        HOSTLINK_D_LINK_TEST = 0x87,      // 1 byte controller index + boardlink_test_report_t, relayed from that master
+    };
+
+    // Parse error reasons (event arg)
+    enum
+    {
+        HOSTLINK_ERR_LEN = 1,
+        HOSTLINK_ERR_CRC = 2,
+        HOSTLINK_ERR_TYPE = 3,
+        HOSTLINK_ERR_PAYLOAD = 4,
+    };
+
+    // Event codes
+    enum
+    {
+        HOSTLINK_EV_BOOT = 1,
+        HOSTLINK_EV_PARSE_ERR = 2,   // arg = HOSTLINK_ERR_*
+        HOSTLINK_EV_DROP = 3,        // host frame overwritten before the master read it, arg = controller
+        HOSTLINK_EV_MASTER_LOST = 4, // arg = controller
+        HOSTLINK_EV_MASTER_BACK = 5, // arg = controller
+        HOSTLINK_EV_CFG = 6,         // arg = new rate (Hz)
+        HOSTLINK_EV_SCHED_DROP = 7,  // scheduled frame queue full, arg = controller
+        HOSTLINK_EV_PATH_DROP = 8,   // stick path queue full, arg = controller
+    };
+
+#define HOSTLINK_PACKED __attribute__((packed, aligned(1)))
+
+#define HOSTLINK_TELEM_MAX_HZ 100
+
+    typedef struct HOSTLINK_PACKED
+    {
+        uint8_t rate_hz;    // 0 = off, 1..100
+        uint8_t event_mask; // bit n enables event code n + 1
+    } hostlink_telem_cfg_t;
+
+#define HOSTLINK_HS_MACRO_RUNNING (1u << 0)
+
+#define HOSTLINK_TF_USB_MOUNTED (1u << 0)
+#define HOSTLINK_TF_MASTER_ALIVE (1u << 1) // any master
+#define HOSTLINK_TF_USB_PAD (1u << 2)      // a pad is mounted on the PIO USB port
+
+    typedef struct HOSTLINK_PACKED
+    {
+        uint32_t t_us; // slave time of the snapshot
+        uint32_t rdreq;
+        uint32_t rxfull;
+        uint32_t stop;
+        uint32_t host_frames;
+        uint16_t parse_err;
+        uint16_t drops;
+        uint8_t queue_depth;   // host frames not yet read by their master
+        uint8_t flags;         // HOSTLINK_TF_*
+        uint16_t isr_max_us;   // longest I2C ISR since the previous snapshot
+        uint16_t loop_max_us;  // longest main loop pass (without the 1 ms sleep)
+        uint8_t masters_alive; // bit per controller index
+        uint16_t boot_link_ms; // boot -> first GET from a master, 0 until then
+        uint16_t boot_usb_ms;  // boot -> USB mounted, 0 until then
+    } hostlink_telem_t;
+
+    typedef struct HOSTLINK_PACKED
+    {
+        uint32_t t_us;
+        uint8_t code;
+        uint8_t arg;
+    } hostlink_event_t;
+
+    // Clock sync reply (NTP style). The host estimates
+    //   offset = ((rx_us - host_us) + (tx_us - host_rx)) / 2
+    // from the exchanges with the smallest round trip.
+    typedef struct HOSTLINK_PACKED
+    {
+        uint32_t host_us; // echoed from HOSTLINK_H_SYNC
+        uint32_t rx_us;   // slave time the request was parsed
+        uint32_t tx_us;   // slave time the reply was queued
+    } hostlink_sync_t;
+
+    // Frame to apply at slave time at_us, see BOARDLINK_SCHED_*.
+    typedef struct HOSTLINK_PACKED
+    {
+        uint8_t controller;
+        uint32_t at_us;
+        uint8_t frame[7];
+    } hostlink_frame_at_t;
+
+    // Board link test config for a HARUNA_LINK_TEST master, see BOARDLINK_TEST_*.
+    // 0 picks the default (back to back, 100 kHz, 16 bytes, reads and writes).
+    typedef struct HOSTLINK_PACKED
+    {
+        uint8_t controller;
+        uint16_t rate_hz; // transactions per second
+        uint16_t khz;     // bus speed, up to 1000
+        uint8_t len;      // payload bytes, up to BOARDLINK_TEST_MAX
+        uint8_t mode;     // BOARDLINK_TEST_*
+    } hostlink_link_test_t;
+
+    // ---------- Parser ----------
+    typedef struct
+    {
+        uint8_t state;
+        uint8_t type;
+        uint8_t len;
+        uint8_t idx;
+        uint8_t payload[HOSTLINK_MAX_PAYLOAD];
+    } hostlink_parser_t;
+
+    typedef enum
+    {
+        HOSTLINK_NONE = 0, // need more bytes
+        HOSTLINK_OK,       // parser->type/len/payload hold a complete frame
+        HOSTLINK_ERROR,    // bad frame, *err holds HOSTLINK_ERR_*
+    } hostlink_result_t;
+
+    uint8_t hostlink_crc8(uint8_t crc, const uint8_t *data, uint32_t len);
+
+    void hostlink_parser_reset(hostlink_parser_t *p);
+    hostlink_result_t hostlink_parse_byte(hostlink_parser_t *p, uint8_t b, uint8_t *err);
+
+    // Encode a slave -> host frame into out (HOSTLINK_MAX_FRAME bytes), returns frame length or 0.
+    uint32_t hostlink_encode(uint8_t *out, uint8_t type, const void *payload, uint8_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOSTLINK_H
@@ -12,6 +12,7 @@
 #include "hardware/adc.h"
 #include "hardware/i2c.h"
 #include "hardware/gpio.h"
+#include "hardware/sync.h"
 
 #include "tusb.h"
 #include "tusb_config.h"
@@ -20,10 +21,17 @@
 #include "bsp/board_api.h"
 #include "class/hid/hid.h"
 #include "class/hid/hid_device.h"
-#include <vector>
 
 #include "WS2812/WS2812.h"
 #include "WS2812/custom.h"
+#include "WS2812/status_led.h"
+#include "boardlink.h"
+#include "hostlink.h"
+#include "perf.h"
+#include "telemetry.h"
+#if HARUNA_USB_HOST
+#include "usb_pad.h"
+#endif
 #include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
@@ -36,21 +44,27 @@
 #define I2C_SDA_PIN 4
 #define I2C_SCL_PIN 5
 #define I2C_BAUD 100000
-#define SLAVE_ADDR 0x55
+#define SLAVE_ADDR BOARDLINK_SLAVE_ADDR
 
 // ---------- Protocol ----------
-static uint8_t toSend[7] = {
-    0,
-    0, // buttons
-    0, // dpad
-    128,
-    128, // left stick
-    128,
-    128, // right stick
+#define CONTROLLERS BOARDLINK_MAX_CONTROLLERS
+#define FRAME_LEN BOARDLINK_FRAME_LEN
+
+// one frame per controller index, read by the master with the same index.
+// Neutral until the host sends one (dpad 0x0F = released).
+static uint8_t toSend[CONTROLLERS][FRAME_LEN] = {
+    {0, 0, 0x0F, 128, 128, 128, 128},
+    {0, 0, 0x0F, 128, 128, 128, 128},
+    {0, 0, 0x0F, 128, 128, 128, 128},
+    {0, 0, 0x0F, 128, 128, 128, 128},
 };
 
+// low bytes of toSend's sticks (boardlink_axis16 scale), from HOSTLINK_H_FRAME16
+static uint8_t axis_lo[CONTROLLERS][4] = {{0}};
+static volatile uint8_t hires_mask = 0; // bit per controller with a non-zero axis_lo
+
 // TX burst
-static uint8_t tx_buf[32];
+static uint8_t tx_buf[sizeof(boardlink_regs_t)];
 static volatile uint8_t tx_len = 0;
 static volatile uint8_t tx_idx = 0;
 
@@ -63,19 +77,370 @@ static volatile uint32_t log_flags = 0;
 static volatile uint32_t isr_rdreq = 0;
 static volatile uint32_t isr_rxfull = 0;
 static volatile uint32_t isr_stop = 0;
+static volatile uint32_t isr_rdreq_n[CONTROLLERS] = {0};
+
+// boot -> first GET served / USB mounted (time_us_32 starts at reset), 0 until
+// it happened
+static volatile uint32_t boot_link_us = 0;
+static uint32_t boot_usb_us = 0;
+
+// bit n set by a new host frame for controller n, cleared once its master
+// has read it
+static volatile uint8_t frame_pending = 0;
+
+// controller selected by the last GET command
+static volatile uint8_t tx_controller = 0;
 
-static inline void prepare_tx_from_pending(void)
+// register span of the last READ command
+static volatile uint8_t tx_reg = 0;
+static volatile uint8_t tx_reg_len = BOARDLINK_GET_LEN;
+
+// register map inputs kept by the main loop
+static volatile uint8_t frame_seq[CONTROLLERS] = {0};
+static volatile uint8_t link_flags = 0; // BOARDLINK_LINK_*
+static volatile uint32_t host_frames = 0;
+static volatile uint16_t parse_errors = 0;
+static volatile uint16_t frame_drops = 0;
+
+// controllers whose master should send its report trace (HOSTLINK_H_TRACE)
+static volatile uint8_t trace_mask = 0;
+
+// Scheduled frames per controller, in time order. Filled by the main loop,
+// handed to the master one per read by the ISR (single producer / consumer).
+typedef struct
 {
+    uint32_t at_us;
+    uint8_t frame[FRAME_LEN];
+} sched_entry_t;
+
+static sched_entry_t sched[CONTROLLERS][BOARDLINK_SCHED_DEPTH];
+static volatile uint8_t sched_head[CONTROLLERS] = {0};
+static volatile uint8_t sched_tail[CONTROLLERS] = {0};
+
+static inline uint8_t sched_count(uint8_t c)
+{
+    return (uint8_t)(sched_tail[c] - sched_head[c]);
+}
+
+// Stick path segments per controller, same producer / consumer split. The
+// master reads them one at a time with BOARDLINK_CMD_PATH.
+#define PATH_QUEUE 16
+
+static boardlink_path_t path_queue[CONTROLLERS][PATH_QUEUE];
+static volatile uint8_t path_head[CONTROLLERS] = {0};
+static volatile uint8_t path_tail[CONTROLLERS] = {0};
+
+// ---------- Link test (BOARDLINK_CMD_TEST) ----------
+// config per controller, served in the register map
+typedef struct
+{
+    uint16_t rate_hz;
+    uint16_t khz;
+    uint8_t len;
+    uint8_t mode;
+} test_cfg_t;
+
+static test_cfg_t test_cfg[CONTROLLERS];
+static volatile uint32_t test_rx_ok[CONTROLLERS] = {0};
+static volatile uint16_t test_rx_bad[CONTROLLERS] = {0};
+
+// len pattern bytes for seq (tx_reg / tx_reg_len of the TEST command)
+static inline void prepare_tx_test(uint8_t seq, uint8_t len)
+{
+    if (len > BOARDLINK_TEST_MAX)
+        len = BOARDLINK_TEST_MAX;
+    for (uint8_t i = 0; i < len; i++)
+        tx_buf[i] = boardlink_test_byte(seq, i);
+    tx_len = len;
+    tx_idx = 0;
+    isr_rdreq_n[tx_controller]++;
+}
+
+// command of the last GET / PATH / READ / TEST, decides what the next read returns
+static volatile uint8_t tx_cmd = BOARDLINK_CMD_GET;
+
+#if HARUNA_USB_HOST
+// ---------- USB pad (usb_pad.h) ----------
+// USB_PAD_CONTROLLER's frame is the host's frame with the pad merged in.
+// Scheduled frames handed to its master are kept until they are due, then
+// they are the host side of the merge, so a pad report doesn't undo them.
+static uint8_t host_frame[FRAME_LEN] = {0, 0, 0x0F, 128, 128, 128, 128};
+static uint8_t host_lo[4] = {0};
+static uint32_t host_frame_us = 0;
+static sched_entry_t pad_base[BOARDLINK_SCHED_DEPTH];
+static volatile uint8_t pad_base_head = 0;
+static volatile uint8_t pad_base_tail = 0;
+
+static usb_pad_t pad_state = {0, 0x0F, {32768, 32768, 32768, 32768}}; // ISR reads it
+static uint32_t pad_seq = 0;
+static bool pad_present = false;
+static bool pad_pending = false; // frame_pending was set by the pad, not the host
+
+static inline bool stick_centered(const uint8_t *axis, const uint8_t *lo)
+{
+    return axis[0] == 128 && axis[1] == 128 && !lo[0] && !lo[1];
+}
+
+// Buttons are OR'ed. The host's dpad / sticks win whenever they are off
+// center, a stick as a whole so automation never gets one axis of the pad.
+static void HARUNA_HOT(pad_merge)(uint8_t *out, uint8_t *out_lo, const uint8_t *host, const uint8_t *lo,
+                                  const usb_pad_t *pad)
+{
+    uint16_t buttons = (uint16_t)(host[0] | (host[1] << 8)) | pad->buttons;
+    out[0] = (uint8_t)buttons;
+    out[1] = (uint8_t)(buttons >> 8);
+    out[2] = host[2] != 0x0F ? host[2] : pad->hat;
+    for (int i = 0; i < 4; i += 2)
+    {
+        bool host_wins = !stick_centered(&host[3 + i], &lo[i]);
+        for (int n = i; n < i + 2; n++)
+        {
+            out[3 + n] = host_wins ? host[3 + n] : (uint8_t)(pad->axis[n] >> 8);
+            out_lo[n] = host_wins ? lo[n] : (uint8_t)pad->axis[n];
+        }
+    }
+}
+#endif
+
+// trace block waiting for the host, bit per controller (BOARDLINK_SYNC_TRACE_BUSY)
+static volatile uint8_t master_trace_ready = 0;
+
+static inline bool span_covers(uint8_t reg, uint8_t len, uint8_t from, uint8_t size)
+{
+    return reg <= from && reg + len >= from + size;
+}
+
+// Serves [reg, reg + len) of tx_controller's register map (GET is 0 and
+// BOARDLINK_GET_LEN). Only a span that covers them clears FRESH / dequeues
+// the scheduled frame, see boardlink_regs_t.
+static inline void prepare_tx_regs(uint8_t reg, uint8_t len)
+{
+    uint8_t c = tx_controller;
+    uint8_t bit = (uint8_t)(1u << c);
     tx_len = 0;
     tx_idx = 0;
+    if (reg >= sizeof(boardlink_regs_t))
+        return;
+    if (len > sizeof(boardlink_regs_t) - reg)
+        len = (uint8_t)(sizeof(boardlink_regs_t) - reg);
+
+    boardlink_regs_t regs;
+    boardlink_sync_t &sync = regs.sync;
+    memcpy(regs.frame, toSend[c], FRAME_LEN);
+    sync.slave_us = time_us_32();
+    sync.flags = (frame_pending & bit) ? BOARDLINK_SYNC_FRESH : 0;
+    if (trace_mask & bit)
+        sync.flags |= BOARDLINK_SYNC_TRACE;
+    if (path_head[c] != path_tail[c])
+        sync.flags |= BOARDLINK_SYNC_PATH;
+    if (hires_mask & bit)
+        sync.flags |= BOARDLINK_SYNC_HIRES;
+    if (master_trace_ready & bit)
+        sync.flags |= BOARDLINK_SYNC_TRACE_BUSY;
+    sync.sched_at_us = 0;
+    memset(sync.sched_frame, 0, sizeof(sync.sched_frame));
+
+    // only frames that are due soon, the master's queue is short
+    uint8_t head = sched_head[c];
+    uint8_t tail = sched_tail[c];
+    uint8_t due = 0;
+    for (uint8_t i = head; i != tail; i++)
+    {
+        const sched_entry_t *e = &sched[c][i % BOARDLINK_SCHED_DEPTH];
+        if ((int32_t)(e->at_us - sync.slave_us) >= BOARDLINK_SCHED_LEAD_US)
+            break;
+        due++;
+    }
+    if (due)
+    {
+        const sched_entry_t *e = &sched[c][head % BOARDLINK_SCHED_DEPTH];
+        sync.flags |= BOARDLINK_SYNC_SCHED;
+        sync.sched_at_us = e->at_us;
+        memcpy(sync.sched_frame, e->frame, FRAME_LEN);
+        if (span_covers(reg, len, BOARDLINK_REG(sync.sched_frame), FRAME_LEN))
+        {
+#if HARUNA_USB_HOST
+            if (c == USB_PAD_CONTROLLER)
+            {
+                // scheduled frames are 8 bit, the merged low bytes are dropped
+                static const uint8_t no_lo[4] = {0};
+                uint8_t lo[4];
+                pad_merge(sync.sched_frame, lo, e->frame, no_lo, &pad_state);
+                // the master holds at most BOARDLINK_SCHED_DEPTH, so this can't fill up
+                if ((uint8_t)(pad_base_tail - pad_base_head) < BOARDLINK_SCHED_DEPTH)
+                {
+                    pad_base[pad_base_tail % BOARDLINK_SCHED_DEPTH] = *e;
+                    pad_base_tail++;
+                }
+            }
+#endif
+            sched_head[c] = (uint8_t)(head + 1);
+        }
+        due--;
+    }
+    sync.sched_pending = due;
+
+    regs.frame_seq = frame_seq[c];
+    regs.sched_queued = sched_count(c);
+    regs.path_queued = (uint8_t)(path_tail[c] - path_head[c]);
+    regs.link_flags = link_flags;
+    regs.host_frames = host_frames;
+    regs.frame_drops = frame_drops;
+    regs.parse_errors = parse_errors;
+    regs.sched_lead_ms = BOARDLINK_SCHED_LEAD_US / 1000;
+    regs.version = BOARDLINK_REGS_VERSION;
+    regs.size = (uint8_t)sizeof(regs);
+    regs.test_rate_hz = test_cfg[c].rate_hz;
+    regs.test_khz = test_cfg[c].khz;
+    regs.test_len = test_cfg[c].len;
+    regs.test_mode = test_cfg[c].mode;
+    memcpy(regs.axis_lo, axis_lo[c], sizeof(regs.axis_lo));
+
+    memcpy(tx_buf, (const uint8_t *)&regs + reg, len);
+    tx_len = len;
+    if (span_covers(reg, len, 0, BOARDLINK_REG(sync.flags) + 1))
+        frame_pending &= (uint8_t)~bit;
+    isr_rdreq_n[c]++;
+    if (!boot_link_us)
+        boot_link_us = sync.slave_us | 1u;
+}
 
-    memcpy(tx_buf, toSend, sizeof(toSend));
-    tx_len = (uint8_t)sizeof(toSend);
+static_assert(sizeof(boardlink_path_t) <= sizeof(tx_buf), "tx_buf too small");
+static_assert(BOARDLINK_TEST_MAX <= sizeof(tx_buf), "tx_buf too small");
+
+// next path segment of tx_controller, BOARDLINK_PATH_NONE when there is none
+static inline void prepare_tx_path(void)
+{
+    uint8_t c = tx_controller;
+    boardlink_path_t seg;
+    memset(&seg, 0, sizeof(seg));
+    uint8_t head = path_head[c];
+    if (head != path_tail[c])
+    {
+        seg = path_queue[c][head % PATH_QUEUE];
+        path_head[c] = (uint8_t)(head + 1);
+    }
+
+    memcpy(tx_buf, &seg, sizeof(seg));
+    tx_len = (uint8_t)sizeof(seg);
+    tx_idx = 0;
 }
 
+// master write transaction: command byte + payload, committed on STOP
+#define RX_BLOCK_MAX sizeof(boardlink_status_t) // largest master block
+static_assert(sizeof(boardlink_profile_t) <= RX_BLOCK_MAX, "rx_buf too small");
+static_assert(sizeof(boardlink_trace_t) <= RX_BLOCK_MAX, "rx_buf too small");
+static_assert(sizeof(boardlink_test_report_t) <= RX_BLOCK_MAX, "rx_buf too small");
+static_assert(2 + BOARDLINK_TEST_MAX <= RX_BLOCK_MAX, "rx_buf too small");
+static uint8_t rx_buf[1 + RX_BLOCK_MAX];
+static volatile uint8_t rx_len = 0;
+
+static boardlink_status_t master_status[CONTROLLERS];
+static volatile uint8_t master_status_ready = 0; // bit per controller
+static boardlink_profile_t master_profile[CONTROLLERS];
+static volatile uint8_t master_profile_ready = 0;
+static boardlink_trace_t master_trace[CONTROLLERS];
+static uint8_t master_trace_lost[CONTROLLERS]; // entries dropped here, added to the next block
+static boardlink_test_report_t master_test[CONTROLLERS];
+static volatile uint8_t master_test_ready = 0;
+
 static inline void handle_rx_byte(uint8_t b)
 {
     log_flags |= LOG_REQ;
+    // GET / PATH / READ / TEST select what the read that follows returns (repeated start)
+    uint8_t cmd = b & BOARDLINK_CMD_MASK;
+    if (rx_len == 0 &&
+        (cmd == BOARDLINK_CMD_GET || cmd == BOARDLINK_CMD_PATH || cmd == BOARDLINK_CMD_READ || cmd == BOARDLINK_CMD_TEST) &&
+        BOARDLINK_CMD_INDEX(b) < CONTROLLERS)
+    {
+        tx_controller = BOARDLINK_CMD_INDEX(b);
+        tx_cmd = cmd;
+        tx_reg = 0;
+        tx_reg_len = BOARDLINK_GET_LEN;
+    }
+    // READ: reg, len. TEST: seq, len
+    else if ((tx_cmd == BOARDLINK_CMD_READ || tx_cmd == BOARDLINK_CMD_TEST) && rx_len == 1)
+    {
+        tx_reg = b;
+    }
+    else if ((tx_cmd == BOARDLINK_CMD_READ || tx_cmd == BOARDLINK_CMD_TEST) && rx_len == 2)
+    {
+        tx_reg_len = b;
+    }
+    if (rx_len < sizeof(rx_buf))
+        rx_buf[rx_len++] = b;
+}
+
+static inline void commit_rx(void)
+{
+    uint8_t c = BOARDLINK_CMD_INDEX(rx_buf[0]);
+    uint8_t cmd = rx_buf[0] & BOARDLINK_CMD_MASK;
+    if (c >= CONTROLLERS)
+    {
+        rx_len = 0;
+        return;
+    }
+
+    if (cmd == BOARDLINK_CMD_STATUS && rx_len == 1 + sizeof(boardlink_status_t))
+    {
+        memcpy(&master_status[c], &rx_buf[1], sizeof(master_status[c]));
+        master_status_ready |= (uint8_t)(1u << c);
+    }
+    else if (cmd == BOARDLINK_CMD_PROFILE && rx_len == 1 + sizeof(boardlink_profile_t))
+    {
+        memcpy(&master_profile[c], &rx_buf[1], sizeof(master_profile[c]));
+        master_profile_ready |= (uint8_t)(1u << c);
+    }
+    else if (cmd == BOARDLINK_CMD_TRACE && rx_len == 1 + sizeof(boardlink_trace_t))
+    {
+        const boardlink_trace_t *trace = (const boardlink_trace_t *)&rx_buf[1];
+        if (master_trace_ready & (1u << c))
+        {
+            // sent before the master saw TRACE_BUSY: the block in line for
+            // the host stays as it is, this one counts as lost
+            uint16_t lost = (uint16_t)(master_trace_lost[c] + trace->count + trace->lost);
+            master_trace_lost[c] = (uint8_t)MIN(lost, 0xFF);
+        }
+        else
+        {
+            memcpy(&master_trace[c], trace, sizeof(master_trace[c]));
+            uint16_t lost = (uint16_t)(master_trace[c].lost + master_trace_lost[c]);
+            master_trace[c].lost = (uint8_t)MIN(lost, 0xFF);
+            master_trace_lost[c] = 0;
+            master_trace_ready |= (uint8_t)(1u << c);
+        }
+    }
+    else if (cmd == BOARDLINK_CMD_TEST && rx_len > 3)
+    {
+        // a write test; 3 bytes alone are the command of a read test
+        uint8_t seq = rx_buf[1];
+        uint8_t len = rx_buf[2];
+        bool good = len <= BOARDLINK_TEST_MAX && rx_len == 3 + len;
+        for (uint8_t i = 0; good && i < len; i++)
+            good = rx_buf[3 + i] == boardlink_test_byte(seq, i);
+        if (good)
+            test_rx_ok[c]++;
+        else
+            test_rx_bad[c]++;
+    }
+    else if (cmd == BOARDLINK_CMD_TEST_REPORT && rx_len == 1 + sizeof(boardlink_test_report_t))
+    {
+        // a report the host never got hands its slave counts on
+        uint32_t ok = test_rx_ok[c];
+        uint32_t bad = test_rx_bad[c];
+        if (master_test_ready & (1u << c))
+        {
+            ok += master_test[c].slave_rx_ok;
+            bad += master_test[c].slave_rx_bad;
+        }
+        memcpy(&master_test[c], &rx_buf[1], sizeof(master_test[c]));
+        master_test[c].slave_rx_ok = ok;
+        master_test[c].slave_rx_bad = bad;
+        test_rx_ok[c] = 0;
+        test_rx_bad[c] = 0;
+        master_test_ready |= (uint8_t)(1u << c);
+    }
+    rx_len = 0;
 }
 
 // ---------- I2C ISR ----------
@@ -88,25 +453,47 @@ static inline void fill_tx_fifo(i2c_hw_t *hw)
     }
 }
 
-static void i2c0_slave_isr(void)
+// worst case durations since the last telemetry snapshot
+static volatile uint32_t isr_max_us = 0;
+static uint32_t loop_max_us = 0;
+
+static void HARUNA_HOT(i2c0_slave_isr)(void)
 {
+    uint32_t t_enter = time_us_32();
     i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
     uint32_t status = hw->raw_intr_stat;
 
-    // 1) master read request (START + addr(R))
+    // 1) master write rx, drained first so a GET command followed by a
+    //    repeated start selects the controller before the read request
+    if (status & I2C_IC_INTR_STAT_R_RX_FULL_BITS)
+    {
+        isr_rxfull++;
+        while (hw->rxflr)
+        {
+            uint8_t in = (uint8_t)(hw->data_cmd & 0xFF);
+            handle_rx_byte(in);
+        }
+    }
+
+    // 2) master read request (START + addr(R))
     if (status & I2C_IC_INTR_STAT_R_RD_REQ_BITS)
     {
         (void)hw->clr_rd_req;
         isr_rdreq++;
 
         // 새 read 트랜잭션 시작: 전송 버퍼 준비
-        prepare_tx_from_pending();
+        if (tx_cmd == BOARDLINK_CMD_PATH)
+            prepare_tx_path();
+        else if (tx_cmd == BOARDLINK_CMD_TEST)
+            prepare_tx_test(tx_reg, tx_reg_len);
+        else
+            prepare_tx_regs(tx_reg, tx_reg_len);
 
         // TX FIFO를 가능한 만큼 채워두기
         fill_tx_fifo(hw);
     }
 
-    // 2) TX fifo empty -> keep feeding remaining bytes
+    // 3) TX fifo empty -> keep feeding remaining bytes
     if (status & I2C_IC_INTR_STAT_R_TX_EMPTY_BITS)
     {
         fill_tx_fifo(hw);
@@ -114,29 +501,24 @@ static void i2c0_slave_isr(void)
         // 폭주가 심하면 tx_idx>=tx_len일 때 TX_EMPTY mask 잠시 끄는 방식도 가능
     }
 
-    // 3) master write rx
-    if (status & I2C_IC_INTR_STAT_R_RX_FULL_BITS)
-    {
-        isr_rxfull++;
-        while (hw->rxflr)
-        {
-            uint8_t in = (uint8_t)(hw->data_cmd & 0xFF);
-            handle_rx_byte(in);
-        }
-    }
-
     // 4) stop
     if (status & I2C_IC_INTR_STAT_R_STOP_DET_BITS)
     {
         (void)hw->clr_stop_det;
         isr_stop++;
 
+        commit_rx();
         tx_len = 0;
         tx_idx = 0;
+        tx_cmd = BOARDLINK_CMD_GET;
 
         // (선택) TX FIFO flush 느낌으로 intr clear
         (void)hw->clr_intr;
     }
+
+    uint32_t dt = time_us_32() - t_enter;
+    if (dt > isr_max_us)
+        isr_max_us = dt;
 }
 
 static void i2c_slave_init(void)
@@ -173,117 +555,449 @@ static void cdc_write(const char *s)
     tud_cdc_write_flush();
 }
 
-static void cdc_poll_logs(void)
+// ---------- Host link ----------
+static hostlink_parser_t parser;
+
+
+#define MASTER_TIMEOUT_US 100000
+static uint8_t master_alive = 0; // bit per controller
+static uint32_t master_last_rdreq[CONTROLLERS] = {0};
+static uint32_t master_last_us[CONTROLLERS] = {0};
+
+static uint8_t pending_count(void)
+{
+    return (uint8_t)__builtin_popcount(frame_pending);
+}
+
+#if HARUNA_USB_HOST
+// Merges the pad into USB_PAD_CONTROLLER's frame. A pad report only marks it
+// fresh if the merged frame changed, a host frame always does.
+static void pad_publish(const usb_pad_t *pad, bool host)
 {
-    static uint32_t last = 0;
-    uint32_t now = board_millis();
-    if (now - last >= 1000)
-    {
-        last = now;
-        char buf[120];
-        snprintf(buf, sizeof(buf),
-                 "rq=%lu rxf=%lu stop=%lu addr=0x%02X\r\n",
-                 (unsigned long)isr_rdreq,
-                 (unsigned long)isr_rxfull,
-                 (unsigned long)isr_stop,
-                 SLAVE_ADDR);
-        tud_cdc_write_str(buf);
-        tud_cdc_write_flush();
-        sprintf(buf, "sending %d %d %d %d %d %d %d\r\n",
-                toSend[0], toSend[1], toSend[2], toSend[3],
-                toSend[4], toSend[5], toSend[6]);
-        tud_cdc_write_str(buf);
-        tud_cdc_write_flush();
+    uint8_t merged[FRAME_LEN];
+    uint8_t merged_lo[4];
+    pad_merge(merged, merged_lo, host_frame, host_lo, pad);
+    uint8_t bit = (uint8_t)(1u << USB_PAD_CONTROLLER);
+
+    uint32_t irq = save_and_disable_interrupts();
+    pad_state = *pad;
+    if (host || memcmp(toSend[USB_PAD_CONTROLLER], merged, FRAME_LEN) != 0 ||
+        memcmp(axis_lo[USB_PAD_CONTROLLER], merged_lo, sizeof(merged_lo)) != 0)
+    {
+        memcpy(toSend[USB_PAD_CONTROLLER], merged, FRAME_LEN);
+        memcpy(axis_lo[USB_PAD_CONTROLLER], merged_lo, sizeof(merged_lo));
+        if (merged_lo[0] | merged_lo[1] | merged_lo[2] | merged_lo[3])
+            hires_mask |= bit;
+        else
+            hires_mask &= (uint8_t)~bit;
+        frame_pending |= bit;
+        frame_seq[USB_PAD_CONTROLLER]++;
+        pad_pending = !host;
     }
+    restore_interrupts(irq);
 }
 
-// ---------- MAIN ----------
-#define BUF_SIZE 16
+static void pad_poll(uint32_t now_us)
+{
+    usb_pad_t pad;
+    uint32_t seq;
+    pad_present = usb_pad_read(&pad, &seq);
+    bool changed = seq != pad_seq;
+    pad_seq = seq;
+
+    // scheduled frames that are due now, the master applied them
+    while (pad_base_head != pad_base_tail)
+    {
+        const sched_entry_t *e = &pad_base[pad_base_head % BOARDLINK_SCHED_DEPTH];
+        if ((int32_t)(now_us - e->at_us) < 0)
+            break;
+        if ((int32_t)(e->at_us - host_frame_us) > 0)
+        {
+            memcpy(host_frame, e->frame, FRAME_LEN);
+            memset(host_lo, 0, sizeof(host_lo));
+            host_frame_us = e->at_us;
+            changed = true;
+        }
+        pad_base_head++;
+    }
 
-uint8_t buf[BUF_SIZE] = {0};
-uint8_t buf_len = 0;
+    if (changed)
+        pad_publish(&pad, false);
+}
+#endif
 
-const uint8_t magicByte[] = {0x55, 0xAA};
-const uint8_t endMagicByte[] = {0x0D, 0x0A};
+// lo: low bytes of LX, LY, RX, RY (HOSTLINK_H_FRAME16), NULL for an 8 bit frame
+static void set_frame(uint8_t c, const uint8_t *frame, const uint8_t *lo)
+{
+    static const uint8_t no_lo[4] = {0};
+    if (!lo)
+        lo = no_lo;
 
-void process_data(uint8_t *data, uint8_t len)
+    host_frames++;
+    bool unread = (frame_pending & (1u << c)) != 0;
+#if HARUNA_USB_HOST
+    if (c == USB_PAD_CONTROLLER && pad_pending)
+        unread = false;
+#endif
+    if (unread)
+    {
+        frame_drops++;
+        telemetry_event(HOSTLINK_EV_DROP, c);
+    }
+
+#if HARUNA_USB_HOST
+    if (c == USB_PAD_CONTROLLER)
+    {
+        memcpy(host_frame, frame, FRAME_LEN);
+        memcpy(host_lo, lo, sizeof(host_lo));
+        host_frame_us = time_us_32();
+        pad_publish(&pad_state, true);
+        return;
+    }
+#endif
+
+    // ISR reads toSend, don't let it see a half copied frame
+    uint8_t bit = (uint8_t)(1u << c);
+    uint32_t irq = save_and_disable_interrupts();
+    memcpy(toSend[c], frame, FRAME_LEN);
+    memcpy(axis_lo[c], lo, sizeof(axis_lo[c]));
+    if (lo[0] | lo[1] | lo[2] | lo[3])
+        hires_mask |= bit;
+    else
+        hires_mask &= (uint8_t)~bit;
+    frame_pending |= bit;
+    frame_seq[c]++;
+    restore_interrupts(irq);
+}
+
+static void schedule_frame(const hostlink_frame_at_t *f)
 {
-    if (len != 7)
-        return; // 잘못된 길이 무시
-    // 데이터 복사
-    memcpy(toSend, data, len);
+    uint8_t c = f->controller;
+    if (sched_count(c) >= BOARDLINK_SCHED_DEPTH)
+    {
+        telemetry_event(HOSTLINK_EV_SCHED_DROP, c);
+        return;
+    }
+
+    sched_entry_t *e = &sched[c][sched_tail[c] % BOARDLINK_SCHED_DEPTH];
+    e->at_us = f->at_us;
+    memcpy(e->frame, f->frame, FRAME_LEN);
+    // publish after the entry is complete, the ISR may read it right away
+    __dmb();
+    sched_tail[c]++;
+    host_frames++;
 }
 
-void push_byte(uint8_t b)
+static void queue_path(uint8_t c, const boardlink_path_t *seg)
 {
-    if (buf_len < BUF_SIZE)
+    // CLEAR also drops what the master has not fetched yet
+    if (seg->shape == BOARDLINK_PATH_CLEAR)
+    {
+        uint32_t irq = save_and_disable_interrupts();
+        path_head[c] = path_tail[c];
+        restore_interrupts(irq);
+    }
+    if ((uint8_t)(path_tail[c] - path_head[c]) >= PATH_QUEUE)
     {
-        buf[buf_len++] = b;
+        telemetry_event(HOSTLINK_EV_PATH_DROP, c);
+        return;
     }
+
+    path_queue[c][path_tail[c] % PATH_QUEUE] = *seg;
+    __dmb();
+    path_tail[c]++;
+    host_frames++;
+}
+
+// Config for a HARUNA_LINK_TEST master, picked up at its next window. The
+// bus is shared, so the slave follows the last bus speed set.
+static void configure_link_test(const hostlink_link_test_t *t)
+{
+    test_cfg_t cfg = {t->rate_hz, t->khz, t->len, t->mode};
+    uint32_t irq = save_and_disable_interrupts();
+    test_cfg[t->controller] = cfg;
+    restore_interrupts(irq);
+
+    // slave mode only uses it for the SDA hold / spike filter timing
+    i2c_set_baudrate(I2C_PORT, t->khz ? t->khz * 1000u : I2C_BAUD);
 }
 
-void try_parse_packet()
+static void process_frame(uint8_t type, const uint8_t *data, uint8_t len)
 {
-    // 최소 길이: start(2) + end(2)
-    if (buf_len < 4)
+    switch (type)
+    {
+    case HOSTLINK_H_FRAME:
+    {
+        if (len != FRAME_LEN)
+            break;
+
+        set_frame(0, data, NULL);
         return;
+    }
+    case HOSTLINK_H_FRAME_N:
+    {
+        if (len != 1 + FRAME_LEN || data[0] >= CONTROLLERS)
+            break;
 
-    for (uint8_t i = 0; i <= buf_len - 4; i++)
+        set_frame(data[0], &data[1], NULL);
+        return;
+    }
+    case HOSTLINK_H_FRAME16:
     {
-        // start magic 검사
-        if (buf[i] == magicByte[0] && buf[i + 1] == magicByte[1])
-        {
-            // end magic 찾기
-            for (uint8_t j = i + 2; j <= buf_len - 2; j++)
-            {
-                if (buf[j] == endMagicByte[0] && buf[j + 1] == endMagicByte[1])
-                {
-                    uint8_t data_len = j - (i + 2);
+        if (len != 1 + FRAME_LEN + 4 || data[0] >= CONTROLLERS)
+            break;
 
-                    // data 복사
-                    uint8_t data[BUF_SIZE];
-                    memcpy(data, &buf[i + 2], data_len);
+        set_frame(data[0], &data[1], &data[1 + FRAME_LEN]);
+        return;
+    }
+    case HOSTLINK_H_SYNC:
+    {
+        if (len != 4)
+            break;
 
-                    process_data(data, data_len);
+        hostlink_sync_t sync;
+        sync.rx_us = time_us_32();
+        memcpy(&sync.host_us, data, 4);
+        sync.tx_us = time_us_32();
+        telemetry_relay(HOSTLINK_D_SYNC, &sync, sizeof(sync));
+        return;
+    }
+    case HOSTLINK_H_FRAME_AT:
+    {
+        hostlink_frame_at_t f;
+        if (len != sizeof(f))
+            break;
 
-                    // 🔥 사용한 바이트 제거 (buffer compact)
-                    uint8_t remove_len = (j + 2);
-                    memmove(buf, &buf[remove_len], buf_len - remove_len);
-                    buf_len -= remove_len;
+        memcpy(&f, data, sizeof(f));
+        if (f.controller >= CONTROLLERS)
+            break;
 
-                    return; // 한 패킷 처리 후 종료
-                }
+        schedule_frame(&f);
+        return;
+    }
+    case HOSTLINK_H_PATH:
+    {
+        boardlink_path_t seg;
+        if (len != 1 + sizeof(seg) || data[0] >= CONTROLLERS)
+            break;
+
+        memcpy(&seg, &data[1], sizeof(seg));
+        queue_path(data[0], &seg);
+        return;
+    }
+    case HOSTLINK_H_TELEM_CFG:
+    {
+        if (len != sizeof(hostlink_telem_cfg_t))
+            break;
+
+        hostlink_telem_cfg_t cfg;
+        memcpy(&cfg, data, sizeof(cfg));
+        telemetry_configure(cfg.rate_hz, cfg.event_mask);
+        telemetry_event(HOSTLINK_EV_CFG, cfg.rate_hz);
+        return;
+    }
+    case HOSTLINK_H_TRACE:
+    {
+        if (len != 1)
+            break;
+
+        trace_mask = data[0];
+        return;
+    }
+    case HOSTLINK_H_LINK_TEST:
+    {
+        hostlink_link_test_t t;
+        if (len != sizeof(t))
+            break;
+
+        memcpy(&t, data, sizeof(t));
+        if (t.controller >= CONTROLLERS || t.len > BOARDLINK_TEST_MAX || t.mode > BOARDLINK_TEST_WRITE ||
+            t.khz > 1000)
+            break;
+
+        configure_link_test(&t);
+        return;
+    }
+    case HOSTLINK_H_HOST_STATE:
+    {
+        if (len != 1)
+            break;
+
+        status_led.macro_running = (data[0] & HOSTLINK_HS_MACRO_RUNNING) != 0;
+        return;
+    }
+    default:
+        parse_errors++;
+        telemetry_event(HOSTLINK_EV_PARSE_ERR, HOSTLINK_ERR_TYPE);
+        return;
+    }
+
+    parse_errors++;
+    telemetry_event(HOSTLINK_EV_PARSE_ERR, HOSTLINK_ERR_PAYLOAD);
+}
+
+static void push_byte(uint8_t b)
+{
+    uint8_t err = 0;
+    switch (hostlink_parse_byte(&parser, b, &err))
+    {
+    case HOSTLINK_OK:
+        process_frame(parser.type, parser.payload, parser.len);
+        break;
+    case HOSTLINK_ERROR:
+        parse_errors++;
+        telemetry_event(HOSTLINK_EV_PARSE_ERR, err);
+        break;
+    default:
+        break;
+    }
+}
+
+static void master_watch(uint32_t now_us)
+{
+    for (uint8_t c = 0; c < CONTROLLERS; c++)
+    {
+        uint8_t bit = (uint8_t)(1u << c);
+        uint32_t rdreq = isr_rdreq_n[c];
+        if (rdreq != master_last_rdreq[c])
+        {
+            master_last_rdreq[c] = rdreq;
+            master_last_us[c] = now_us;
+            if (!(master_alive & bit))
+            {
+                master_alive |= bit;
+                telemetry_event(HOSTLINK_EV_MASTER_BACK, c);
             }
         }
+        else if ((master_alive & bit) && now_us - master_last_us[c] > MASTER_TIMEOUT_US)
+        {
+            master_alive &= (uint8_t)~bit;
+            telemetry_event(HOSTLINK_EV_MASTER_LOST, c);
+        }
     }
 }
 
-int main()
+// controller index + block, for every controller flagged in ready. A block
+// stays flagged until the CDC FIFO took it; false once the FIFO is full.
+// in_place: a newer block may overwrite the one being relayed, which then
+// stays flagged for the next pass.
+static bool relay_blocks(uint8_t type, volatile uint8_t *ready, const void *blocks, uint8_t size, bool in_place)
 {
-    board_init();
-    tusb_init();
-
-    // USB 열거 안정화
-    absolute_time_t t0 = get_absolute_time();
-    while (!tud_mounted())
+    for (uint8_t c = 0; c < CONTROLLERS; c++)
     {
-        tud_task();
-        sleep_ms(1);
-        if (absolute_time_diff_us(t0, get_absolute_time()) > 800 * 1000)
-            break;
+        if (!(*ready & (1u << c)))
+            continue;
+
+        const uint8_t *block = (const uint8_t *)blocks + c * size;
+        uint8_t msg[1 + RX_BLOCK_MAX];
+        msg[0] = c;
+        uint32_t irq = save_and_disable_interrupts();
+        memcpy(&msg[1], block, size);
+        restore_interrupts(irq);
+
+        if (!telemetry_relay(type, msg, (uint8_t)(1 + size)))
+            return false;
+
+        irq = save_and_disable_interrupts();
+        if (!in_place || memcmp(&msg[1], block, size) == 0)
+            *ready &= (uint8_t)~(1u << c);
+        restore_interrupts(irq);
     }
+    return true;
+}
+
+// forward master status / profile / trace / link test blocks as soon as they land
+// (trace first, the master holds its next one back until it is out)
+static void master_status_relay(void)
+{
+    if (!relay_blocks(HOSTLINK_D_TRACE, &master_trace_ready, master_trace, sizeof(boardlink_trace_t), false))
+        return;
+    if (!relay_blocks(HOSTLINK_D_MASTER_STATUS, &master_status_ready, master_status, sizeof(boardlink_status_t), true))
+        return;
+    if (!relay_blocks(HOSTLINK_D_MASTER_PROFILE, &master_profile_ready, master_profile, sizeof(boardlink_profile_t), true))
+        return;
+    relay_blocks(HOSTLINK_D_LINK_TEST, &master_test_ready, master_test, sizeof(boardlink_test_report_t), true);
+}
+
+static void telemetry_poll(uint32_t now_us)
+{
+    if (!telemetry_due(now_us))
+        return;
+
+    hostlink_telem_t t;
+    t.t_us = now_us;
+    t.rdreq = isr_rdreq;
+    t.rxfull = isr_rxfull;
+    t.stop = isr_stop;
+    t.host_frames = host_frames;
+    t.parse_err = parse_errors;
+    t.drops = frame_drops;
+    t.queue_depth = pending_count();
+    t.flags = (tud_mounted() ? HOSTLINK_TF_USB_MOUNTED : 0) |
+              (master_alive ? HOSTLINK_TF_MASTER_ALIVE : 0);
+#if HARUNA_USB_HOST
+    if (pad_present)
+        t.flags |= HOSTLINK_TF_USB_PAD;
+#endif
+    t.masters_alive = master_alive;
+    t.isr_max_us = (uint16_t)MIN(isr_max_us, 0xFFFFu);
+    t.loop_max_us = (uint16_t)MIN(loop_max_us, 0xFFFFu);
+    t.boot_link_ms = (uint16_t)MIN(boot_link_us / 1000u, 0xFFFFu);
+    t.boot_usb_ms = (uint16_t)MIN(boot_usb_us / 1000u, 0xFFFFu);
+    isr_max_us = 0;
+    loop_max_us = 0;
+    telemetry_send(&t);
+}
 
+// ---------- MAIN ----------
+int main()
+{
+    board_init();
+#if HARUNA_USB_HOST
+    // changes clk_sys, everything below derives its timing from it
+    usb_pad_init();
+#endif
+    // the board link first: masters get neutral frames while USB enumerates
+    // from the main loop
     i2c_slave_init();
+    tusb_init();
 
     gpio_init(PICO_DEFAULT_LED_PIN);
     gpio_set_dir(PICO_DEFAULT_LED_PIN, GPIO_OUT);
 
+    status_led_init();
+
+    hostlink_parser_reset(&parser);
+    telemetry_init();
+    telemetry_event(HOSTLINK_EV_BOOT, 0);
+
     cdc_write("SLAVE UP\r\n");
 
     while (true)
     {
+        uint32_t loop_start = time_us_32();
         tud_task();
-        cdc_poll_logs();
+
+        uint32_t now_us = time_us_32();
+#if HARUNA_USB_HOST
+        pad_poll(now_us);
+#endif
+        master_watch(now_us);
+        master_status_relay();
+        telemetry_poll(now_us);
+
+        status_led.link_ok = host_frames;
+        status_led.link_err = parse_errors;
+        status_led.link_up = master_alive != 0;
+        status_led.queue_depth = pending_count();
+        status_led.usb_mounted = tud_mounted();
+
+        uint8_t lf = tud_cdc_connected() ? BOARDLINK_LINK_HOST : 0;
+#if HARUNA_USB_HOST
+        if (pad_present)
+            lf |= BOARDLINK_LINK_USB_PAD;
+#endif
+        link_flags = lf;
 
         static uint32_t last = 0;
         uint32_t now = board_millis();
@@ -297,17 +1011,26 @@ int main()
 
         while (tud_cdc_available())
         {
-            uint8_t ch = (uint8_t)tud_cdc_read_char();
-            push_byte(ch);
-            try_parse_packet();
+            uint8_t rx[64];
+            uint32_t n = tud_cdc_read(rx, sizeof(rx));
+            for (uint32_t i = 0; i < n; i++)
+                push_byte(rx[i]);
         }
 
+        uint32_t loop_us = time_us_32() - loop_start;
+        if (loop_us > loop_max_us)
+            loop_max_us = loop_us;
+
         sleep_ms(1);
     }
 }
 
 // TinyUSB callbacks (필수는 아님)
-void tud_mount_cb(void) {}
+void tud_mount_cb(void)
+{
+    if (!boot_usb_us)
+        boot_usb_us = time_us_32() | 1u;
+}
 void tud_umount_cb(void) {}
 void tud_suspend_cb(bool remote_wakeup_en) { (void)remote_wakeup_en; }
 void tud_resume_cb(void) {}
@@ -0,0 +1,15 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include "pico/platform.h"
+
+// HARUNA_HOT(name) marks a function that runs on every I2C transaction or
+// USB poll. In the lean profile (cmake -DHARUNA_PERF_BUILD=ON) it is copied
+// to SRAM so XIP cache misses do not add jitter; see perf_build.cmake.
+#if defined(HARUNA_PERF_BUILD) && HARUNA_PERF_BUILD
+#define HARUNA_HOT(name) __not_in_flash_func(name)
+#else
+#define HARUNA_HOT(name) name
+#endif
+
+#endif // PERF_H
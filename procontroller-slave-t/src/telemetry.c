@@ -0,0 +1,102 @@
+#include "telemetry.h"
+#include "pico/time.h"
+#include "tusb.h"
+
+static uint32_t period_us = 1000000 / TELEMETRY_DEFAULT_HZ;
+static uint32_t last_us = 0;
+static uint8_t ev_mask = 0xFF;
+
+static hostlink_event_t ev_ring[TELEMETRY_EVENT_RING];
+static uint8_t ev_head = 0;
+static uint8_t ev_count = 0;
+
+void telemetry_init(void)
+{
+    last_us = time_us_32();
+    ev_head = 0;
+    ev_count = 0;
+}
+
+void telemetry_configure(uint8_t rate_hz, uint8_t event_mask)
+{
+    if (rate_hz > HOSTLINK_TELEM_MAX_HZ)
+        rate_hz = HOSTLINK_TELEM_MAX_HZ;
+
+    period_us = rate_hz ? 1000000u / rate_hz : 0;
+    ev_mask = event_mask;
+}
+
+void telemetry_event(uint8_t code, uint8_t arg)
+{
+    // codes start at 1, bit 0 is code 1
+    if (code >= 1 && code <= 8 && !(ev_mask & (1u << (code - 1))))
+        return;
+
+    // oldest record is overwritten when the ring is full
+    uint8_t slot = (uint8_t)((ev_head + ev_count) % TELEMETRY_EVENT_RING);
+    if (ev_count < TELEMETRY_EVENT_RING)
+        ev_count++;
+    else
+        ev_head = (uint8_t)((ev_head + 1) % TELEMETRY_EVENT_RING);
+
+    ev_ring[slot].t_us = time_us_32();
+    ev_ring[slot].code = code;
+    ev_ring[slot].arg = arg;
+}
+
+bool telemetry_due(uint32_t now_us)
+{
+    if (period_us == 0)
+        return false;
+    if (now_us - last_us < period_us)
+        return false;
+    last_us = now_us;
+    return true;
+}
+
+static bool write_frame(uint8_t type, const void *payload, uint8_t len)
+{
+    uint8_t frame[HOSTLINK_MAX_FRAME];
+    uint32_t n = hostlink_encode(frame, type, payload, len);
+
+    // never block the main loop: drop the frame if the TX fifo is full
+    if (n == 0 || tud_cdc_write_available() < n)
+        return false;
+    tud_cdc_write(frame, n);
+    return true;
+}
+
+bool telemetry_relay(uint8_t type, const void *payload, uint8_t len)
+{
+    if (!tud_cdc_connected())
+        return false;
+    if (!write_frame(type, payload, len))
+        return false;
+    tud_cdc_write_flush();
+    return true;
+}
+
+void telemetry_send(const hostlink_telem_t *t)
+{
+    if (!tud_cdc_connected())
+        return;
+
+    write_frame(HOSTLINK_D_TELEM, t, sizeof(*t));
+
+    const uint8_t per_frame = HOSTLINK_MAX_PAYLOAD / sizeof(hostlink_event_t);
+    while (ev_count)
+    {
+        hostlink_event_t chunk[HOSTLINK_MAX_PAYLOAD / sizeof(hostlink_event_t)];
+        uint8_t n = ev_count < per_frame ? ev_count : per_frame;
+        for (uint8_t i = 0; i < n; i++)
+            chunk[i] = ev_ring[(ev_head + i) % TELEMETRY_EVENT_RING];
+
+        if (!write_frame(HOSTLINK_D_EVENTS, chunk, (uint8_t)(n * sizeof(hostlink_event_t))))
+            break; // keep the rest for the next tick
+
+        ev_head = (uint8_t)((ev_head + n) % TELEMETRY_EVENT_RING);
+        ev_count -= n;
+    }
+
+    tud_cdc_write_flush();
+}
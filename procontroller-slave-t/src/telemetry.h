@@ -0,0 +1,31 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "hostlink.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TELEMETRY_DEFAULT_HZ 1
+#define TELEMETRY_EVENT_RING 32
+
+    void telemetry_init(void);
+    void telemetry_configure(uint8_t rate_hz, uint8_t event_mask);
+
+    // Queue an event record, sent with the next telemetry tick (main loop only).
+    void telemetry_event(uint8_t code, uint8_t arg);
+
+    // True once per configured period; caller then fills a snapshot and calls telemetry_send().
+    bool telemetry_due(uint32_t now_us);
+    void telemetry_send(const hostlink_telem_t *t);
+
+    // Send a single frame right away (not rate limited), e.g. relayed master status.
+    bool telemetry_relay(uint8_t type, const void *payload, uint8_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_H
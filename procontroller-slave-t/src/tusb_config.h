@@ -73,9 +73,6 @@ extern "C"
 #define CFG_TUD_ENDPOINT0_SIZE 64
 #endif
 
-#define CFG_TUD_CDC_RX_BUFSIZE 64
-#define CFG_TUD_CDC_TX_BUFSIZE 64
-
 //------------- CLASS -------------//
 #define CFG_TUD_HID 0
 #define CFG_TUD_CDC 1
@@ -85,9 +82,30 @@ extern "C"
 
 #define CFG_TUD_HID_EP_BUFSIZE 16
 
-// CDC FIFO size of TX and RX
+// CDC FIFO size of TX and RX. TX holds a few relayed master blocks (up to
+// 54 bytes each) next to the telemetry frame of the same pass.
 #define CFG_TUD_CDC_RX_BUFSIZE 64
-#define CFG_TUD_CDC_TX_BUFSIZE 64
+#define CFG_TUD_CDC_TX_BUFSIZE 256
+
+//--------------------------------------------------------------------
+// HOST CONFIGURATION (-DHARUNA_USB_HOST=ON, see usb_pad.h)
+//--------------------------------------------------------------------
+
+#if HARUNA_USB_HOST
+// Host on the PIO USB port (rhport 1), the native controller stays a device.
+// tuh_init() is called from core 1, tusb_init() only brings up the device.
+#define CFG_TUH_ENABLED 1
+#define CFG_TUH_RPI_PIO_USB 1
+#define BOARD_TUH_RHPORT 1
+#define CFG_TUH_MAX_SPEED OPT_MODE_FULL_SPEED
+
+#define CFG_TUH_ENUMERATION_BUFSIZE 256
+#define CFG_TUH_HUB 1
+#define CFG_TUH_DEVICE_MAX 4
+#define CFG_TUH_HID 4 // pads often have a second interface (audio / touchpad)
+#define CFG_TUH_HID_EPIN_BUFSIZE 64
+#define CFG_TUH_HID_EPOUT_BUFSIZE 64
+#endif
 
 #ifdef __cplusplus
 }
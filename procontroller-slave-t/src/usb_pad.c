@@ -0,0 +1,372 @@
+#include "usb_pad.h"
+
+#include <string.h>
+
+#include "pico/multicore.h"
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+#include "pio_usb.h"
+#include "tusb.h"
+
+#define MAX_BUTTONS 16
+#define AXES 4
+#define USAGE_PAGE_DESKTOP 0x01
+#define USAGE_PAGE_BUTTON 0x09
+#define USAGE_JOYSTICK 0x04
+#define USAGE_GAMEPAD 0x05
+#define USAGE_HAT 0x39
+
+static const int8_t button_map[MAX_BUTTONS] = USB_PAD_BUTTON_MAP;
+static const uint8_t axis_usages[AXES] = USB_PAD_AXIS_USAGES;
+
+// ---------- Report layout (core 1) ----------
+// Where the pad's fields sit in its input report, taken from the report
+// descriptor at mount so any HID pad works without a per-model table.
+typedef struct
+{
+    uint16_t bit; // offset behind the report id
+    uint8_t size; // 0 = not in the report
+    int32_t min;
+    int32_t max;
+} field_t;
+
+typedef struct
+{
+    uint8_t dev_addr; // 0 = no pad
+    uint8_t instance;
+    uint8_t report_id; // 0 = the pad does not number its reports
+    field_t buttons[MAX_BUTTONS];
+    field_t axis[AXES];
+    field_t hat;
+} layout_t;
+
+static layout_t pad;
+
+static int32_t item_value(const uint8_t *d, uint8_t size, bool sign)
+{
+    uint32_t v = 0;
+    for (uint8_t i = 0; i < size; i++)
+        v |= (uint32_t)d[i] << (8 * i);
+    if (sign && size && size < 4 && (v & (1u << (8 * size - 1))))
+        v |= ~0u << (8 * size);
+    return (int32_t)v;
+}
+
+static void take_field(layout_t *out, uint32_t usage, uint16_t bit, uint8_t size, int32_t min, int32_t max)
+{
+    field_t f = {bit, size, min, max};
+    uint16_t page = (uint16_t)(usage >> 16);
+    uint16_t id = (uint16_t)usage;
+
+    if (page == USAGE_PAGE_BUTTON && id >= 1 && id <= MAX_BUTTONS)
+    {
+        out->buttons[id - 1] = f;
+        return;
+    }
+    if (page != USAGE_PAGE_DESKTOP)
+        return;
+    if (id == USAGE_HAT)
+    {
+        out->hat = f;
+        return;
+    }
+    for (int i = 0; i < AXES; i++)
+    {
+        if (id == axis_usages[i])
+            out->axis[i] = f;
+    }
+}
+
+// Walks the short items of a report descriptor (HID 1.11, 6.2.2) and keeps
+// the input fields of the first Joystick / Gamepad application collection.
+static bool parse_layout(const uint8_t *desc, uint16_t len, layout_t *out)
+{
+    static uint16_t offset[256]; // input bits so far, per report id
+    memset(offset, 0, sizeof(offset));
+    memset(out, 0, sizeof(*out));
+
+    uint16_t usage_page = 0;
+    int32_t logical_min = 0;
+    int32_t logical_max = 0;
+    uint32_t report_size = 0;
+    uint32_t report_count = 0;
+    uint8_t report_id = 0;
+
+    uint32_t usages[MAX_BUTTONS];
+    uint8_t usage_count = 0;
+    uint32_t usage_min = 0;
+    uint32_t usage_max = 0;
+    bool usage_range = false;
+
+    uint8_t depth = 0;
+    uint8_t pad_depth = 0; // depth of the gamepad collection, 0 = outside
+    bool found = false;
+    bool id_known = false;
+
+    uint16_t i = 0;
+    while (i < len)
+    {
+        uint8_t prefix = desc[i];
+        if (prefix == 0xFE)
+        {
+            // long item, never used for input fields
+            if (i + 1 >= len)
+                break;
+            i = (uint16_t)(i + 3 + desc[i + 1]);
+            continue;
+        }
+        uint8_t size = prefix & 0x03;
+        if (size == 3)
+            size = 4;
+        if (i + 1 + size > len)
+            break;
+        const uint8_t *data = &desc[i + 1];
+        uint32_t u = (uint32_t)item_value(data, size, false);
+        i = (uint16_t)(i + 1 + size);
+
+        // 4 byte usages carry their own page
+        uint32_t usage = size == 4 ? u : ((uint32_t)usage_page << 16) | u;
+
+        switch (prefix & 0xFC)
+        {
+        case 0x04: // usage page
+            usage_page = (uint16_t)u;
+            break;
+        case 0x14: // logical minimum
+            logical_min = item_value(data, size, true);
+            break;
+        case 0x24: // logical maximum, signed only if the minimum is
+            logical_max = item_value(data, size, logical_min < 0);
+            break;
+        case 0x74: // report size
+            report_size = u;
+            break;
+        case 0x84: // report id
+            report_id = (uint8_t)u;
+            break;
+        case 0x94: // report count
+            report_count = u;
+            break;
+        case 0x08: // usage
+            if (usage_count < MAX_BUTTONS)
+                usages[usage_count++] = usage;
+            break;
+        case 0x18: // usage minimum
+            usage_min = usage;
+            usage_range = true;
+            break;
+        case 0x28: // usage maximum
+            usage_max = usage;
+            break;
+        case 0xA0: // collection
+            depth++;
+            if (!found && !pad_depth && u == 0x01 && usage_count &&
+                (usages[0] == ((USAGE_PAGE_DESKTOP << 16) | USAGE_JOYSTICK) ||
+                 usages[0] == ((USAGE_PAGE_DESKTOP << 16) | USAGE_GAMEPAD)))
+                pad_depth = depth;
+            usage_count = 0;
+            usage_range = false;
+            break;
+        case 0xC0: // end collection
+            if (depth == pad_depth)
+            {
+                pad_depth = 0;
+                found = id_known;
+            }
+            if (depth)
+                depth--;
+            break;
+        case 0x80: // input
+        {
+            bool constant = (u & 0x01) != 0;
+            bool variable = (u & 0x02) != 0;
+            bool take = pad_depth && !found && !constant && variable &&
+                        report_size && report_size <= 32;
+            if (take && !id_known)
+            {
+                out->report_id = report_id;
+                id_known = true;
+            }
+            take = take && report_id == out->report_id;
+
+            for (uint32_t n = 0; take && n < report_count; n++)
+            {
+                uint32_t field_usage;
+                if (usage_range)
+                    field_usage = usage_min + n <= usage_max ? usage_min + n : 0;
+                else
+                    field_usage = usage_count ? usages[n < usage_count ? n : usage_count - 1u] : 0;
+                if (field_usage)
+                    take_field(out, field_usage, (uint16_t)(offset[report_id] + n * report_size),
+                               (uint8_t)report_size, logical_min, logical_max);
+            }
+            offset[report_id] = (uint16_t)(offset[report_id] + report_size * report_count);
+            usage_count = 0;
+            usage_range = false;
+            break;
+        }
+        case 0x90: // output
+        case 0xB0: // feature
+            usage_count = 0;
+            usage_range = false;
+            break;
+        default:
+            break;
+        }
+    }
+    return id_known;
+}
+
+// ---------- Decoding ----------
+static int32_t field_read(const field_t *f, const uint8_t *report, uint16_t len)
+{
+    uint32_t v = 0;
+    for (uint8_t i = 0; i < f->size; i++)
+    {
+        uint32_t bit = (uint32_t)f->bit + i;
+        if ((bit >> 3) >= len)
+            break;
+        if (report[bit >> 3] & (1u << (bit & 7)))
+            v |= 1u << i;
+    }
+    if (f->min < 0 && f->size < 32 && (v & (1u << (f->size - 1))))
+        v |= ~0u << f->size;
+    return (int32_t)v;
+}
+
+// Logical range -> 0 .. 0xFF00 with the middle on 32768, like an 8 bit value
+// shifted up; pads with more than 8 bits keep them.
+static uint16_t axis_value(const field_t *f, const uint8_t *report, uint16_t len)
+{
+    if (!f->size || f->max <= f->min)
+        return 32768;
+
+    int32_t v = field_read(f, report, len);
+    if (v < f->min)
+        v = f->min;
+    if (v > f->max)
+        v = f->max;
+    int32_t out = (int32_t)(((int64_t)(v - f->min) * 0xFF00) / ((int64_t)f->max - f->min));
+    if (out > 32768 - USB_PAD_DEADZONE * 256 && out < 32768 + USB_PAD_DEADZONE * 256)
+        return 32768;
+    return (uint16_t)out;
+}
+
+static void decode(const uint8_t *report, uint16_t len, usb_pad_t *out)
+{
+    out->buttons = 0;
+    for (int i = 0; i < MAX_BUTTONS; i++)
+    {
+        if (button_map[i] >= 0 && pad.buttons[i].size && field_read(&pad.buttons[i], report, len))
+            out->buttons |= (uint16_t)(1u << button_map[i]);
+    }
+
+    // 8 way hat, anything outside the 8 directions is the null state
+    out->hat = 0x0F;
+    if (pad.hat.size)
+    {
+        int32_t h = field_read(&pad.hat, report, len) - pad.hat.min;
+        if (h >= 0 && h < 8)
+            out->hat = (uint8_t)h;
+    }
+
+    for (int i = 0; i < AXES; i++)
+        out->axis[i] = axis_value(&pad.axis[i], report, len);
+}
+
+// ---------- Shared with core 0 ----------
+static critical_section_t state_lock;
+static usb_pad_t state;
+static bool state_valid = false;
+static uint32_t state_seq = 0;
+
+static const usb_pad_t neutral = {0, 0x0F, {32768, 32768, 32768, 32768}};
+
+static void publish(const usb_pad_t *p, bool valid)
+{
+    critical_section_enter_blocking(&state_lock);
+    state = *p;
+    state_valid = valid;
+    state_seq++;
+    critical_section_exit(&state_lock);
+}
+
+bool usb_pad_read(usb_pad_t *out, uint32_t *seq)
+{
+    critical_section_enter_blocking(&state_lock);
+    bool valid = state_valid;
+    *out = valid ? state : neutral;
+    *seq = state_seq;
+    critical_section_exit(&state_lock);
+    return valid;
+}
+
+// ---------- TinyUSB host callbacks (core 1) ----------
+void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *desc_report, uint16_t desc_len)
+{
+    // first pad wins, keyboards / mice / a second pad are left alone
+    if (pad.dev_addr)
+        return;
+
+    layout_t layout;
+    if (!parse_layout(desc_report, desc_len, &layout))
+        return;
+
+    pad = layout;
+    pad.dev_addr = dev_addr;
+    pad.instance = instance;
+    publish(&neutral, true);
+    tuh_hid_receive_report(dev_addr, instance);
+}
+
+void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t instance)
+{
+    if (dev_addr != pad.dev_addr || instance != pad.instance)
+        return;
+
+    pad.dev_addr = 0;
+    publish(&neutral, false);
+}
+
+void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *report, uint16_t len)
+{
+    if (dev_addr != pad.dev_addr || instance != pad.instance)
+        return;
+
+    if (!pad.report_id || (len && report[0] == pad.report_id))
+    {
+        if (pad.report_id)
+        {
+            report++;
+            len--;
+        }
+        usb_pad_t p;
+        decode(report, len, &p);
+        publish(&p, true);
+    }
+    tuh_hid_receive_report(dev_addr, instance);
+}
+
+// ---------- Core 1 ----------
+// PIO USB bit-bangs full speed from its own SOF timer and IRQs, which would
+// stretch the I2C slave ISR on core 0. Core 1 does nothing else.
+static void core1_main(void)
+{
+    pio_usb_configuration_t cfg = PIO_USB_DEFAULT_CONFIG;
+    cfg.pin_dp = USB_PAD_DP_PIN;
+    cfg.sm_tx = USB_PAD_PIO_TX_SM;
+    cfg.tx_ch = USB_PAD_DMA_CH;
+    tuh_configure(BOARD_TUH_RHPORT, TUH_CFGID_RPI_PIO_USB_CONFIGURATION, &cfg);
+    tuh_init(BOARD_TUH_RHPORT);
+
+    while (true)
+        tuh_task();
+}
+
+void usb_pad_init(void)
+{
+    set_sys_clock_khz(120000, true);
+    critical_section_init(&state_lock);
+    multicore_reset_core1();
+    multicore_launch_core1(core1_main);
+}
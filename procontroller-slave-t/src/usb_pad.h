@@ -0,0 +1,60 @@
+#ifndef USB_PAD_H
+#define USB_PAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// ---------- Gamepad on the slave's PIO USB host port ----------
+// Built with -DHARUNA_USB_HOST=ON. A HID gamepad plugged into a PIO USB port
+// is run by TinyUSB's host stack on core 1 and its reports are decoded in
+// firmware, so live play goes straight to the board link instead of through
+// the browser's Gamepad API and the host's serial tick.
+//
+// Only HID class pads (DirectInput style: DualShock 4, DualSense, most
+// "D" mode pads) are understood; XInput pads are vendor class and ignored.
+
+#define USB_PAD_DP_PIN 0     // D+, D- is the next pin (PIO USB needs them adjacent)
+#define USB_PAD_CONTROLLER 0 // frame index the pad drives
+#define USB_PAD_DEADZONE 8   // around 128 (8 bit steps), reported as exactly centered
+
+// The PIO USB TX state machine shares pio0 with the status LED (sm 0), RX
+// takes two state machines on pio1. The DMA channel is the last one so it
+// never collides with channels claimed later.
+#define USB_PAD_PIO_TX_SM 1
+#define USB_PAD_DMA_CH 11
+
+// HID button n (1 based) -> bit of the frame's button field, -1 = unused.
+// Frame bits are NSButtons order: Y B A X L R ZL ZR - + LS RS HOME CAPTURE.
+// The default is the usual DirectInput order (square cross circle triangle
+// L1 R1 L2 R2 share options L3 R3 PS touchpad), i.e. by position.
+#define USB_PAD_BUTTON_MAP {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, -1, -1}
+
+// Generic desktop usages read as LX, LY, RX, RY (X, Y, Z, Rz)
+#define USB_PAD_AXIS_USAGES {0x30, 0x31, 0x32, 0x35}
+
+    typedef struct
+    {
+        uint16_t buttons; // frame bit layout
+        uint8_t hat;      // frame dpad value, 0x0F = released
+        uint16_t axis[4]; // LX, LY, RX, RY, boardlink_axis16 scale (32768 = center)
+    } usb_pad_t;
+
+    // Raises clk_sys to 120 MHz (PIO USB needs a multiple of 12 MHz), so
+    // call it right after board_init(), before the I2C / LED setup derive
+    // their timing from it. Starts the host stack on core 1.
+    void usb_pad_init(void);
+
+    // Latest pad state. Returns false (and a neutral pad) while none is
+    // mounted. *seq changes with every decoded report.
+    bool usb_pad_read(usb_pad_t *out, uint32_t *seq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // USB_PAD_H
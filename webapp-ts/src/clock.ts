@@ -0,0 +1,65 @@
+// Host <-> slave clock sync (NTP style, see D_SYNC in protocol.ts).
+// Host time is microseconds since the epoch from the high resolution clock,
+// the same in every window and worker. The slave clock is a wrapping u32
+// microsecond timer; the offset between the two is tracked modulo 2^32.
+import type { SyncReply } from "./protocol";
+
+const U32 = 2 ** 32;
+// samples kept for the estimate; the slave crystal drifts a few us per
+// second, so older ones are dropped
+const WINDOW = 8;
+
+export function hostMicros() {
+  return (performance.timeOrigin + performance.now()) * 1000;
+}
+
+type Sample = { offsetUs: number; rttUs: number };
+
+export class ClockSync {
+  private samples: Sample[] = [];
+  // slave time - host time (mod 2^32) of the sample with the smallest RTT
+  offsetUs = 0;
+  rttUs = Infinity;
+
+  get synced() {
+    return this.samples.length > 0;
+  }
+
+  reset() {
+    this.samples = [];
+    this.offsetUs = 0;
+    this.rttUs = Infinity;
+  }
+
+  // reply: the slave's answer, receivedUs: host time the reply arrived
+  addSample(reply: SyncReply, receivedUs: number) {
+    const t1 = reply.hostUs;
+    const t4 = Math.floor(receivedUs) % U32;
+    const rttUs = ((t4 - t1) >>> 0) - ((reply.txUs - reply.rxUs) >>> 0);
+    if (rttUs < 0) return;
+    // both legs are offset + delay, take their midpoint without wrapping
+    const out = (reply.rxUs - t1) >>> 0;
+    const back = (reply.txUs - t4) >>> 0;
+    const offsetUs = (out + ((back - out) | 0) / 2 + U32) % U32;
+
+    this.samples.push({ offsetUs, rttUs });
+    if (this.samples.length > WINDOW) this.samples.shift();
+    let best = this.samples[0];
+    for (const s of this.samples) if (s.rttUs < best.rttUs) best = s;
+    this.offsetUs = best.offsetUs;
+    this.rttUs = best.rttUs;
+  }
+
+  // host time (us) -> slave time (us, u32)
+  toDevice(hostUs: number) {
+    return Math.floor(hostUs + this.offsetUs) % U32;
+  }
+
+  // slave time (us, u32) -> host time (us), the one closest to nearHostUs
+  toHost(deviceUs: number, nearHostUs = hostMicros()) {
+    const diff = (deviceUs - this.toDevice(nearHostUs)) | 0;
+    return nearHostUs + diff;
+  }
+}
+
+export const deviceClock = new ClockSync();
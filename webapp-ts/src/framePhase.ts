@@ -0,0 +1,162 @@
+// Game frame boundaries from the camera feed, for the script timeline
+// (ns.gameFrame in scheduler.ts):
+//
+//   const phase = new FramePhase(vision, { x: 928, y: 508, w: 64, h: 64 },
+//     (grid) => ns.gameFrame.set(grid));
+//   ns.frame({ b: { A: true } });
+//   await ns.gameFrame.wait(1); // the game has sampled A once
+//   ns.frame({ b: { A: false } });
+//
+// The capture cadence (the display refresh, a capture card runs locked to
+// it) comes from the video frame timestamps. A game frame is the smallest
+// common spacing between content changes of the region, in whole capture
+// frames, and the phase is the circular mean of the change times on that
+// grid. Pick a region that animates every game frame; static stretches
+// only cost samples.
+//
+// Frame timestamps are put on the host clock with the smallest arrival
+// delay seen, so the camera's own latency is not part of it: measure it
+// once and pass it as latencyMs.
+import type { GameFrameGrid } from "./scheduler";
+import type { Rgb, Vision } from "./vision";
+
+export type FramePhaseOptions = {
+  // summed mean RGB change of the region that counts as new content
+  threshold?: number;
+  // camera + capture latency, boundaries are moved back by it
+  latencyMs?: number;
+};
+
+type Region = { x: number; y: number; w: number; h: number };
+
+// capture intervals / arrival offsets kept for the cadence
+const CAPTURE_WINDOW = 64;
+// content changes kept for the phase, old ones drop out as the game drifts
+const CHANGE_WINDOW = 32;
+const LOCK_CHANGES = 8;
+// resultant length of the change phases needed to trust the grid
+const LOCK_CONFIDENCE = 0.8;
+
+let nextId = 1;
+
+function median(values: number[]) {
+  const sorted = [...values].sort((a, b) => a - b);
+  return sorted[sorted.length >> 1];
+}
+
+function pushWindow(values: number[], value: number, size: number) {
+  values.push(value);
+  if (values.length > size) values.shift();
+}
+
+export class FramePhase {
+  // latest lock, null while not locked
+  grid: GameFrameGrid | null = null;
+  // 0..1, how well the recent changes agree on the phase
+  confidence = 0;
+  captureMs = 0;
+
+  private vision: Vision;
+  private onGrid: (grid: GameFrameGrid | null) => void;
+  private id = `framePhase:${nextId++}`;
+  private threshold: number;
+  private latencyMs: number;
+  private prev: Rgb | null = null;
+  private prevTimestamp = NaN;
+  private intervals: number[] = [];
+  private offsets: number[] = [];
+  private changes: number[] = [];
+  private off: () => void;
+
+  constructor(
+    vision: Vision,
+    region: Region,
+    onGrid: (grid: GameFrameGrid | null) => void,
+    opts: FramePhaseOptions = {},
+  ) {
+    this.vision = vision;
+    this.onGrid = onGrid;
+    this.threshold = opts.threshold ?? 3;
+    this.latencyMs = opts.latencyMs ?? 0;
+    vision.probe(this.id, { kind: "region", ...region });
+    this.off = vision.onFrame(() => this.update());
+  }
+
+  stop() {
+    this.off();
+    this.vision.remove(this.id);
+    this.setGrid(null);
+  }
+
+  private setGrid(grid: GameFrameGrid | null) {
+    if (!grid && !this.grid) return;
+    this.grid = grid;
+    this.onGrid(grid);
+  }
+
+  private update() {
+    const p = this.vision.get(this.id);
+    if (!p || p.timestamp === this.prevTimestamp) return;
+    const prev = this.prev;
+    if (prev && p.timestamp > this.prevTimestamp) {
+      pushWindow(
+        this.intervals,
+        p.timestamp - this.prevTimestamp,
+        CAPTURE_WINDOW,
+      );
+    }
+    pushWindow(this.offsets, p.receivedMs - p.timestamp, CAPTURE_WINDOW);
+    this.prev = p;
+    this.prevTimestamp = p.timestamp;
+
+    if (!prev) return;
+    const change =
+      Math.abs(p.r - prev.r) + Math.abs(p.g - prev.g) + Math.abs(p.b - prev.b);
+    if (change <= this.threshold) return;
+    pushWindow(this.changes, p.timestamp, CHANGE_WINDOW);
+    this.estimate();
+  }
+
+  private estimate() {
+    const changes = this.changes;
+    if (changes.length < LOCK_CHANGES || this.intervals.length < 8) return;
+
+    // median, then the mean of the intervals near it (dropped frames and
+    // late deliveries left out)
+    const mid = median(this.intervals);
+    const near = this.intervals.filter((v) => Math.abs(v - mid) < mid / 4);
+    this.captureMs = near.reduce((a, b) => a + b, 0) / near.length;
+
+    // smallest common spacing: lower quartile of the change intervals
+    const steps: number[] = [];
+    for (let i = 1; i < changes.length; i++) {
+      const step = Math.round((changes[i] - changes[i - 1]) / this.captureMs);
+      if (step >= 1) steps.push(step);
+    }
+    if (!steps.length) return;
+    steps.sort((a, b) => a - b);
+    const periodMs = steps[steps.length >> 2] * this.captureMs;
+
+    // relative to the newest change, absolute times would lose precision
+    const base = changes[changes.length - 1];
+    let sx = 0;
+    let sy = 0;
+    for (const t of changes) {
+      const angle = (2 * Math.PI * (t - base)) / periodMs;
+      sx += Math.cos(angle);
+      sy += Math.sin(angle);
+    }
+    this.confidence = Math.hypot(sx, sy) / changes.length;
+    if (this.confidence < LOCK_CONFIDENCE) {
+      this.setGrid(null);
+      return;
+    }
+
+    const phaseMs = (Math.atan2(sy, sx) / (2 * Math.PI)) * periodMs;
+    const offsetMs = Math.min(...this.offsets);
+    this.setGrid({
+      periodMs,
+      boundaryMs: base + phaseMs + offsetMs - this.latencyMs,
+    });
+  }
+}
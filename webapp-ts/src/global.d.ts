@@ -1,9 +1,24 @@
-import type { StateInstance } from "./state";
+import type {
+  LinkTestConfig,
+  LinkTestReport,
+  MasterProfile,
+  MasterStatus,
+} from "./protocol";
+import type { ReplayReport } from "./replayBench";
+import type { GameFrameGrid } from "./scheduler";
+import type { FrameFields, StateInstance } from "./state";
+import type { PathOptions, Point, Stick } from "./stickPath";
 
 export type NS = {
+  // controller this namespace drives (0 with a single master board)
+  index: number;
+  // same script, driving another controller (own state instance)
+  controller: (index: number) => NS;
   replay: {
     play: (name: string) => Promise<void>;
     stop: () => void;
+    // plays name and compares it with the reports the console fetched
+    benchmark: (name: string) => Promise<ReplayReport>;
   };
   gamepad: {
     setButton: (buttons: number) => void;
@@ -32,6 +47,77 @@ export type NS = {
     info: (msg: string) => void;
     error: (msg: string) => void;
   };
+  master: {
+    // latest status block relayed from this controller's master board
+    status: () => MasterStatus | null;
+    // console poll / report queueing profile of the last second
+    profile: () => MasterProfile | null;
+    // board link test config for a HARUNA_LINK_TEST master, false when not
+    // connected; reports arrive once a second
+    linkTest: (cfg?: LinkTestConfig) => boolean;
+    linkTestReport: () => LinkTestReport | null;
+    // called for every status block, returns an unsubscribe function
+    onStatus: (listener: (status: MasterStatus) => void) => () => void;
+  };
+  // host clock (epoch ms, sub-ms resolution) kept in sync with the slave
+  clock: {
+    now: () => number;
+    synced: () => boolean;
+    // round trip of the best sync sample
+    rttUs: () => number;
+  };
+  // Raw 7 byte frame applied by the master at clock time atMs (within one
+  // USB frame). Up to 16 pending per controller, queue them in time order.
+  // False while the clock is not synced.
+  scheduleFrame: (atMs: number, frame: ArrayLike<number>) => boolean;
+  // Script timeline shared by every script (scheduler.ts), in clock ms.
+  // time() is the due time of the running tick, so at(time() + ms) chains
+  // without drift. Tasks due together run in one go and their changes go
+  // out in the same frame; at() resolves with atMs after fn ran.
+  time: () => number;
+  at: (atMs: number, fn?: () => void) => Promise<number>;
+  // n console polls (the master's measured interval) after time()
+  waitFrames: (n: number) => Promise<number>;
+  // several fields as one change, never split across frames
+  frame: (fields: FrameFields) => void;
+  // Game frame boundaries, fed by a FramePhase (framePhase.ts) on the
+  // script's camera; shared by every script.
+  gameFrame: {
+    set: (grid: GameFrameGrid | null) => void;
+    get: () => GameFrameGrid | null;
+    // resolves leadMs (default: one console poll + link) before the n-th
+    // boundary after time(), n 60 Hz frames while nothing is locked
+    wait: (n?: number, leadMs?: number) => Promise<number>;
+  };
+  // Stick motion the master interpolates for every USB report (stickPath.ts).
+  // Segments of a stick run back to back, up to 16 waiting on the slave.
+  // False when not connected, or for opts.atMs while the clock is not synced.
+  path: {
+    line: (
+      stick: Stick,
+      from: Point,
+      to: Point,
+      durationMs: number,
+      opts?: PathOptions,
+    ) => boolean;
+    arc: (
+      stick: Stick,
+      center: Point,
+      radius: number | Point,
+      fromTurns: number,
+      sweepTurns: number,
+      durationMs: number,
+      opts?: PathOptions,
+    ) => boolean;
+    circle: (
+      stick: Stick,
+      radius: number,
+      turnsPerSec: number,
+      durationMs: number,
+      opts?: PathOptions,
+    ) => boolean;
+    clear: () => boolean;
+  };
 
   b: (name: string, pressed: boolean) => void;
   d: (up: boolean, down: boolean, left: boolean, right: boolean) => void;
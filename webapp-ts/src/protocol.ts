@@ -0,0 +1,529 @@
+// Host <-> slave CDC framing. Mirrors procontroller-slave-t/src/hostlink.h
+// SYNC0 SYNC1 TYPE LEN PAYLOAD[LEN] CRC8(TYPE..PAYLOAD)
+
+export const H2D_SYNC = [0x55, 0xaa] as const;
+export const D2H_SYNC = [0xaa, 0x55] as const;
+export const MAX_PAYLOAD = 56;
+
+// Host -> slave
+export const H_FRAME = 0x01;
+export const H_TELEM_CFG = 0x02;
+export const H_HOST_STATE = 0x03;
+export const H_FRAME_N = 0x04;
+export const H_SYNC = 0x05;
+export const H_FRAME_AT = 0x06;
+export const H_TRACE = 0x07;
+export const H_PATH = 0x08;
+export const H_LINK_TEST = 0x09;
+export const H_FRAME16 = 0x0a;
+
+// Masters sharing the slave's I2C bus, one per console. H_FRAME drives
+// controller 0, H_FRAME_N carries the index in front of the frame.
+export const MAX_CONTROLLERS = 4;
+
+// H_FRAME payload: Buttons0, Buttons1, DPAD, LX, LY, RX, RY
+export const FRAME_LEN = 7;
+// Frame plus the low bytes of LX, LY, RX, RY (16 bit sticks, H_FRAME16).
+// Controller state is kept in this form, zero low bytes = plain 8 bit frame.
+export const FRAME16_LEN = FRAME_LEN + 4;
+export const NEUTRAL_FRAME = [
+  0, 0, 0x0f, 128, 128, 128, 128, 0, 0, 0, 0,
+] as const;
+
+// H_HOST_STATE flags
+export const HS_MACRO_RUNNING = 1 << 0;
+
+// Slave -> host
+export const D_TELEM = 0x81;
+export const D_EVENTS = 0x82;
+export const D_MASTER_STATUS = 0x83;
+export const D_SYNC = 0x84;
+export const D_MASTER_PROFILE = 0x85;
+export const D_TRACE = 0x86;
+export const D_LINK_TEST = 0x87;
+
+// payload sizes of hostlink_telem_t / D_MASTER_STATUS (index + status)
+export const TELEM_LEN = 35;
+export const MASTER_STATUS_LEN = 49;
+export const SYNC_LEN = 12;
+export const MASTER_PROFILE_LEN = 47;
+export const TRACE_LEN = 47;
+export const TRACE_ENTRIES = 4;
+export const LINK_TEST_LEN = 41;
+
+// boardlink_profile_t histograms: bucket n counts samples below
+// profileEdgeUs(n), the last one everything above
+export const PROFILE_BUCKETS = 8;
+export const profileEdgeUs = (n: number) => 375 << n;
+
+export const EVENT_NAMES: { [code: number]: string } = {
+  1: "boot",
+  2: "parse error",
+  3: "drop",
+  4: "master lost",
+  5: "master back",
+  6: "config",
+  7: "sched drop",
+  8: "path drop",
+};
+
+export const TF_USB_MOUNTED = 1 << 0;
+export const TF_MASTER_ALIVE = 1 << 1; // any master
+export const TF_USB_PAD = 1 << 2; // gamepad on the slave's PIO USB port
+
+// boardlink_status_t usb_state bits
+export const USB_MOUNTED = 1 << 0;
+export const USB_SUSPENDED = 1 << 1;
+export const USB_REMOTE_WAKEUP = 1 << 2;
+export const USB_SOF_LOCKED = 1 << 3;
+
+// data age histogram: bucket n counts ages below AGE_BUCKET0_US << n us,
+// the last one everything above
+export const AGE_BUCKETS = 8;
+export const AGE_BUCKET0_US = 125;
+
+export function crc8(
+  crc: number,
+  data: Uint8Array,
+  start = 0,
+  end = data.length,
+) {
+  for (let i = start; i < end; i++) {
+    crc ^= data[i];
+    for (let b = 0; b < 8; b++) {
+      crc = crc & 0x80 ? ((crc << 1) ^ 0x07) & 0xff : (crc << 1) & 0xff;
+    }
+  }
+  return crc;
+}
+
+export function encodeFrame(type: number, payload: ArrayLike<number>) {
+  const out = new Uint8Array(payload.length + 5);
+  out[0] = H2D_SYNC[0];
+  out[1] = H2D_SYNC[1];
+  out[2] = type;
+  out[3] = payload.length;
+  out.set(payload, 4);
+  out[out.length - 1] = crc8(0, out, 2, out.length - 1);
+  return out;
+}
+
+// Takes a 7 or FRAME16_LEN byte frame, H_FRAME16 only goes out while a low
+// byte is set so 8 bit input keeps the short frames.
+export function encodeControllerFrame(
+  controller: number,
+  frame: ArrayLike<number>,
+) {
+  let hires = false;
+  for (let i = FRAME_LEN; i < frame.length; i++) if (frame[i]) hires = true;
+  const payload = new Uint8Array(1 + (hires ? FRAME16_LEN : FRAME_LEN));
+  payload[0] = controller;
+  for (let i = 1; i < payload.length; i++) payload[i] = frame[i - 1];
+  if (hires) return encodeFrame(H_FRAME16, payload);
+  if (controller === 0) return encodeFrame(H_FRAME, payload.subarray(1));
+  return encodeFrame(H_FRAME_N, payload);
+}
+
+// H_SYNC, hostUs is sent as u32 and echoed in D_SYNC
+export function encodeSync(hostUs: number) {
+  const payload = new Uint8Array(4);
+  new DataView(payload.buffer).setUint32(0, Math.floor(hostUs) >>> 0, true);
+  return encodeFrame(H_SYNC, payload);
+}
+
+// H_FRAME_AT: apply frame at slave time atUs (u32, wraps)
+export function encodeFrameAt(
+  controller: number,
+  atUs: number,
+  frame: ArrayLike<number>,
+) {
+  const payload = new Uint8Array(5 + FRAME_LEN);
+  const view = new DataView(payload.buffer);
+  view.setUint8(0, controller);
+  view.setUint32(1, atUs >>> 0, true);
+  payload.set(frame, 5);
+  return encodeFrame(H_FRAME_AT, payload);
+}
+
+// bit per controller whose master should send its report trace, 0 = off
+export function encodeTrace(mask: number) {
+  return encodeFrame(H_TRACE, [mask & 0xff]);
+}
+
+// boardlink_path_t, see the stick path section of boardlink.h
+export const PATH_LEN = 22;
+export const PATH_LINE = 1;
+export const PATH_ARC = 2;
+export const PATH_CLEAR = 3;
+export const PATH_CHAIN = 1 << 0;
+export const EASES = { linear: 0, in: 1, out: 2, inOut: 3 } as const;
+export type Ease = keyof typeof EASES;
+
+export type PathSegment = {
+  stick: number; // 0 left, 1 right
+  shape: number; // PATH_*
+  ease: Ease;
+  atUs: number | null; // slave time (u32), null = after the previous one
+  durationUs: number;
+  a: readonly [number, number]; // LINE: start, ARC: center
+  b: readonly [number, number]; // LINE: end, ARC: radii
+  angle0: number; // ARC, turns, 0 = right, 0.25 = up
+  sweep: number; // ARC, turns, positive = counterclockwise
+};
+
+export function encodePath(controller: number, seg: PathSegment) {
+  const payload = new Uint8Array(1 + PATH_LEN);
+  const view = new DataView(payload.buffer);
+  const axis = (v: number) => Math.max(0, Math.min(255, Math.round(v)));
+  view.setUint8(0, controller);
+  view.setUint32(1, (seg.atUs ?? 0) >>> 0, true);
+  view.setUint32(5, Math.max(0, Math.round(seg.durationUs)) >>> 0, true);
+  view.setUint8(9, seg.stick);
+  view.setUint8(10, seg.shape);
+  view.setUint8(11, EASES[seg.ease]);
+  view.setUint8(12, seg.atUs === null ? PATH_CHAIN : 0);
+  payload.set([...seg.a.map(axis), ...seg.b.map(axis)], 13);
+  view.setUint16(17, Math.round(seg.angle0 * 65536) & 0xffff, true);
+  const sweep = Math.round(seg.sweep * 65536);
+  view.setInt32(19, Math.max(-(2 ** 31), Math.min(2 ** 31 - 1, sweep)), true);
+  return encodeFrame(H_PATH, payload);
+}
+
+// Board link test of a master built with HARUNA_LINK_TEST (boardlink.h),
+// 0 / undefined picks the firmware default.
+export const LINK_TEST_MAX = 32;
+export const LINK_TEST_MODES = { both: 0, read: 1, write: 2 } as const;
+export type LinkTestMode = keyof typeof LINK_TEST_MODES;
+
+export type LinkTestConfig = {
+  rateHz?: number; // transactions per second, default back to back
+  khz?: number; // bus speed, default 100, up to 1000
+  len?: number; // payload bytes, default 16, up to LINK_TEST_MAX
+  mode?: LinkTestMode; // default both (reads and writes alternate)
+};
+
+export function encodeLinkTest(controller: number, cfg: LinkTestConfig) {
+  const payload = new Uint8Array(7);
+  const view = new DataView(payload.buffer);
+  const clamp = (v: number | undefined, max: number) =>
+    Math.max(0, Math.min(max, Math.round(v ?? 0)));
+  view.setUint8(0, controller);
+  view.setUint16(1, clamp(cfg.rateHz, 0xffff), true);
+  view.setUint16(3, clamp(cfg.khz, 1000), true);
+  view.setUint8(5, clamp(cfg.len, LINK_TEST_MAX));
+  view.setUint8(6, LINK_TEST_MODES[cfg.mode ?? "both"]);
+  return encodeFrame(H_LINK_TEST, payload);
+}
+
+// eventMask bit n enables event code n + 1
+export function encodeTelemetryConfig(rateHz: number, eventMask = 0xff) {
+  return encodeFrame(H_TELEM_CFG, [
+    Math.max(0, Math.min(100, rateHz)),
+    eventMask,
+  ]);
+}
+
+export type Telemetry = {
+  tUs: number;
+  rdreq: number;
+  rxfull: number;
+  stop: number;
+  hostFrames: number;
+  parseErr: number;
+  drops: number;
+  queueDepth: number;
+  flags: number;
+  isrMaxUs: number;
+  loopMaxUs: number;
+  mastersAlive: number; // bit per controller
+  // boot -> first GET from a master / USB mounted, 0 until then
+  bootLinkMs: number;
+  bootUsbMs: number;
+};
+
+export type TelemetryEvent = {
+  tUs: number;
+  code: number;
+  arg: number;
+};
+
+export type MasterStatus = {
+  controller: number;
+  tUs: number;
+  usbState: number;
+  outReportSeq: number;
+  outReportId: number;
+  outReportLen: number;
+  pollUsLast: number;
+  pollUsAvg: number;
+  framesSent: number;
+  framesSkipped: number;
+  outReport: Uint8Array;
+  loopMaxUs: number;
+  reportMaxUs: number;
+  schedLateMaxUs: number;
+  // board link read -> report fetched, reports since the previous status
+  ageAvgUs: number;
+  ageMaxUs: number;
+  ageHist: Uint8Array;
+  // boot -> first report fetched by the console, 0 until then
+  bootReportMs: number;
+};
+
+export type Histogram = {
+  minUs: number;
+  avgUs: number;
+  maxUs: number;
+  count: number[];
+};
+
+// one profile period (1 s) of a master's USB reports
+export type MasterProfile = {
+  controller: number;
+  skipped: number; // report due but endpoint still busy
+  poll: Histogram; // between two completed IN reports
+  queue: Histogram; // report queued -> completed
+};
+
+// reports the console fetched, each differing from the one before
+export type ReportTrace = {
+  controller: number;
+  lost: number; // dropped on the master (ring full)
+  entries: { deviceUs: number; frame: Uint8Array }[];
+};
+
+// one window (1 s) of a master's link test
+export type LinkTestReport = {
+  controller: number;
+  windowUs: number;
+  baud: number;
+  rateHz: number; // configured, 0 = back to back
+  len: number;
+  mode: number; // LINK_TEST_MODES
+  transactions: number;
+  ok: number;
+  badData: number; // read with a wrong byte
+  nak: number;
+  timeout: number;
+  latP50Us: number; // start -> last byte
+  latP90Us: number;
+  latP99Us: number;
+  latMaxUs: number;
+  slaveRxOk: number; // writes the slave verified
+  slaveRxBad: number;
+};
+
+export type SyncReply = {
+  hostUs: number; // echoed, u32
+  rxUs: number;
+  txUs: number;
+};
+
+export function parseTelemetry(p: DataView): Telemetry {
+  return {
+    tUs: p.getUint32(0, true),
+    rdreq: p.getUint32(4, true),
+    rxfull: p.getUint32(8, true),
+    stop: p.getUint32(12, true),
+    hostFrames: p.getUint32(16, true),
+    parseErr: p.getUint16(20, true),
+    drops: p.getUint16(22, true),
+    queueDepth: p.getUint8(24),
+    flags: p.getUint8(25),
+    isrMaxUs: p.getUint16(26, true),
+    loopMaxUs: p.getUint16(28, true),
+    mastersAlive: p.getUint8(30),
+    bootLinkMs: p.getUint16(31, true),
+    bootUsbMs: p.getUint16(33, true),
+  };
+}
+
+// controller index, then boardlink_status_t
+export function parseMasterStatus(p: DataView): MasterStatus {
+  return {
+    controller: p.getUint8(0),
+    tUs: p.getUint32(1, true),
+    usbState: p.getUint8(5),
+    outReportSeq: p.getUint8(6),
+    outReportId: p.getUint8(7),
+    outReportLen: p.getUint8(8),
+    pollUsLast: p.getUint16(9, true),
+    pollUsAvg: p.getUint16(11, true),
+    framesSent: p.getUint32(13, true),
+    framesSkipped: p.getUint32(17, true),
+    outReport: new Uint8Array(
+      p.buffer.slice(p.byteOffset + 21, p.byteOffset + 29),
+    ),
+    loopMaxUs: p.getUint16(29, true),
+    reportMaxUs: p.getUint16(31, true),
+    schedLateMaxUs: p.getUint16(33, true),
+    ageAvgUs: p.getUint16(35, true),
+    ageMaxUs: p.getUint16(37, true),
+    ageHist: new Uint8Array(
+      p.buffer.slice(p.byteOffset + 39, p.byteOffset + 39 + AGE_BUCKETS),
+    ),
+    bootReportMs: p.getUint16(39 + AGE_BUCKETS, true),
+  };
+}
+
+function parseHistogram(p: DataView, o: number): Histogram {
+  const count: number[] = [];
+  for (let n = 0; n < PROFILE_BUCKETS; n++) {
+    count.push(p.getUint16(o + 6 + 2 * n, true));
+  }
+  return {
+    minUs: p.getUint16(o, true),
+    avgUs: p.getUint16(o + 2, true),
+    maxUs: p.getUint16(o + 4, true),
+    count,
+  };
+}
+
+// controller index, then boardlink_profile_t
+export function parseMasterProfile(p: DataView): MasterProfile {
+  const histLen = 6 + 2 * PROFILE_BUCKETS;
+  return {
+    controller: p.getUint8(0),
+    skipped: p.getUint16(1, true),
+    poll: parseHistogram(p, 3),
+    queue: parseHistogram(p, 3 + histLen),
+  };
+}
+
+// controller index, then boardlink_trace_t
+// controller index, then boardlink_test_report_t
+export function parseLinkTest(p: DataView): LinkTestReport {
+  return {
+    controller: p.getUint8(0),
+    windowUs: p.getUint32(1, true),
+    baud: p.getUint32(5, true),
+    rateHz: p.getUint16(9, true),
+    len: p.getUint8(11),
+    mode: p.getUint8(12),
+    transactions: p.getUint32(13, true),
+    ok: p.getUint32(17, true),
+    badData: p.getUint16(21, true),
+    nak: p.getUint16(23, true),
+    timeout: p.getUint16(25, true),
+    latP50Us: p.getUint16(27, true),
+    latP90Us: p.getUint16(29, true),
+    latP99Us: p.getUint16(31, true),
+    latMaxUs: p.getUint16(33, true),
+    slaveRxOk: p.getUint32(35, true),
+    slaveRxBad: p.getUint16(39, true),
+  };
+}
+
+export function parseTrace(p: DataView): ReportTrace {
+  const count = Math.min(p.getUint8(1), TRACE_ENTRIES);
+  const entries: ReportTrace["entries"] = [];
+  for (let i = 0; i < count; i++) {
+    const o = 3 + i * (4 + FRAME_LEN);
+    const start = p.byteOffset + o + 4;
+    entries.push({
+      deviceUs: p.getUint32(o, true),
+      frame: new Uint8Array(p.buffer.slice(start, start + FRAME_LEN)),
+    });
+  }
+  return { controller: p.getUint8(0), lost: p.getUint8(2), entries };
+}
+
+export function parseSync(p: DataView): SyncReply {
+  return {
+    hostUs: p.getUint32(0, true),
+    rxUs: p.getUint32(4, true),
+    txUs: p.getUint32(8, true),
+  };
+}
+
+export function parseEvents(p: DataView): TelemetryEvent[] {
+  const events: TelemetryEvent[] = [];
+  for (let o = 0; o + 6 <= p.byteLength; o += 6) {
+    events.push({
+      tUs: p.getUint32(o, true),
+      code: p.getUint8(o + 4),
+      arg: p.getUint8(o + 5),
+    });
+  }
+  return events;
+}
+
+// Streaming decoder for the slave -> host direction. Bytes outside of a
+// valid frame are collected as text lines.
+export class FrameDecoder {
+  private buf = new Uint8Array(256);
+  private len = 0;
+  private text = "";
+  private textDecoder = new TextDecoder();
+  private onFrame: (type: number, payload: DataView) => void;
+  private onText: (line: string) => void;
+  private onError: () => void;
+
+  constructor(
+    onFrame: (type: number, payload: DataView) => void,
+    onText: (line: string) => void,
+    onError: () => void = () => {},
+  ) {
+    this.onFrame = onFrame;
+    this.onText = onText;
+    this.onError = onError;
+  }
+
+  push(chunk: Uint8Array) {
+    if (this.len + chunk.length > this.buf.length) {
+      const next = new Uint8Array(
+        Math.max(this.buf.length * 2, this.len + chunk.length),
+      );
+      next.set(this.buf.subarray(0, this.len));
+      this.buf = next;
+    }
+    this.buf.set(chunk, this.len);
+    this.len += chunk.length;
+
+    let i = 0;
+    let textStart = 0;
+    while (i < this.len) {
+      if (this.buf[i] !== D2H_SYNC[0]) {
+        i++;
+        continue;
+      }
+      // need the full header to decide
+      if (i + 4 > this.len) break;
+      const payloadLen = this.buf[i + 3];
+      if (this.buf[i + 1] !== D2H_SYNC[1] || payloadLen > MAX_PAYLOAD) {
+        i++;
+        continue;
+      }
+      const end = i + 4 + payloadLen + 1;
+      if (end > this.len) break;
+      if (crc8(0, this.buf, i + 2, end - 1) !== this.buf[end - 1]) {
+        this.onError();
+        i++;
+        continue;
+      }
+      this.flushText(textStart, i);
+      this.onFrame(
+        this.buf[i + 2],
+        new DataView(this.buf.buffer.slice(i + 4, i + 4 + payloadLen)),
+      );
+      i = end;
+      textStart = i;
+    }
+    this.flushText(textStart, i);
+    this.buf.copyWithin(0, i, this.len);
+    this.len -= i;
+  }
+
+  private flushText(start: number, end: number) {
+    if (end <= start) return;
+    this.text += this.textDecoder.decode(this.buf.subarray(start, end), {
+      stream: true,
+    });
+    let nl: number;
+    while ((nl = this.text.indexOf("\n")) >= 0) {
+      const line = this.text.slice(0, nl).replace(/\r$/, "");
+      this.text = this.text.slice(nl + 1);
+      if (line.length) this.onText(line);
+    }
+  }
+}
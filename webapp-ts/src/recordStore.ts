@@ -0,0 +1,203 @@
+// IndexedDB storage for recordings.
+// A capture ("session") is stored as chunks of up to CHUNK_SAMPLES samples,
+// keyed by [session, index], so it can be written while recording and read
+// back one chunk at a time. Saving a recording only writes its metadata.
+//
+// Chunk layout (little endian), gzip compressed when CompressionStream is
+// available:
+//   u32 length, u32 reserved, f64 time[length] (ms from the first sample),
+//   then FRAME_LEN byte columns of length bytes each.
+import { FRAME_LEN } from "./protocol";
+
+export const CHUNK_SAMPLES = 4096;
+
+const DB_NAME = "haruna-recordings";
+const DB_VERSION = 1;
+const META_STORE = "recordings";
+const CHUNK_STORE = "chunks";
+
+export type RecordingMeta = {
+  name: string;
+  session: string;
+  samples: number;
+  chunks: number;
+  durationMs: number;
+};
+
+type StoredChunk = {
+  session: string;
+  index: number;
+  codec: "gzip" | "raw";
+  data: ArrayBuffer;
+};
+
+// Columnar samples: one timestamp column and one column per frame field.
+export class SampleChunk {
+  readonly capacity: number;
+  readonly times: Float64Array;
+  readonly fields: Uint8Array;
+  length = 0;
+
+  constructor(capacity = CHUNK_SAMPLES) {
+    this.capacity = capacity;
+    this.times = new Float64Array(capacity);
+    this.fields = new Uint8Array(capacity * FRAME_LEN);
+  }
+
+  get full() {
+    return this.length >= this.capacity;
+  }
+
+  push(timeMs: number, frame: ArrayLike<number>) {
+    const i = this.length++;
+    this.times[i] = timeMs;
+    for (let f = 0; f < FRAME_LEN; f++) {
+      this.fields[f * this.capacity + i] = frame[f];
+    }
+  }
+
+  read(i: number, out: Uint8Array) {
+    for (let f = 0; f < FRAME_LEN; f++) {
+      out[f] = this.fields[f * this.capacity + i];
+    }
+  }
+
+  encode(): ArrayBuffer {
+    const n = this.length;
+    const buf = new ArrayBuffer(8 + n * 8 + n * FRAME_LEN);
+    new DataView(buf).setUint32(0, n, true);
+    new Float64Array(buf, 8, n).set(this.times.subarray(0, n));
+    const columns = new Uint8Array(buf, 8 + n * 8);
+    for (let f = 0; f < FRAME_LEN; f++) {
+      const start = f * this.capacity;
+      columns.set(this.fields.subarray(start, start + n), f * n);
+    }
+    return buf;
+  }
+
+  static decode(buf: ArrayBuffer) {
+    const n = new DataView(buf).getUint32(0, true);
+    const chunk = new SampleChunk(n);
+    chunk.times.set(new Float64Array(buf, 8, n));
+    chunk.fields.set(new Uint8Array(buf, 8 + n * 8, n * FRAME_LEN));
+    chunk.length = n;
+    return chunk;
+  }
+}
+
+let dbPromise: Promise<IDBDatabase> | null = null;
+
+function openDb() {
+  dbPromise ??= new Promise((resolve, reject) => {
+    const open = indexedDB.open(DB_NAME, DB_VERSION);
+    open.onupgradeneeded = () => {
+      const db = open.result;
+      db.createObjectStore(META_STORE, { keyPath: "name" });
+      db.createObjectStore(CHUNK_STORE, { keyPath: ["session", "index"] });
+    };
+    open.onsuccess = () => resolve(open.result);
+    open.onerror = () => reject(open.error);
+  });
+  return dbPromise;
+}
+
+function request<T>(r: IDBRequest<T>) {
+  return new Promise<T>((resolve, reject) => {
+    r.onsuccess = () => resolve(r.result);
+    r.onerror = () => reject(r.error);
+  });
+}
+
+async function store(name: string, mode: IDBTransactionMode) {
+  const db = await openDb();
+  return db.transaction(name, mode).objectStore(name);
+}
+
+function sessionRange(session: string) {
+  return IDBKeyRange.bound([session, 0], [session, Infinity]);
+}
+
+async function transform(data: ArrayBuffer, stream: GenericTransformStream) {
+  return new Response(
+    new Blob([data]).stream().pipeThrough(stream),
+  ).arrayBuffer();
+}
+
+export function newSessionId() {
+  return `${Date.now().toString(36)}-${Math.random().toString(36).slice(2)}`;
+}
+
+export async function putChunk(
+  session: string,
+  index: number,
+  chunk: SampleChunk,
+) {
+  const raw = chunk.encode();
+  const stored: StoredChunk =
+    typeof CompressionStream === "function"
+      ? {
+          session,
+          index,
+          codec: "gzip",
+          data: await transform(raw, new CompressionStream("gzip")),
+        }
+      : { session, index, codec: "raw", data: raw };
+  await request((await store(CHUNK_STORE, "readwrite")).put(stored));
+}
+
+export async function getChunk(session: string, index: number) {
+  const stored: StoredChunk | undefined = await request(
+    (await store(CHUNK_STORE, "readonly")).get([session, index]),
+  );
+  if (!stored) throw new Error(`Missing chunk ${index} of ${session}`);
+  const raw =
+    stored.codec === "gzip"
+      ? await transform(stored.data, new DecompressionStream("gzip"))
+      : stored.data;
+  return SampleChunk.decode(raw);
+}
+
+export async function deleteSession(session: string) {
+  await request(
+    (await store(CHUNK_STORE, "readwrite")).delete(sessionRange(session)),
+  );
+}
+
+export async function putMeta(meta: RecordingMeta) {
+  await request((await store(META_STORE, "readwrite")).put(meta));
+}
+
+export async function getMeta(name: string) {
+  const meta: RecordingMeta | undefined = await request(
+    (await store(META_STORE, "readonly")).get(name),
+  );
+  return meta ?? null;
+}
+
+export async function deleteMeta(name: string) {
+  await request((await store(META_STORE, "readwrite")).delete(name));
+}
+
+export async function listMeta() {
+  const metas: RecordingMeta[] = await request(
+    (await store(META_STORE, "readonly")).getAll(),
+  );
+  return metas;
+}
+
+// Removes chunks of captures that were never saved, except the one that is
+// being recorded.
+export async function deleteOrphanSessions(active: () => string | null) {
+  const keep = new Set((await listMeta()).map((m) => m.session));
+  const keys = await request(
+    (await store(CHUNK_STORE, "readonly")).getAllKeys(),
+  );
+  const orphans = new Set<string>();
+  for (const key of keys) {
+    const session = (key as [string, number])[0];
+    if (!keep.has(session)) orphans.add(session);
+  }
+  const current = active();
+  if (current) orphans.delete(current);
+  for (const session of orphans) await deleteSession(session);
+}
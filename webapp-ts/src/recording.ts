@@ -1,8 +1,41 @@
+import { addLog } from "./log";
+import { FRAME_LEN } from "./protocol";
+import {
+  deleteMeta,
+  deleteOrphanSessions,
+  deleteSession,
+  getChunk,
+  getMeta,
+  listMeta,
+  newSessionId,
+  putChunk,
+  putMeta,
+  SampleChunk,
+  type RecordingMeta,
+} from "./recordStore";
+import { benchmarkRecording, formatReplayReport } from "./replayBench";
+import { setMacroRunning } from "./serial";
 import { stateManager } from "./state";
 
+// Capture in progress / last capture. Full chunks are compressed and
+// written to IndexedDB while recording, nothing but the current chunk is
+// kept in memory.
 let recordStartTime: number | null = null;
-let recordedData: [number[], number][] = [];
+let session: string | null = null;
+let sessionSaved = false;
+let chunk = new SampleChunk();
+let chunkIndex = 0;
+let samples = 0;
+let lastTimeMs = 0;
+let writes: Promise<void> = Promise.resolve();
+
+let recordingNames: string[] = [];
+
+let playGeneration = 0;
+let playing = false;
 let timeout: number | null = null;
+// resolves the pending sleep(), so a cancelled playback returns
+let wake: (() => void) | null = null;
 
 export type RecordPlayListener = (props: {
   index: number;
@@ -30,105 +63,221 @@ function emitRecordPlayEvent(
   }
 }
 
-export function recordData(binary: number[]) {
+function flushChunk() {
+  if (!session || chunk.length === 0) return;
+  const full = chunk;
+  const index = chunkIndex++;
+  const target = session;
+  chunk = new SampleChunk();
+  writes = writes
+    .then(() => putChunk(target, index, full))
+    .catch((e) => addLog(`Recording write failed: ${e.message}`, "error"));
+}
+
+export function recordData(frame: ArrayLike<number>) {
   if (recordStartTime === null) return;
-  if (binary.length !== 7) return;
-  if (recordedData.length == 0) recordStartTime = performance.now();
-  const currentTime = performance.now();
-  recordedData.push([binary, currentTime - recordStartTime]);
+  // recordings keep the 8 bit frame, low bytes are dropped
+  if (frame.length < FRAME_LEN) return;
+  if (samples == 0) recordStartTime = performance.now();
+  lastTimeMs = performance.now() - recordStartTime;
+  chunk.push(lastTimeMs, frame);
+  samples++;
+  if (chunk.full) flushChunk();
 }
 
 export function startRecording() {
+  // drop the previous capture if it was never saved
+  if (session && !sessionSaved) {
+    const old = session;
+    writes = writes.then(() => deleteSession(old)).catch(() => {});
+  }
+  session = newSessionId();
+  sessionSaved = false;
+  chunk = new SampleChunk();
+  chunkIndex = 0;
+  samples = 0;
+  lastTimeMs = 0;
   recordStartTime = performance.now();
-  recordedData = [];
   updateUI();
 }
 
 export function stopRecording() {
   recordStartTime = null;
+  flushChunk();
   updateUI();
-  return recordedData;
+  return samples;
 }
 
-export function saveRecording(name: string) {
-  localStorage.setItem(`rcd::item::${name}`, JSON.stringify(recordedData));
-  const recordings = JSON.parse(localStorage.getItem("rcd::list") || "[]");
-  if (!recordings.includes(name)) {
-    recordings.push(name);
-    localStorage.setItem("rcd::list", JSON.stringify(recordings));
+// Only writes metadata, the samples are already in IndexedDB.
+export async function saveRecording(name: string) {
+  if (!session || samples === 0) return;
+  await writes;
+  const previous = await getMeta(name);
+  await putMeta({
+    name,
+    session,
+    samples,
+    chunks: chunkIndex,
+    durationMs: lastTimeMs,
+  });
+  if (previous && previous.session !== session) {
+    await deleteSession(previous.session);
   }
-  updateUI();
+  sessionSaved = true;
+  await refreshRecordingList();
 }
 
 export function getRecordingList() {
-  return JSON.parse(localStorage.getItem("rcd::list") || "[]");
+  return recordingNames;
 }
 
-export function removeRecording(name: string) {
-  localStorage.removeItem(`rcd::item::${name}`);
-  const recordings = JSON.parse(localStorage.getItem("rcd::list") || "[]");
-  localStorage.setItem(
-    "rcd::list",
-    JSON.stringify(recordings.filter((n: string) => n !== name)),
-  );
+export async function removeRecording(name: string) {
+  const meta = await getMeta(name);
+  if (!meta) return;
+  await deleteMeta(name);
+  if (meta.session !== session) await deleteSession(meta.session);
+  else sessionSaved = false;
+  await refreshRecordingList();
+}
+
+async function refreshRecordingList() {
+  recordingNames = (await listMeta()).map((m) => m.name);
   updateUI();
 }
 
-export function playRecording(name: string): Promise<void> {
-  return new Promise((resolve, reject) => {
-    const dataStr = localStorage.getItem(`rcd::item::${name}`);
-    if (!dataStr) {
-      reject(new Error("Recording not found"));
-      return;
+// All samples in the old [frame, timeMs][] JSON shape (export).
+async function loadRecordingJson(meta: RecordingMeta) {
+  const data: [number[], number][] = [];
+  const frame = new Uint8Array(FRAME_LEN);
+  for (let c = 0; c < meta.chunks; c++) {
+    const chunk = await getChunk(meta.session, c);
+    for (let i = 0; i < chunk.length; i++) {
+      chunk.read(i, frame);
+      data.push([Array.from(frame), chunk.times[i]]);
     }
-    const data: [number[], number][] = JSON.parse(dataStr);
-    let startTime = performance.now();
-    let index = 0;
+  }
+  return data;
+}
 
-    let maxTimestamp = data[data.length - 1][1];
+// [frame, timeMs] of every sample, for tools that need the whole timeline
+export async function getRecordingSamples(name: string) {
+  const meta = await getMeta(name);
+  if (!meta) throw new Error("Recording not found");
+  return loadRecordingJson(meta);
+}
 
-    if (timeout !== null) {
-      clearTimeout(timeout);
+function sleep(ms: number) {
+  return new Promise<void>((resolve) => {
+    wake = resolve;
+    timeout = window.setTimeout(() => {
       timeout = null;
-    }
-
-    function scheduleNext() {
-      if (index >= data.length) {
-        resolve();
-        stateManager.forceSet = null;
-        timeout = null;
-        return;
-      }
-      console.log(`Playing index ${index}`);
-      const [binary, timestamp] = data[index];
-
-      const delay = timestamp - (performance.now() - startTime);
-      const timeoutId = window.setTimeout(
-        () => {
-          stateManager.forceSet = new Uint8Array(binary);
-          emitRecordPlayEvent(
-            index + 1,
-            data.length,
-            Math.min(1, timestamp / maxTimestamp),
-          );
-          index++;
-          scheduleNext();
-        },
-        Math.max(0, delay),
-      );
-      timeout = timeoutId;
-    }
-
-    scheduleNext();
+      wake = null;
+      resolve();
+    }, ms);
   });
 }
 
-export function stopPlaying() {
+// Ends the pending sleep() early; the playback it belongs to sees its
+// generation changed and returns.
+function cancelSleep() {
   if (timeout !== null) {
     clearTimeout(timeout);
     timeout = null;
   }
+  const resolve = wake;
+  wake = null;
+  resolve?.();
+}
+
+// Chunks are loaded on demand, the next one is fetched while the current
+// one plays. onStart gets the performance.now() sample times count from.
+export async function playRecording(
+  name: string,
+  onStart?: (startTime: number) => void,
+): Promise<void> {
+  const meta = await getMeta(name);
+  if (!meta) throw new Error("Recording not found");
+
+  const generation = ++playGeneration;
+  cancelSleep();
+  playing = true;
+  setMacroRunning(true);
+  updateUI();
+
+  const frame = new Uint8Array(FRAME_LEN);
+  const maxTimestamp = meta.durationMs || 1;
+  let next: Promise<SampleChunk> | null = getChunk(meta.session, 0);
+  let index = 0;
+  const startTime = performance.now();
+  onStart?.(startTime);
+  try {
+    for (let c = 0; next; c++) {
+      const current: SampleChunk = await next;
+      if (generation !== playGeneration) return;
+      next = c + 1 < meta.chunks ? getChunk(meta.session, c + 1) : null;
+      for (let i = 0; i < current.length; i++) {
+        const timestamp = current.times[i];
+        await sleep(Math.max(0, timestamp - (performance.now() - startTime)));
+        if (generation !== playGeneration) return;
+
+        current.read(i, frame);
+        stateManager.forceSet = frame;
+        emitRecordPlayEvent(
+          ++index,
+          meta.samples,
+          Math.min(1, timestamp / maxTimestamp),
+        );
+      }
+    }
+  } finally {
+    if (generation === playGeneration) {
+      stateManager.forceSet = null;
+      playing = false;
+      setMacroRunning(false);
+      updateUI();
+    }
+  }
+}
+
+export function stopPlaying() {
+  playGeneration++;
+  cancelSleep();
+  playing = false;
   stateManager.forceSet = null;
+  setMacroRunning(false);
+}
+
+// Recordings used to live in localStorage as JSON, move them over once.
+async function migrateLocalStorage() {
+  const names: string[] = JSON.parse(
+    localStorage.getItem("rcd::list") || "[]",
+  );
+  for (const name of names) {
+    const dataStr = localStorage.getItem(`rcd::item::${name}`);
+    if (dataStr) {
+      const data: [number[], number][] = JSON.parse(dataStr);
+      const target = newSessionId();
+      let part = new SampleChunk();
+      let chunks = 0;
+      for (const [binary, timestamp] of data) {
+        part.push(timestamp, binary);
+        if (part.full) {
+          await putChunk(target, chunks++, part);
+          part = new SampleChunk();
+        }
+      }
+      if (part.length) await putChunk(target, chunks++, part);
+      await putMeta({
+        name,
+        session: target,
+        samples: data.length,
+        chunks,
+        durationMs: data.length ? data[data.length - 1][1] : 0,
+      });
+    }
+    localStorage.removeItem(`rcd::item::${name}`);
+  }
+  localStorage.removeItem("rcd::list");
 }
 
 // ============== UI CONTROLS ==============
@@ -149,11 +298,11 @@ function updateUI() {
     "saveReplayBtn",
   ) as HTMLButtonElement;
   saveReplayBtn.disabled =
-    recordStartTime !== null || recordedData.length === 0;
+    recordStartTime !== null || sessionSaved || samples === 0;
   const stopReplayBtn = document.getElementById(
     "stopReplayBtn",
   ) as HTMLButtonElement;
-  stopReplayBtn.disabled = timeout === null;
+  stopReplayBtn.disabled = !playing;
 }
 
 document.getElementById("recordBtn")?.addEventListener("click", () => {
@@ -167,8 +316,9 @@ document.getElementById("stopBtn")?.addEventListener("click", () => {
 document.getElementById("saveReplayBtn")?.addEventListener("click", () => {
   const name = prompt("Enter a name for the recording:");
   if (name) {
-    saveRecording(name);
-    alert(`Recording saved as "${name}"`);
+    saveRecording(name)
+      .then(() => alert(`Recording saved as "${name}"`))
+      .catch((e) => alert(`Save failed: ${e.message}`));
   }
   updateUI();
 });
@@ -181,9 +331,7 @@ const replayList = document.getElementById("replayList");
 
 function renderReplayList() {
   if (!replayList) return;
-  const replays = JSON.parse(
-    localStorage.getItem("rcd::list") || "[]",
-  ) as string[];
+  const replays = recordingNames;
   replayList.innerHTML = "";
   let table = document.createElement("table");
   if (replays.length === 0) {
@@ -198,6 +346,7 @@ function renderReplayList() {
     const replayMultiBtn = document.createElement("button");
     const deleteBtn = document.createElement("button");
     const exportBtn = document.createElement("button");
+    const benchBtn = document.createElement("button");
     const emptyDiv = document.createElement("div");
 
     // Delete button
@@ -262,13 +411,27 @@ function renderReplayList() {
         removeRecording(r);
       }
     });
+    benchBtn.textContent = "Benchmark";
+    benchBtn.style.marginLeft = "6px";
+    benchBtn.addEventListener("click", async () => {
+      benchBtn.disabled = true;
+      try {
+        const report = await benchmarkRecording(r);
+        addLog(`Benchmark "${r}": ${formatReplayReport(report)}`, "info");
+      } catch (e) {
+        addLog(`Benchmark "${r}" failed: ${(e as Error).message}`, "error");
+      } finally {
+        benchBtn.disabled = false;
+      }
+    });
     exportBtn.style.marginLeft = "6px";
-    exportBtn.addEventListener("click", () => {
-      const dataStr = localStorage.getItem(`rcd::item::${r}`);
-      if (!dataStr) {
+    exportBtn.addEventListener("click", async () => {
+      const meta = await getMeta(r);
+      if (!meta) {
         alert("Recording not found");
         return;
       }
+      const dataStr = JSON.stringify(await loadRecordingJson(meta));
       const blob = new Blob([dataStr], { type: "application/json" });
       const url = URL.createObjectURL(blob);
       const a = document.createElement("a");
@@ -288,6 +451,7 @@ function renderReplayList() {
     td2.appendChild(replayMultiBtn);
     td2.appendChild(emptyDiv);
     td2.classList.add("align-right-td");
+    td2.appendChild(benchBtn);
     td2.appendChild(exportBtn);
     td2.appendChild(deleteBtn);
     tr1.appendChild(td1);
@@ -299,3 +463,7 @@ function renderReplayList() {
 }
 
 updateUI();
+migrateLocalStorage()
+  .then(() => deleteOrphanSessions(() => session))
+  .then(refreshRecordingList)
+  .catch((e) => addLog(`Recording storage error: ${e.message}`, "error"));
@@ -0,0 +1,175 @@
+// Replay fidelity benchmark. Plays a recording on controller 0 while its
+// master traces every report the console fetched (H_TRACE), then lines both
+// timelines up on the host clock (see clock.ts).
+//
+//   const report = await benchmarkRecording("jump");
+//   report.score; // ms, lower is better
+import { deviceClock, hostMicros } from "./clock";
+import { encodeTrace, FRAME_LEN, NEUTRAL_FRAME } from "./protocol";
+import { getRecordingSamples, playRecording } from "./recording";
+import { sendControl } from "./sender";
+import { addTraceListener } from "./telemetry";
+
+// trace entries still on their way before / after playback
+const SETTLE_MS = 300;
+// an emitted report only counts for a source event this close to it
+const MATCH_WINDOW_MS = 250;
+// an unmatched event followed this soon by the next one was overwritten
+// before any report carried it
+const MERGE_WINDOW_MS = 10;
+
+export type TimedFrame = { timeMs: number; frame: Uint8Array };
+
+export type ReplayReport = {
+  events: number; // state changes in the recording
+  matched: number;
+  merged: number; // overwritten by the next event before being sent
+  dropped: number; // never reached the console
+  // emitted changes no source event accounts for, up to the last match
+  // (the state going back after playback is not counted)
+  extra: number;
+  lost: number; // trace entries the master had no room for
+  errorsMs: number[]; // emitted - intended, per matched event
+  p50Ms: number;
+  p99Ms: number;
+  maxMs: number;
+  // p99 of |timing error| over all events, misses count as MATCH_WINDOW_MS
+  score: number;
+};
+
+function sameFrame(a: ArrayLike<number>, b: ArrayLike<number>) {
+  for (let i = 0; i < FRAME_LEN; i++) if (a[i] !== b[i]) return false;
+  return true;
+}
+
+// nearest rank
+function percentile(sorted: number[], q: number) {
+  if (sorted.length === 0) return 0;
+  const rank = Math.ceil(q * sorted.length) - 1;
+  return sorted[Math.min(sorted.length - 1, Math.max(0, rank))];
+}
+
+// Drops samples that repeat the previous frame, starting from initial.
+function changes(timeline: TimedFrame[], initial: ArrayLike<number>) {
+  const out: TimedFrame[] = [];
+  let prev = initial;
+  for (const t of timeline) {
+    if (sameFrame(t.frame, prev)) continue;
+    out.push(t);
+    prev = t.frame;
+  }
+  return out;
+}
+
+// Matches every source change to the first emitted report with the same
+// frame, in order and within MATCH_WINDOW_MS. Both timelines share a clock.
+export function compareTimelines(
+  source: TimedFrame[],
+  emitted: TimedFrame[],
+  lost = 0,
+): ReplayReport {
+  const errorsMs: number[] = [];
+  const absErrors: number[] = [];
+  let merged = 0;
+  let dropped = 0;
+  let next = 0;
+
+  source.forEach((event, i) => {
+    let k = next;
+    while (
+      k < emitted.length &&
+      emitted[k].timeMs < event.timeMs - MATCH_WINDOW_MS
+    ) {
+      k++;
+    }
+    for (; k < emitted.length; k++) {
+      if (emitted[k].timeMs > event.timeMs + MATCH_WINDOW_MS) break;
+      if (!sameFrame(emitted[k].frame, event.frame)) continue;
+      const error = emitted[k].timeMs - event.timeMs;
+      errorsMs.push(error);
+      absErrors.push(Math.abs(error));
+      next = k + 1;
+      return;
+    }
+    const following = source[i + 1];
+    if (following && following.timeMs - event.timeMs < MERGE_WINDOW_MS) {
+      merged++;
+    } else {
+      dropped++;
+    }
+    absErrors.push(MATCH_WINDOW_MS);
+  });
+
+  const sorted = [...errorsMs].sort((a, b) => a - b);
+  absErrors.sort((a, b) => a - b);
+  return {
+    events: source.length,
+    matched: errorsMs.length,
+    merged,
+    dropped,
+    extra: next - errorsMs.length,
+    lost,
+    errorsMs,
+    p50Ms: percentile(sorted, 0.5),
+    p99Ms: percentile(sorted, 0.99),
+    maxMs: sorted.length ? sorted[sorted.length - 1] : 0,
+    score: percentile(absErrors, 0.99),
+  };
+}
+
+export function formatReplayReport(r: ReplayReport) {
+  const ms = (v: number) => v.toFixed(1);
+  return (
+    `score ${ms(r.score)} ms (skew p50 ${ms(r.p50Ms)} / p99 ${ms(r.p99Ms)}` +
+    ` / max ${ms(r.maxMs)} ms), ${r.matched}/${r.events} matched,` +
+    ` ${r.merged} merged, ${r.dropped} dropped, ${r.extra} extra` +
+    (r.lost ? `, ${r.lost} trace entries lost` : "")
+  );
+}
+
+function sleep(ms: number) {
+  return new Promise<void>((resolve) => setTimeout(resolve, ms));
+}
+
+// Needs a connected, clock-synced slave; playback is on controller 0.
+export async function benchmarkRecording(name: string) {
+  if (!deviceClock.synced) throw new Error("Clock not synced, connect first");
+  const samples = await getRecordingSamples(name);
+
+  const emitted: TimedFrame[] = [];
+  let lost = 0;
+  const off = addTraceListener((trace) => {
+    if (trace.controller !== 0) return;
+    lost += trace.lost;
+    const near = hostMicros();
+    for (const entry of trace.entries) {
+      const timeMs = deviceClock.toHost(entry.deviceUs, near) / 1000;
+      emitted.push({ timeMs, frame: entry.frame });
+    }
+  });
+
+  let startMs = 0;
+  try {
+    if (!sendControl(encodeTrace(1))) throw new Error("Not connected");
+    await sleep(SETTLE_MS); // the master reports the current state first
+    await playRecording(name, (startTime) => {
+      startMs = performance.timeOrigin + startTime;
+    });
+    await sleep(SETTLE_MS);
+  } finally {
+    sendControl(encodeTrace(0));
+    off();
+  }
+
+  // the console's state when playback started is the baseline
+  const before = emitted.filter((e) => e.timeMs < startMs);
+  const after = emitted.filter((e) => e.timeMs >= startMs);
+  const initial = before.length
+    ? before[before.length - 1].frame
+    : NEUTRAL_FRAME;
+  const source = samples.map(([frame, timeMs]) => ({
+    timeMs: startMs + timeMs,
+    frame: Uint8Array.from(frame),
+  }));
+  return compareTimelines(changes(source, initial), after, lost);
+}
@@ -0,0 +1,170 @@
+// One timeline shared by every script (ns.at / ns.waitFrames), instead of a
+// setTimeout chain per script iframe:
+//
+//   const t = ns.time() + 500;
+//   await ns.at(t, () => ns.frame({ b: { A: true }, l: [255, 128] }));
+//   await ns.waitFrames(2);
+//   ns.frame({ b: { A: false }, l: [128, 128] });
+//
+// Times are host clock ms (ns.clock.now()). A single wakeup from
+// scheduler.worker.ts runs every task due by then in time order, in one go,
+// so changes made by tasks due together reach the console in the same
+// frame. While a tick's tasks and their promise continuations run, time()
+// stays on the due time (the virtual clock), so at(time() + ms) chains do
+// not drift with wakeup latency.
+import { hostMicros } from "./clock";
+import { addLog } from "./log";
+import type { SchedulerMessage, SchedulerRequest } from "./scheduler.worker";
+import { masterStatus } from "./telemetry";
+
+// console poll interval until the master has reported one
+const DEFAULT_FRAME_US = 8000;
+// game frame while no camera grid is locked
+const DEFAULT_GAME_FRAME_MS = 1000 / 60;
+// host -> slave -> master on top of the console poll
+const LINK_LEAD_MS = 3;
+
+// Game frame boundaries on the host clock (framePhase.ts).
+export type GameFrameGrid = {
+  periodMs: number;
+  // any boundary, the others are whole periods away
+  boundaryMs: number;
+};
+
+type Task = {
+  atUs: number;
+  owner: string;
+  run: () => void;
+};
+
+const worker = new Worker(new URL("./scheduler.worker.ts", import.meta.url), {
+  type: "module",
+});
+
+// sorted by time, in insertion order among equal times
+let tasks: Task[] = [];
+let armedUs = Infinity;
+// due time of the tick being run, null between ticks
+let currentUs: number | null = null;
+let running = false;
+
+// ends the virtual time once every continuation of the tick has run
+const tickEnd = new MessageChannel();
+tickEnd.port1.onmessage = () => {
+  currentUs = null;
+};
+
+function request(msg: SchedulerRequest) {
+  worker.postMessage(msg);
+}
+
+function arm() {
+  if (running) return;
+  const atUs = tasks.length ? tasks[0].atUs : Infinity;
+  if (atUs === armedUs) return;
+  armedUs = atUs;
+  request(atUs === Infinity ? { kind: "disarm" } : { kind: "arm", atUs });
+}
+
+function insert(task: Task) {
+  let lo = 0;
+  let hi = tasks.length;
+  while (lo < hi) {
+    const mid = (lo + hi) >> 1;
+    if (tasks[mid].atUs <= task.atUs) lo = mid + 1;
+    else hi = mid;
+  }
+  tasks.splice(lo, 0, task);
+  if (lo === 0) arm();
+}
+
+worker.onmessage = (_: MessageEvent<SchedulerMessage>) => {
+  armedUs = Infinity;
+  running = true;
+
+  // tasks queued by the ones run here for the same time still go this tick
+  const now = hostMicros();
+  while (tasks.length && tasks[0].atUs <= now) {
+    const task = tasks.shift()!;
+    currentUs = Math.max(currentUs ?? 0, task.atUs);
+    try {
+      task.run();
+    } catch (error: any) {
+      addLog(`[${task.owner}] scheduled task: ${error.message}`, "error");
+    }
+  }
+  running = false;
+  if (currentUs !== null) tickEnd.port2.postMessage(null);
+  arm();
+};
+
+// Timeline time in host clock ms: the due time inside a tick, now otherwise.
+export function timelineNow() {
+  return (currentUs ?? hostMicros()) / 1000;
+}
+
+// Runs fn (if any) at atMs and resolves with atMs after it. Times in the
+// past run on the next tick, in order.
+export function scheduleAt(
+  owner: string,
+  atMs: number,
+  fn?: () => void,
+): Promise<number> {
+  return new Promise((resolve) => {
+    insert({
+      atUs: atMs * 1000,
+      owner,
+      run: () => {
+        try {
+          fn?.();
+        } finally {
+          resolve(atMs);
+        }
+      },
+    });
+  });
+}
+
+// Console frames (poll interval the master measured) after the timeline's
+// current time.
+export function scheduleFrames(owner: string, controller: number, n: number) {
+  const pollUs = masterStatus[controller]?.pollUsAvg || DEFAULT_FRAME_US;
+  return scheduleAt(owner, timelineNow() + (n * pollUs) / 1000);
+}
+
+let gameFrame: GameFrameGrid | null = null;
+
+export function setGameFrame(grid: GameFrameGrid | null) {
+  gameFrame = grid;
+}
+
+export function getGameFrame() {
+  return gameFrame;
+}
+
+// Resolves leadMs before the n-th game frame boundary after the timeline's
+// current time, so an input made then is on the console when the game
+// samples it. The default lead is one console poll plus the link. Without a
+// grid it waits n 60 Hz frames.
+export function scheduleGameFrame(
+  owner: string,
+  controller: number,
+  n: number,
+  leadMs?: number,
+) {
+  const now = timelineNow();
+  if (!gameFrame) return scheduleAt(owner, now + n * DEFAULT_GAME_FRAME_MS);
+
+  const pollUs = masterStatus[controller]?.pollUsAvg || DEFAULT_FRAME_US;
+  const lead = leadMs ?? pollUs / 1000 + LINK_LEAD_MS;
+  const { periodMs, boundaryMs } = gameFrame;
+  const k = Math.floor((now + lead - boundaryMs) / periodMs) + n;
+  return scheduleAt(owner, boundaryMs + k * periodMs - lead);
+}
+
+// Drops the pending tasks of a script that was unloaded, their promises
+// never settle.
+export function cancelScheduled(owner: string) {
+  tasks = tasks.filter((task) => task.owner !== owner);
+  arm();
+}
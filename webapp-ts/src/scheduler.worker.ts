@@ -0,0 +1,35 @@
+// Wakeup timer of the script timeline (scheduler.ts) off the main thread.
+// Input:  SchedulerRequest, the due time of the earliest task.
+// Output: SchedulerMessage, once that time is reached.
+// Worker timers are not clamped like the ones of background tabs and nested
+// iframe timeouts; the last SPIN_MS are busy waited so a tick lands within
+// a few tens of microseconds.
+import { hostMicros } from "./clock";
+
+export type SchedulerRequest =
+  | { kind: "arm"; atUs: number }
+  | { kind: "disarm" };
+
+export type SchedulerMessage = { kind: "tick" };
+
+const SPIN_MS = 2;
+
+let timer: number | undefined;
+
+function fire(atUs: number) {
+  timer = undefined;
+  while (hostMicros() < atUs);
+  const msg: SchedulerMessage = { kind: "tick" };
+  self.postMessage(msg);
+}
+
+self.onmessage = (e: MessageEvent<SchedulerRequest>) => {
+  const msg = e.data;
+  clearTimeout(timer);
+  timer = undefined;
+  if (msg.kind !== "arm") return;
+
+  const waitMs = (msg.atUs - hostMicros()) / 1000 - SPIN_MS;
+  if (waitMs <= 0) fire(msg.atUs);
+  else timer = setTimeout(() => fire(msg.atUs), waitMs);
+};
@@ -1,10 +1,40 @@
+import { deviceClock, hostMicros } from "./clock";
 import type { NS } from "./global";
 import { addLog } from "./log";
 import { playRecording, stopPlaying } from "./recording";
-import { StateInstance, stateManager } from "./state";
+import { benchmarkRecording } from "./replayBench";
+import {
+  cancelScheduled,
+  getGameFrame,
+  scheduleAt,
+  scheduleFrames,
+  scheduleGameFrame,
+  setGameFrame,
+  timelineNow,
+} from "./scheduler";
+import { scheduleFrame, sendLinkTest } from "./sender";
+import { controllers, StateInstance, stateManager } from "./state";
+import { pathArc, pathCircle, pathClear, pathLine } from "./stickPath";
+import {
+  addMasterStatusListener,
+  masterLinkTest,
+  masterProfile,
+  masterStatus,
+  removeMasterStatusListener,
+} from "./telemetry";
 
-function createNS(instance: StateInstance, nsname: string): NS {
+function createNS(
+  instance: StateInstance,
+  nsname: string,
+  controller = 0,
+): NS {
   return {
+    index: controller,
+    controller: (index: number) => {
+      const manager = controllers[index];
+      if (!manager) throw new Error(`No controller ${index}`);
+      return createNS(manager.getInstance(nsname), nsname, index);
+    },
     replay: {
       play: (name: string) => {
         return playRecording(name);
@@ -12,6 +42,9 @@ function createNS(instance: StateInstance, nsname: string): NS {
       stop: () => {
         return stopPlaying();
       },
+      benchmark: (name: string) => {
+        return benchmarkRecording(name);
+      },
     },
     gamepad: {
       setButton(buttons) {
@@ -58,6 +91,52 @@ function createNS(instance: StateInstance, nsname: string): NS {
         addLog(`[${nsname}] ${msg}`, "error");
       },
     },
+    master: {
+      status: () => masterStatus[controller],
+      profile: () => masterProfile[controller],
+      linkTest: (cfg = {}) => sendLinkTest(controller, cfg),
+      linkTestReport: () => masterLinkTest[controller],
+      onStatus: (listener) => {
+        const wrapped = (status: Parameters<typeof listener>[0]) => {
+          if (status.controller === controller) listener(status);
+        };
+        addMasterStatusListener(wrapped);
+        return () => removeMasterStatusListener(wrapped);
+      },
+    },
+    clock: {
+      now: () => hostMicros() / 1000,
+      synced: () => deviceClock.synced,
+      rttUs: () => deviceClock.rttUs,
+    },
+    scheduleFrame: (atMs, frame) => scheduleFrame(controller, atMs, frame),
+    time: () => timelineNow(),
+    at: (atMs, fn) => scheduleAt(nsname, atMs, fn),
+    waitFrames: (n) => scheduleFrames(nsname, controller, n),
+    frame: (fields) => instance.commit(fields),
+    gameFrame: {
+      set: (grid) => setGameFrame(grid),
+      get: () => getGameFrame(),
+      wait: (n = 1, leadMs) => scheduleGameFrame(nsname, controller, n, leadMs),
+    },
+    path: {
+      line: (stick, from, to, durationMs, opts) =>
+        pathLine(controller, stick, from, to, durationMs, opts),
+      arc: (stick, center, radius, fromTurns, sweepTurns, durationMs, opts) =>
+        pathArc(
+          controller,
+          stick,
+          center,
+          radius,
+          fromTurns,
+          sweepTurns,
+          durationMs,
+          opts,
+        ),
+      circle: (stick, radius, turnsPerSec, durationMs, opts) =>
+        pathCircle(controller, stick, radius, turnsPerSec, durationMs, opts),
+      clear: () => pathClear(controller),
+    },
     b(name, pressed) {
       instance.setButtonByName(name as any, pressed);
     },
@@ -125,6 +204,7 @@ async function fetchScriptList() {
         if (hasFrame) {
           // remove existing iframe
           scriptDiv.innerHTML = "";
+          cancelScheduled(scriptName);
           hasFrame = false;
           addLog(`Unloaded script: ${scriptSrc}`, "info");
           button.style.background = "#333";
@@ -59,12 +59,12 @@ waitForNS().then((ns) => {
       }
       ns.gamepad.setDpad(dpad);
 
-      // Read analog sticks
+      // Read analog sticks, fractions go out as 16 bit values
       if (activeGamepad.axes.length >= 4) {
-        ns.gamepad.setLeftX(Math.round((activeGamepad.axes[0] + 1) * 127.5));
-        ns.gamepad.setLeftY(Math.round((activeGamepad.axes[1] + 1) * 127.5));
-        ns.gamepad.setRightX(Math.round((activeGamepad.axes[2] + 1) * 127.5));
-        ns.gamepad.setRightY(Math.round((activeGamepad.axes[3] + 1) * 127.5));
+        ns.gamepad.setLeftX(128 + activeGamepad.axes[0] * 128);
+        ns.gamepad.setLeftY(128 + activeGamepad.axes[1] * 128);
+        ns.gamepad.setRightX(128 + activeGamepad.axes[2] * 128);
+        ns.gamepad.setRightY(128 + activeGamepad.axes[3] * 128);
       }
     } else {
       if (gamepadConnected) {
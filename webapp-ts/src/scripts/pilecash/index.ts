@@ -1,3 +1,8 @@
+import { FramePhase } from "../../framePhase";
+import { Vision } from "../../vision";
+
+let vision: Vision | null = null;
+
 // 1. select camera with navigator.mediaDevices.getUserMedia
 async function selectCamera(constraints: MediaStreamConstraints) {
   try {
@@ -48,45 +53,61 @@ async function setupCamera() {
     videoElement.style.width = "min(100%, 640px)";
   };
 
-  let colorPickTarget = { x: 0, y: 0 };
-  videoElement.addEventListener("pointermove", (event) => {
+  const toVideo = (event: PointerEvent) => {
     const rect = videoElement.getBoundingClientRect();
     const x = event.clientX - rect.left;
     const y = event.clientY - rect.top;
-    colorPickTarget = {
+    return {
       x: Math.floor((x / rect.width) * videoElement.videoWidth),
       y: Math.floor((y / rect.height) * videoElement.videoHeight),
     };
+  };
+
+  let colorPickTarget = { x: 0, y: 0 };
+  videoElement.addEventListener("pointermove", (event) => {
+    colorPickTarget = toVideo(event);
+    vision?.probe("cursor", { kind: "pixel", ...colorPickTarget });
   });
 
-  const colorPickInterval = async () => {
-    try {
-      const { r, g, b } = await getRGBAt(colorPickTarget.x, colorPickTarget.y);
-      descElem.textContent =
-        `X: ${colorPickTarget.x}, Y: ${colorPickTarget.y} - ` +
-        `RGB(${r}, ${g}, ${b})`;
-    } catch (e) {
-      console.error("Error getting RGB at point:", e);
-    } finally {
-      requestAnimationFrame(colorPickInterval);
-    }
-  };
-  colorPickInterval();
+  // reference capture: click the button, then drag over the banner text
+  let capturing = false;
+  let dragStart: { x: number; y: number } | null = null;
+  const captureBtn = document.getElementById("captureTemplate")!;
+  captureBtn.addEventListener("click", () => {
+    capturing = true;
+    descElem.textContent = "돈다발 글자 영역을 드래그하세요";
+  });
+  videoElement.addEventListener("pointerdown", (event) => {
+    if (!capturing) return;
+    dragStart = toVideo(event);
+    videoElement.setPointerCapture(event.pointerId);
+  });
+  videoElement.addEventListener("pointerup", (event) => {
+    if (!dragStart) return;
+    const end = toVideo(event);
+    const x = Math.min(dragStart.x, end.x);
+    const y = Math.min(dragStart.y, end.y);
+    const w = Math.abs(end.x - dragStart.x);
+    const h = Math.abs(end.y - dragStart.y);
+    dragStart = null;
+    if (w < 8 || h < 8) return;
+    capturing = false;
+    saveReference(videoElement, x, y, w, h);
+  });
 
   videoElement.srcObject = stream;
   await videoElement.play();
-}
 
-async function getRGBAt(x: number, y: number) {
-  const videoElement = document.querySelector("video") as HTMLVideoElement;
-  const canvas = document.createElement("canvas");
-  canvas.width = videoElement.videoWidth;
-  canvas.height = videoElement.videoHeight;
-  const context = canvas.getContext("2d");
-  if (!context) throw new Error("Failed to get canvas context");
-  context.drawImage(videoElement, 0, 0, canvas.width, canvas.height);
-  const pixelData = context.getImageData(x, y, 1, 1).data;
-  return { r: pixelData[0], g: pixelData[1], b: pixelData[2] };
+  // probes run in a worker on every camera frame
+  vision = new Vision(videoElement);
+  vision.onFrame((v) => {
+    const p = v.get("cursor");
+    if (!p) return;
+    descElem.textContent =
+      `X: ${p.x}, Y: ${p.y} - ` +
+      `RGB(${Math.round(p.r)}, ${Math.round(p.g)}, ${Math.round(p.b)})`;
+  });
+  vision.probe("cursor", { kind: "pixel", ...colorPickTarget });
 }
 
 async function waitForColor(
@@ -95,106 +116,110 @@ async function waitForColor(
   targetColor: { r: number; g: number; b: number },
   tolerance = 30,
 ) {
-  while (true) {
-    const { r, g, b } = await getRGBAt(x, y);
-    const distance = Math.sqrt(
-      (r - targetColor.r) ** 2 +
-      (g - targetColor.g) ** 2 +
-      (b - targetColor.b) ** 2,
-    );
-    console.log(
-      `Current color at (${x}, ${y}): rgb(${r}, ${g}, ${b}), distance: ${distance}`,
-    );
-    if (distance <= tolerance) {
-      break;
-    }
-    await new Promise((resolve) => setTimeout(resolve, 1000));
-  }
+  if (!vision) throw new Error("Camera not ready");
+  const { r, g, b } = await vision.waitForColor(x, y, targetColor, tolerance);
+  console.log(`Matched color at (${x}, ${y}): rgb(${r}, ${g}, ${b})`);
 }
 
-async function cameraToPngBase64() {
-  const videoElement = document.querySelector("video");
+// Reference crop of the "돈다발" banner, captured from the live feed.
+// The banner is searched for within SEARCH_MARGIN px of where it was captured.
+const TEMPLATE_KEY = "pilecashTemplate";
+const SEARCH_MARGIN = 16;
+// mean absolute difference per channel, 0..255
+const MATCH_SCORE = 24;
+const MATCH_TIMEOUT_MS = 1000;
+
+type StoredTemplate = { x: number; y: number; png: string };
+type Reference = { x: number; y: number; image: ImageData };
+
+let reference: Reference | null = null;
+
+function cropVideo(
+  video: HTMLVideoElement,
+  x: number,
+  y: number,
+  w: number,
+  h: number,
+) {
   const canvas = document.createElement("canvas");
-  const context = canvas.getContext("2d");
-  if (!videoElement) throw new Error("Video element not found");
+  canvas.width = w;
+  canvas.height = h;
+  const context = canvas.getContext("2d", { willReadFrequently: true });
   if (!context) throw new Error("Failed to get canvas context");
-  // Render only the bottom half of the video
-  // Render only 1/3 center part of the video
-  const sourceX = 739;
-  const sourceWidth = 500;
-  const sourceY = 780;
-  const sourceHeight = 200;
-  canvas.width = sourceWidth;
-  canvas.height = sourceHeight;
-  context.drawImage(
-    videoElement,
-    sourceX,
-    sourceY,
-    sourceWidth,
-    sourceHeight,
-    0,
-    0,
-    canvas.width,
-    canvas.height,
+  context.drawImage(video, x, y, w, h, 0, 0, w, h);
+  return { canvas, image: context.getImageData(0, 0, w, h) };
+}
+
+function showReference(png: string | null) {
+  const preview = document.getElementById("templatePreview");
+  if (!(preview instanceof HTMLImageElement)) return;
+  preview.hidden = !png;
+  if (png) preview.src = png;
+}
+
+async function loadReference() {
+  const stored: StoredTemplate | null = JSON.parse(
+    localStorage.getItem(TEMPLATE_KEY) || "null",
   );
-  return canvas.toDataURL("image/png");
+  if (!stored) return;
+  const img = new Image();
+  img.src = stored.png;
+  await img.decode();
+  const canvas = document.createElement("canvas");
+  canvas.width = img.width;
+  canvas.height = img.height;
+  const context = canvas.getContext("2d", { willReadFrequently: true })!;
+  context.drawImage(img, 0, 0);
+  reference = {
+    x: stored.x,
+    y: stored.y,
+    image: context.getImageData(0, 0, img.width, img.height),
+  };
+  showReference(stored.png);
 }
 
-let OPEN_AI_KEY = localStorage.getItem("OPEN_AI_KEY") || "";
-const keyInput = document.getElementById("openAiKey") as HTMLInputElement;
-keyInput.value = OPEN_AI_KEY;
-keyInput.addEventListener("change", () => {
-  OPEN_AI_KEY = keyInput.value;
-  localStorage.setItem("OPEN_AI_KEY", OPEN_AI_KEY);
-});
+function saveReference(
+  video: HTMLVideoElement,
+  x: number,
+  y: number,
+  w: number,
+  h: number,
+) {
+  const { canvas, image } = cropVideo(video, x, y, w, h);
+  const png = canvas.toDataURL("image/png");
+  const stored: StoredTemplate = { x, y, png };
+  localStorage.setItem(TEMPLATE_KEY, JSON.stringify(stored));
+  reference = { x, y, image };
+  showReference(png);
+}
 
-async function getHasCachPile(imageBase64: string): Promise<boolean> {
-  const response = await fetch("https://api.openai.com/v1/responses", {
-    method: "POST",
-    headers: {
-      "Content-Type": "application/json",
-      Authorization: `Bearer ${OPEN_AI_KEY}`,
-    },
-    body: JSON.stringify({
-      model: "gpt-4.1",
-      input: [
-        {
-          role: "system",
-          content: [
-            {
-              type: "input_text",
-              text: '주어진 이미지에 "돈다발" 이라는 글자가 있는지 답하시오.\n{"exists": true} 또는 {"exists": false} 형식의 JSON으로만 응답하시오.',
-            },
-          ],
-        },
-        {
-          role: "user",
-          content: [
-            {
-              type: "input_image",
-              image_url: imageBase64,
-            },
-          ],
-        },
-      ],
-      text: {
-        format: {
-          type: "json_object",
-        },
-      },
-      reasoning: {},
-      tools: [],
-      temperature: 1,
-      max_output_tokens: 2048,
-      top_p: 1,
-    }),
+// Template match against the reference on the next camera frames. Resolves
+// as soon as one frame matches, false after MATCH_TIMEOUT_MS without a match.
+async function hasCashPile() {
+  if (!vision) throw new Error("Camera not ready");
+  if (!reference) throw new Error("No reference captured");
+  const { x, y, image } = reference;
+  vision.probe("cashPile", {
+    kind: "template",
+    x: x - SEARCH_MARGIN,
+    y: y - SEARCH_MARGIN,
+    w: image.width + SEARCH_MARGIN * 2,
+    h: image.height + SEARCH_MARGIN * 2,
+    template: image,
   });
-  const data = await response.json();
   try {
-    return JSON.parse(data.output[0].content[0].text).exists;
-  } catch (e) {
-    console.error("Failed to parse response:", e);
+    const match = await vision.waitFor(
+      "cashPile",
+      (p) => p.score <= MATCH_SCORE,
+      MATCH_TIMEOUT_MS,
+    );
+    console.log(`Matched reference at (${match.x}, ${match.y})`, match.score);
+    return true;
+  } catch {
+    console.log("No match, best score", vision.get("cashPile")?.score);
     return false;
+  } finally {
+    vision.remove("cashPile");
   }
 }
 
@@ -214,6 +239,9 @@ rsBtn.addEventListener("click", () => {
     runStatus = "STOP_NEXT_LOOP";
     rsBtn.textContent = "실행 상태 (중지중)";
     rsBtn.style.backgroundColor = "#FFA500";
+  } else if (!reference) {
+    document.getElementById("result")!.textContent =
+      "돈다발 기준 이미지를 먼저 캡처하세요";
   } else {
     runStatus = "RUNNING";
     rsBtn.textContent = "실행 상태 (실행중)";
@@ -226,9 +254,15 @@ function setLog(text: string, tried: number) {
   logElem.textContent = `시도 횟수: ${tried}회 | ${text}`;
 }
 
+loadReference();
+
 setupCamera()
   .then(() => waitForNS())
   .then(async (ns) => {
+    // game frame grid for the timeline, from the middle of the screen
+    new FramePhase(vision!, { x: 928, y: 508, w: 64, h: 64 }, (grid) =>
+      ns.gameFrame.set(grid),
+    );
     let tried = 0;
     while (true) {
       if (runStatus === "STOPPED") {
@@ -241,22 +275,24 @@ setupCamera()
         continue;
       }
       setLog("창 나가기...", tried);
-      await ns.b("B", true);
-      await new Promise((resolve) => setTimeout(resolve, 100));
-      await ns.b("B", false);
+      ns.frame({ b: { B: true } });
+      // held across at least two game frames, released right before the
+      // next one samples input
+      await ns.gameFrame.wait(3);
+      ns.frame({ b: { B: false } });
       await new Promise((resolve) => setTimeout(resolve, 100));
 
       setLog("타임슬립중...", tried);
       await ns.replay.play("timesleepnday");
       let repeatA = true;
       (async () => {
+        // A and B in one frame, on the shared timeline
+        let t = ns.time();
         while (repeatA) {
-          await ns.b("A", true);
-          await ns.b("B", true);
-          await new Promise((resolve) => setTimeout(resolve, 100));
-          await ns.b("A", false);
-          await ns.b("B", false);
-          await new Promise((resolve) => setTimeout(resolve, 100));
+          ns.frame({ b: { A: true, B: true } });
+          t = await ns.at(t + 100);
+          ns.frame({ b: { A: false, B: false } });
+          t = await ns.at(t + 100);
         }
       })();
       setLog("맵 로딩 대기중...", tried);
@@ -280,10 +316,8 @@ setupCamera()
         g: 255,
         b: 226,
       });
-      // to png base64 url
-      setLog("OCR 확인중...", tried);
-      const imageBase64 = await cameraToPngBase64();
-      const hasCash = await getHasCachPile(imageBase64);
+      setLog("돈다발 확인중...", tried);
+      const hasCash = await hasCashPile();
 
       tried += 1;
       document.getElementById("stats")!.textContent = `시도 횟수: ${tried}회`;
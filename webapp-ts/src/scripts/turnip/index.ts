@@ -1,3 +1,7 @@
+import { Vision } from "../../vision";
+
+let vision: Vision | null = null;
+
 // 1. select camera with navigator.mediaDevices.getUserMedia
 async function selectCamera(constraints: MediaStreamConstraints) {
   try {
@@ -57,36 +61,22 @@ async function setupCamera() {
       x: Math.floor((x / rect.width) * videoElement.videoWidth),
       y: Math.floor((y / rect.height) * videoElement.videoHeight),
     };
+    vision?.probe("cursor", { kind: "pixel", ...colorPickTarget });
   });
 
-  const colorPickInterval = async () => {
-    try {
-      const { r, g, b } = await getRGBAt(colorPickTarget.x, colorPickTarget.y);
-      descElem.textContent =
-        `X: ${colorPickTarget.x}, Y: ${colorPickTarget.y} - ` +
-        `RGB(${r}, ${g}, ${b})`;
-    } catch (e) {
-      console.error("Error getting RGB at point:", e);
-    } finally {
-      requestAnimationFrame(colorPickInterval);
-    }
-  };
-  colorPickInterval();
-
   videoElement.srcObject = stream;
   await videoElement.play();
-}
 
-async function getRGBAt(x: number, y: number) {
-  const videoElement = document.querySelector("video") as HTMLVideoElement;
-  const canvas = document.createElement("canvas");
-  canvas.width = videoElement.videoWidth;
-  canvas.height = videoElement.videoHeight;
-  const context = canvas.getContext("2d");
-  if (!context) throw new Error("Failed to get canvas context");
-  context.drawImage(videoElement, 0, 0, canvas.width, canvas.height);
-  const pixelData = context.getImageData(x, y, 1, 1).data;
-  return { r: pixelData[0], g: pixelData[1], b: pixelData[2] };
+  // probes run in a worker on every camera frame
+  vision = new Vision(videoElement);
+  vision.onFrame((v) => {
+    const p = v.get("cursor");
+    if (!p) return;
+    descElem.textContent =
+      `X: ${p.x}, Y: ${p.y} - ` +
+      `RGB(${Math.round(p.r)}, ${Math.round(p.g)}, ${Math.round(p.b)})`;
+  });
+  vision.probe("cursor", { kind: "pixel", ...colorPickTarget });
 }
 
 async function waitForColor(
@@ -95,21 +85,9 @@ async function waitForColor(
   targetColor: { r: number; g: number; b: number },
   tolerance = 30,
 ) {
-  while (true) {
-    const { r, g, b } = await getRGBAt(x, y);
-    const distance = Math.sqrt(
-      (r - targetColor.r) ** 2 +
-        (g - targetColor.g) ** 2 +
-        (b - targetColor.b) ** 2,
-    );
-    console.log(
-      `Current color at (${x}, ${y}): rgb(${r}, ${g}, ${b}), distance: ${distance}`,
-    );
-    if (distance <= tolerance) {
-      break;
-    }
-    await new Promise((resolve) => setTimeout(resolve, 1000));
-  }
+  if (!vision) throw new Error("Camera not ready");
+  const { r, g, b } = await vision.waitForColor(x, y, targetColor, tolerance);
+  console.log(`Matched color at (${x}, ${y}): rgb(${r}, ${g}, ${b})`);
 }
 
 async function cameraToPngBase64() {
@@ -0,0 +1,146 @@
+import { deviceClock } from "./clock";
+import { addSerialLog } from "./log";
+import {
+  encodeFrameAt,
+  encodeLinkTest,
+  encodePath,
+  FRAME16_LEN,
+  MAX_CONTROLLERS,
+  NEUTRAL_FRAME,
+  type LinkTestConfig,
+  type PathSegment,
+} from "./protocol";
+import { SHARED_FRAME_BYTES, SharedFrame } from "./sharedFrame";
+import type { SenderMessage, SenderRequest } from "./sender.worker";
+
+const worker = new Worker(new URL("./sender.worker.ts", import.meta.url), {
+  type: "module",
+});
+
+// SharedArrayBuffer needs a cross-origin isolated page (see vite.config.ts)
+const state = new SharedFrame(
+  self.crossOriginIsolated
+    ? new SharedArrayBuffer(SHARED_FRAME_BYTES)
+    : new ArrayBuffer(SHARED_FRAME_BYTES),
+);
+state.publish(NEUTRAL_FRAME);
+
+let opened = false;
+let closeResolve: (() => void) | null = null;
+
+// a quick burst after connecting, then a slow refresh to follow drift
+const SYNC_BURST = 8;
+const SYNC_BURST_MS = 50;
+const SYNC_INTERVAL_MS = 500;
+let syncTimer: number | undefined;
+
+function request(msg: SenderRequest, transfer: Transferable[] = []) {
+  worker.postMessage(msg, transfer);
+}
+
+worker.onmessage = (e: MessageEvent<SenderMessage>) => {
+  const msg = e.data;
+  if (msg.kind === "error") {
+    addSerialLog(`Write error: ${msg.message}`, "error");
+  } else if (msg.kind === "closed") {
+    closeResolve?.();
+    closeResolve = null;
+  }
+};
+
+// Hands the port's writable stream to the worker. The current frames are
+// sent as soon as it is open.
+export function openSender(writable: WritableStream<Uint8Array>) {
+  const frames = Array.from({ length: MAX_CONTROLLERS }, (_, controller) => {
+    const frame = new Uint8Array(FRAME16_LEN);
+    // only this thread writes, never torn
+    return state.read(frame, controller) > 0 ? frame : null;
+  });
+  request(
+    {
+      kind: "open",
+      writable,
+      shared: state.shared ? (state.buffer as SharedArrayBuffer) : null,
+      frames,
+    },
+    [writable],
+  );
+  opened = true;
+}
+
+// Flushes pending writes and releases the stream, the port can be closed
+// once this resolves.
+export function closeSender(): Promise<void> {
+  if (!opened) return Promise.resolve();
+  opened = false;
+  clearTimeout(syncTimer);
+  return new Promise((resolve) => {
+    closeResolve = resolve;
+    request({ kind: "close" });
+  });
+}
+
+// Latest frame (FRAME16_LEN bytes) of a controller. Older frames of the same
+// controller that were not written yet are dropped.
+export function publishFrame(frame: ArrayLike<number>, controller = 0) {
+  state.publish(frame, controller);
+  if (opened && !state.shared) {
+    request({ kind: "frame", controller, frame: Uint8Array.from(frame) });
+  }
+}
+
+// Already encoded frames (telemetry config, host state), sent in order
+// ahead of the next controller frame.
+export function sendControl(bytes: Uint8Array) {
+  if (!opened) return false;
+  request({ kind: "control", bytes });
+  return true;
+}
+
+// Starts the clock sync exchange, replies feed deviceClock (telemetry.ts).
+export function startClockSync() {
+  deviceClock.reset();
+  clearTimeout(syncTimer);
+  let burst = SYNC_BURST;
+  const tick = () => {
+    if (!opened) return;
+    request({ kind: "sync" });
+    syncTimer = window.setTimeout(
+      tick,
+      --burst > 0 ? SYNC_BURST_MS : SYNC_INTERVAL_MS,
+    );
+  };
+  tick();
+}
+
+// Queues frame for controller, applied by the master at host time atMs
+// (epoch ms, see hostMicros). False until the clock is synced.
+export function scheduleFrame(
+  controller: number,
+  atMs: number,
+  frame: ArrayLike<number>,
+) {
+  if (!opened || !deviceClock.synced) return false;
+  const atUs = deviceClock.toDevice(atMs * 1000);
+  return sendControl(encodeFrameAt(controller, atUs, frame));
+}
+
+// Queues a stick path segment for controller. atMs (host time, epoch ms)
+// starts it at that time, otherwise it follows the stick's previous segment;
+// only the former needs the clock.
+export function sendPath(
+  controller: number,
+  seg: Omit<PathSegment, "atUs">,
+  atMs?: number,
+) {
+  if (!opened) return false;
+  if (atMs !== undefined && !deviceClock.synced) return false;
+  const atUs = atMs === undefined ? null : deviceClock.toDevice(atMs * 1000);
+  return sendControl(encodePath(controller, { ...seg, atUs }));
+}
+
+// Configures controller's link test (HARUNA_LINK_TEST master), taken up at
+// the start of its next one second window.
+export function sendLinkTest(controller: number, cfg: LinkTestConfig) {
+  return sendControl(encodeLinkTest(controller, cfg));
+}
@@ -0,0 +1,165 @@
+// Serial writer off the main thread.
+// Input:  SenderRequest. The writable side of the port is transferred in
+//         "open", controller state is read from a SharedFrame.
+// Output: SenderMessage.
+// A frame is only encoded once the stream is ready for more data; everything
+// published while a write is pending collapses into the newest frame of each
+// controller.
+import { hostMicros } from "./clock";
+import {
+  encodeControllerFrame,
+  encodeSync,
+  FRAME16_LEN,
+  MAX_CONTROLLERS,
+} from "./protocol";
+import { SHARED_FRAME_BYTES, SharedFrame } from "./sharedFrame";
+
+export type SenderRequest =
+  | {
+      kind: "open";
+      writable: WritableStream<Uint8Array>;
+      // null when the page is not cross-origin isolated, frames then arrive
+      // as "frame" messages
+      shared: SharedArrayBuffer | null;
+      // current frame per controller, null if never published
+      frames: (Uint8Array | null)[];
+    }
+  | { kind: "frame"; controller: number; frame: Uint8Array }
+  | { kind: "control"; bytes: Uint8Array } // encoded config / host state
+  // clock sync request, stamped when it is actually written
+  | { kind: "sync" }
+  | { kind: "close" };
+
+export type SenderMessage =
+  | { kind: "error"; message: string }
+  | { kind: "closed" };
+
+// upper bound for one idle wait, the loop also wakes on messages
+const IDLE_TIMEOUT_MS = 100;
+
+let writer: WritableStreamDefaultWriter<Uint8Array> | null = null;
+let state = new SharedFrame(new ArrayBuffer(SHARED_FRAME_BYTES));
+let controls: (Uint8Array | "sync")[] = [];
+const sentSeq = new Array<number>(MAX_CONTROLLERS).fill(-1);
+// next controller to check, so a busy one cannot starve the others
+let nextController = 0;
+let wakeUp: (() => void) | null = null;
+
+function post(msg: SenderMessage) {
+  self.postMessage(msg);
+}
+
+function wake() {
+  const resolve = wakeUp;
+  wakeUp = null;
+  resolve?.();
+}
+
+function idle(generation: number) {
+  return new Promise<void>((resolve) => {
+    wakeUp = resolve;
+    if (state.shared) {
+      state.changed(generation, IDLE_TIMEOUT_MS).then(() => wake());
+    }
+  });
+}
+
+// Encodes the first controller frame that was not sent yet.
+function nextFrame(frame: Uint8Array) {
+  for (let i = 0; i < MAX_CONTROLLERS; i++) {
+    const controller = (nextController + i) % MAX_CONTROLLERS;
+    const seq = state.read(frame, controller);
+    if (seq <= 0 || seq === sentSeq[controller]) continue;
+    sentSeq[controller] = seq;
+    nextController = (controller + 1) % MAX_CONTROLLERS;
+    return encodeControllerFrame(controller, frame);
+  }
+  return null;
+}
+
+function write(
+  w: WritableStreamDefaultWriter<Uint8Array>,
+  bytes: Uint8Array,
+) {
+  w.write(bytes).catch((error) =>
+    post({ kind: "error", message: error.message }),
+  );
+}
+
+async function pump(w: WritableStreamDefaultWriter<Uint8Array>) {
+  const frame = new Uint8Array(FRAME16_LEN);
+  while (writer === w) {
+    // backpressure: nothing is encoded until the port takes more data
+    try {
+      await w.ready;
+    } catch {
+      break;
+    }
+    if (writer !== w) break;
+
+    const control = controls.shift();
+    if (control) {
+      write(w, control === "sync" ? encodeSync(hostMicros()) : control);
+      continue;
+    }
+
+    const generation = state.generation();
+    const bytes = nextFrame(frame);
+    if (bytes) {
+      write(w, bytes);
+      continue;
+    }
+    await idle(generation);
+  }
+}
+
+async function close() {
+  const w = writer;
+  writer = null;
+  controls = [];
+  wake();
+  if (w) {
+    try {
+      await w.close();
+    } catch (error: any) {
+      post({ kind: "error", message: error.message });
+    }
+  }
+  post({ kind: "closed" });
+}
+
+self.onmessage = (e: MessageEvent<SenderRequest>) => {
+  const msg = e.data;
+  switch (msg.kind) {
+    case "open":
+      state = new SharedFrame(
+        msg.shared ?? new ArrayBuffer(SHARED_FRAME_BYTES),
+      );
+      if (!msg.shared) {
+        msg.frames.forEach((f, controller) => {
+          if (f) state.publish(f, controller);
+        });
+      }
+      sentSeq.fill(-1); // send the current state right away
+      writer = msg.writable.getWriter();
+      pump(writer);
+      break;
+    case "frame":
+      state.publish(msg.frame, msg.controller);
+      wake();
+      break;
+    case "control":
+      if (!writer) break;
+      controls.push(msg.bytes);
+      wake();
+      break;
+    case "sync":
+      if (!writer) break;
+      controls.push("sync");
+      wake();
+      break;
+    case "close":
+      close();
+      break;
+  }
+};
@@ -1,6 +1,22 @@
 import { addSerialLog } from "./log";
+import {
+  encodeFrame,
+  encodeTelemetryConfig,
+  H_HOST_STATE,
+  HS_MACRO_RUNNING,
+  MAX_CONTROLLERS,
+  NEUTRAL_FRAME,
+} from "./protocol";
 import { recordData } from "./recording";
-import { stateManager } from "./state";
+import {
+  closeSender,
+  openSender,
+  publishFrame,
+  sendControl,
+  startClockSync,
+} from "./sender";
+import { controllers, HID_TO_DPAD } from "./state";
+import { feedTelemetry } from "./telemetry";
 import {
   updateButtonDisplay,
   updateDpadDisplay,
@@ -8,7 +24,6 @@ import {
 } from "./visual";
 
 export let port: SerialPort | null = null;
-export let writer: WritableStreamDefaultWriter<Uint8Array> | null = null;
 export let reader: ReadableStreamDefaultReader<Uint8Array> | null = null;
 
 const connectBtn = document.getElementById("connectBtn")! as HTMLButtonElement;
@@ -17,10 +32,39 @@ const disconnectBtn = document.getElementById(
 )! as HTMLButtonElement;
 const serialStatus = document.getElementById("serialStatus")! as HTMLDivElement;
 const serialText = document.getElementById("serialText")! as HTMLDivElement;
-if (!connectBtn || !disconnectBtn || !serialStatus || !serialText) {
+const telemetryRate = document.getElementById(
+  "telemetryRate",
+)! as HTMLSelectElement;
+if (
+  !connectBtn ||
+  !disconnectBtn ||
+  !serialStatus ||
+  !serialText ||
+  !telemetryRate
+) {
   throw new Error("Missing required DOM elements");
 }
 
+function sendTelemetryConfig() {
+  sendControl(encodeTelemetryConfig(parseInt(telemetryRate.value)));
+}
+telemetryRate.addEventListener("change", sendTelemetryConfig);
+
+// shown on the board status LEDs
+let hostState = 0;
+function sendHostState() {
+  sendControl(encodeFrame(H_HOST_STATE, [hostState]));
+}
+
+export function setMacroRunning(running: boolean) {
+  const next = running
+    ? hostState | HS_MACRO_RUNNING
+    : hostState & ~HS_MACRO_RUNNING;
+  if (next === hostState) return;
+  hostState = next;
+  sendHostState();
+}
+
 // Serial connection
 connectBtn.addEventListener("click", async () => {
   try {
@@ -31,10 +75,11 @@ connectBtn.addEventListener("click", async () => {
     }
 
     await port.open({ baudRate: 115200 });
-    writer = port.writable.getWriter();
+    // frames are encoded and written by the sender worker
+    openSender(port.writable);
     reader = port.readable.getReader();
 
-    // log incomming data if exists
+    // telemetry and text logs are decoded in a worker
     (async () => {
       while (true) {
         const { value, done } = await reader.read();
@@ -42,13 +87,12 @@ connectBtn.addEventListener("click", async () => {
           addSerialLog("Serial port closed", "info");
           break;
         }
-        if (value) {
-          const textDecoder = new TextDecoder();
-          const receivedText = textDecoder.decode(value);
-          addSerialLog(`Received: ${receivedText}`, "info");
-        }
+        if (value) feedTelemetry(value);
       }
     })();
+    sendTelemetryConfig();
+    sendHostState();
+    startClockSync();
 
     connectBtn.disabled = true;
     disconnectBtn.disabled = false;
@@ -62,10 +106,7 @@ connectBtn.addEventListener("click", async () => {
 
 disconnectBtn.addEventListener("click", async () => {
   try {
-    if (writer) {
-      await writer.close();
-      writer = null;
-    }
+    await closeSender();
     if (port) {
       await port.close();
       port = null;
@@ -81,74 +122,48 @@ disconnectBtn.addEventListener("click", async () => {
   }
 });
 
-let sentData = new Uint8Array([
-  0x55, 0xaa, 0, 0, 0x0f, 128, 128, 128, 128, 0x0d, 0x0a,
-]);
-async function hidInterval() {
-  if (writer) {
-    const conData = stateManager.getGamepadStatus();
-    const buttonBinary = stateManager.buttonStatus2Binary(conData.buttons);
-
-    const dpadVal = conData.dpad.value;
-    let sendDpad = 0x0f;
-
-    if (dpadVal === 8)
-      sendDpad = 0; // Up
-    else if (dpadVal === 10)
-      sendDpad = 1; // Up-Right
-    else if (dpadVal === 4)
-      sendDpad = 2; // Right
-    else if (dpadVal === 6)
-      sendDpad = 3; // Down-Right
-    else if (dpadVal === 2)
-      sendDpad = 4; // Down
-    else if (dpadVal === 3)
-      sendDpad = 5; // Down-Left
-    else if (dpadVal === 1)
-      sendDpad = 6; // Left
-    else if (dpadVal === 9) sendDpad = 7; // Up-Left
-
-    const data = [
-      0x55,
-      0xaa,
-      buttonBinary & 0xff,
-      (buttonBinary >> 8) & 0xff,
-      sendDpad,
-      conData.leftX.value,
-      conData.leftY.value,
-      conData.rightX.value,
-      conData.rightY.value,
-      0x0d,
-      0x0a,
-    ];
-
-    const uint8Data = new Uint8Array(data);
-    if (!uint8Data.every((value, index) => value === sentData[index])) {
-      sentData = uint8Data;
-      try {
-        recordData([
-          buttonBinary & 0xff,
-          (buttonBinary >> 8) & 0xff,
-          sendDpad,
-          conData.leftX.value,
-          conData.leftY.value,
-          conData.rightX.value,
-          conData.rightY.value,
-        ]);
-        await writer.write(uint8Data);
-        updateButtonDisplay(buttonBinary);
-        updateDpadDisplay(dpadVal);
-        updateStickDisplay(
-          conData.leftX.value,
-          conData.leftY.value,
-          conData.rightX.value,
-          conData.rightY.value,
-        );
-        // addSerialLog(`Sent: ${Array.from(uint8Data).map(b => b.toString(16).padStart(2, '0')).join(' ')}`, "info");
-      } catch (error: any) {
-        addSerialLog(`Write error: ${error.message}`, "error");
-      }
+const sentFrames = Array.from(
+  { length: MAX_CONTROLLERS },
+  () => new Uint8Array(NEUTRAL_FRAME),
+);
+let changed = 0; // bit per controller
+let drawQueued = false;
+
+// Runs once per batch of state changes (microtask), the sender worker picks
+// the frames up from shared memory.
+function flushState() {
+  const pending = changed;
+  changed = 0;
+  for (const manager of controllers) {
+    const c = manager.controller;
+    if (!(pending & (1 << c))) continue;
+    const frame = manager.getFrame();
+    const sent = sentFrames[c];
+    if (frame.every((value, index) => value === sent[index])) continue;
+    sent.set(frame);
+    publishFrame(frame, c);
+    if (c !== 0) continue;
+
+    // recordings and the on-page controller follow controller 0
+    recordData(frame);
+    if (!drawQueued) {
+      drawQueued = true;
+      requestAnimationFrame(drawState);
     }
   }
 }
-setInterval(hidInterval, 10);
+
+function drawState() {
+  drawQueued = false;
+  const frame = sentFrames[0];
+  updateButtonDisplay(frame[0] | (frame[1] << 8));
+  updateDpadDisplay(HID_TO_DPAD[frame[2] & 0x0f]);
+  updateStickDisplay(frame[3], frame[4], frame[5], frame[6]);
+}
+
+for (const manager of controllers) {
+  manager.addChangeListener(() => {
+    if (!changed) queueMicrotask(flushState);
+    changed |= 1 << manager.controller;
+  });
+}
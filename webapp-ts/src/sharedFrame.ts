@@ -0,0 +1,72 @@
+// Latest frame of every controller, written by the main thread and read by
+// the sender worker. Layout: Int32 change counter, one Int32 sequence per
+// controller, then FRAME16_LEN bytes per controller. A sequence is odd while
+// that frame is being written (seqlock), so readers never see a torn frame;
+// the change counter bumps after every publish so one wait covers all
+// controllers.
+//
+// Backed by a SharedArrayBuffer when the page is cross-origin isolated,
+// otherwise by a plain ArrayBuffer on each side and kept in sync with
+// postMessage (see sender.ts).
+import { FRAME16_LEN, MAX_CONTROLLERS } from "./protocol";
+
+const FRAME_STRIDE = (FRAME16_LEN + 3) & ~3;
+
+export const SHARED_FRAME_BYTES =
+  4 * (1 + MAX_CONTROLLERS) + FRAME_STRIDE * MAX_CONTROLLERS;
+
+export class SharedFrame {
+  readonly buffer: ArrayBufferLike;
+  readonly shared: boolean;
+  private words: Int32Array;
+  private bytes: Uint8Array;
+
+  constructor(buffer: ArrayBufferLike) {
+    this.buffer = buffer;
+    this.shared =
+      typeof SharedArrayBuffer !== "undefined" &&
+      buffer instanceof SharedArrayBuffer;
+    this.words = new Int32Array(buffer, 0, 1 + MAX_CONTROLLERS);
+    this.bytes = new Uint8Array(
+      buffer,
+      4 * (1 + MAX_CONTROLLERS),
+      FRAME_STRIDE * MAX_CONTROLLERS,
+    );
+  }
+
+  publish(frame: ArrayLike<number>, controller = 0) {
+    const slot = 1 + controller;
+    const seq = Atomics.load(this.words, slot);
+    Atomics.store(this.words, slot, seq + 1);
+    this.bytes.set(frame, controller * FRAME_STRIDE);
+    Atomics.store(this.words, slot, seq + 2);
+    Atomics.add(this.words, 0, 1);
+    if (this.shared) Atomics.notify(this.words, 0);
+  }
+
+  // Copies the frame of controller into out, returns its sequence: 0 if it
+  // was never published, -1 if a write was in progress.
+  read(out: Uint8Array, controller = 0) {
+    const slot = 1 + controller;
+    const seq = Atomics.load(this.words, slot);
+    if (seq & 1) return -1;
+    const start = controller * FRAME_STRIDE;
+    out.set(this.bytes.subarray(start, start + FRAME16_LEN));
+    return Atomics.load(this.words, slot) === seq ? seq : -1;
+  }
+
+  // Change counter, read it before scanning the controllers.
+  generation() {
+    return Atomics.load(this.words, 0);
+  }
+
+  // Resolves once the change counter moves away from generation or after
+  // timeoutMs (shared buffers only).
+  changed(generation: number, timeoutMs: number): Promise<unknown> {
+    if (typeof Atomics.waitAsync !== "function") {
+      return new Promise((resolve) => setTimeout(resolve, 1));
+    }
+    const result = Atomics.waitAsync(this.words, 0, generation, timeoutMs);
+    return result.async ? result.value : Promise.resolve();
+  }
+}
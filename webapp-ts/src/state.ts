@@ -1,3 +1,10 @@
+import {
+  FRAME16_LEN,
+  FRAME_LEN,
+  MAX_CONTROLLERS,
+  NEUTRAL_FRAME,
+} from "./protocol";
+
 const buttonMap = {
   Y: 0,
   B: 1,
@@ -15,55 +22,108 @@ const buttonMap = {
   CAPTURE: 13,
 };
 
-export class TimingValue<T = number> {
-  value: T;
-  lastUpdate: number;
+export type ButtonName = keyof typeof buttonMap;
 
-  constructor(value: T) {
-    this.value = value;
-    this.lastUpdate = 0;
-  }
-  setValue(newValue: T) {
-    if (this.value !== newValue) {
-      this.value = newValue;
-      this.lastUpdate = Date.now();
-    }
-  }
+// Fields for StateInstance.commit, the ones left out keep their value.
+export type FrameFields = {
+  // whole button field (setButton)
+  buttons?: number;
+  // single buttons by name
+  b?: Partial<Record<ButtonName, boolean>>;
+  // up/right/down/left bitmask (setDpad)
+  dpad?: number;
+  l?: readonly [number, number];
+  r?: readonly [number, number];
+};
+
+// Packed state: one value per lane, lanes 0..13 are the buttons (buttonMap
+// bit), then the dpad (up/right/down/left bitmask) and the four axes, which
+// are 16 bit (boardlink_axis16 scale, 32768 = centered).
+const BUTTON_LANES = 14;
+const LANE_DPAD = 14;
+const LANE_LX = 15;
+const LANE_LY = 16;
+const LANE_RX = 17;
+const LANE_RY = 18;
+const LANES = 19;
+const ALL_LANES = (1 << LANES) - 1;
+
+const LANE_DEFAULTS = new Uint16Array(LANES);
+LANE_DEFAULTS.fill(32768, LANE_LX);
+
+// Axis setters take the usual 0..255 stick value, fractions keep the extra
+// resolution. Whole numbers have no low byte, so 8 bit callers still send
+// plain frames.
+function axis16(value: number) {
+  return Math.min(65535, Math.max(0, Math.round(value * 256)));
 }
 
+// up/right/down/left bitmask -> hid hat value (0x0f = released)
+export const DPAD_TO_HID = new Uint8Array(16).fill(0x0f);
+DPAD_TO_HID[0b1000] = 0; // Up
+DPAD_TO_HID[0b1100] = 1; // Up-Right
+DPAD_TO_HID[0b0100] = 2; // Right
+DPAD_TO_HID[0b0110] = 3; // Down-Right
+DPAD_TO_HID[0b0010] = 4; // Down
+DPAD_TO_HID[0b0011] = 5; // Down-Left
+DPAD_TO_HID[0b0001] = 6; // Left
+DPAD_TO_HID[0b1001] = 7; // Up-Left
+
+// hid hat value -> up/right/down/left bitmask
+export const HID_TO_DPAD = new Uint8Array(16);
+DPAD_TO_HID.forEach((hid, dpad) => {
+  if (hid !== 0x0f) HID_TO_DPAD[hid] = dpad;
+});
+
+// Write order across all instances. Latest writer wins per lane.
+let clock = 0;
+
 export class StateInstance {
-  buttons: { [key in keyof typeof buttonMap]: TimingValue<boolean> };
-  dpad: TimingValue<number>;
-  leftX: TimingValue<number>;
-  leftY: TimingValue<number>;
-  rightX: TimingValue<number>;
-  rightY: TimingValue<number>;
-
-  constructor() {
-    this.buttons = {} as {
-      [key in keyof typeof buttonMap]: TimingValue<boolean>;
-    };
-    for (const key in buttonMap) {
-      this.buttons[key as keyof typeof buttonMap] = new TimingValue<boolean>(
-        false,
-      );
+  readonly values = new Uint16Array(LANE_DEFAULTS);
+  // clock of the last change per lane, 0 = never written
+  readonly stamps = new Float64Array(LANES);
+  // lanes changed since the last merge
+  dirty = 0;
+  private manager: StateManager;
+  private batching = false;
+
+  constructor(manager: StateManager) {
+    this.manager = manager;
+  }
+
+  private set(lane: number, value: number) {
+    if (this.values[lane] === value) return;
+    this.values[lane] = value;
+    this.stamps[lane] = ++clock;
+    this.dirty |= 1 << lane;
+    if (!this.batching) this.manager.markDirty();
+  }
+
+  // Several fields as one change, they always go out in the same frame.
+  commit(fields: FrameFields) {
+    const start = clock;
+    this.batching = true;
+    try {
+      if (fields.buttons !== undefined) this.setButton(fields.buttons);
+      for (const [name, pressed] of Object.entries(fields.b ?? {})) {
+        this.setButtonByName(name as ButtonName, !!pressed);
+      }
+      if (fields.dpad !== undefined) this.setDpad(fields.dpad);
+      if (fields.l) this.setLeftStick(fields.l[0], fields.l[1]);
+      if (fields.r) this.setRightStick(fields.r[0], fields.r[1]);
+    } finally {
+      this.batching = false;
     }
-    this.dpad = new TimingValue<number>(0);
-    this.leftX = new TimingValue<number>(128);
-    this.leftY = new TimingValue<number>(128);
-    this.rightX = new TimingValue<number>(128);
-    this.rightY = new TimingValue<number>(128);
+    if (clock !== start) this.manager.markDirty();
   }
 
   setButton(buttons: number) {
-    for (const key in buttonMap) {
-      const bit = buttonMap[key as keyof typeof buttonMap];
-      const isPressed = (buttons >> bit) & 1 ? true : false;
-      this.buttons[key as keyof typeof buttonMap].setValue(isPressed);
+    for (let lane = 0; lane < BUTTON_LANES; lane++) {
+      this.set(lane, (buttons >> lane) & 1);
     }
   }
-  setButtonByName(name: keyof typeof buttonMap, pressed: boolean) {
-    this.buttons[name].setValue(pressed);
+  setButtonByName(name: ButtonName, pressed: boolean) {
+    this.set(buttonMap[name], pressed ? 1 : 0);
   }
 
   setDpad(
@@ -73,7 +133,7 @@ export class StateInstance {
     right: boolean = false,
   ) {
     if (typeof dpad === "number") {
-      this.dpad.setValue(dpad);
+      this.set(LANE_DPAD, dpad & 0x0f);
       return;
     }
 
@@ -82,169 +142,154 @@ export class StateInstance {
     if (right) dpadValue |= 0b0100;
     if (down) dpadValue |= 0b0010;
     if (left) dpadValue |= 0b0001;
-    this.dpad.setValue(dpadValue);
+    this.set(LANE_DPAD, dpadValue);
   }
 
   setLeftX(value: number) {
-    this.leftX.setValue(value);
+    this.set(LANE_LX, axis16(value));
   }
   setLeftY(value: number) {
-    this.leftY.setValue(value);
+    this.set(LANE_LY, axis16(value));
   }
   setRightX(value: number) {
-    this.rightX.setValue(value);
+    this.set(LANE_RX, axis16(value));
   }
   setRightY(value: number) {
-    this.rightY.setValue(value);
+    this.set(LANE_RY, axis16(value));
   }
   setLeftStick(x: number, y: number) {
-    this.leftX.setValue(x);
-    this.leftY.setValue(y);
+    this.set(LANE_LX, axis16(x));
+    this.set(LANE_LY, axis16(y));
   }
   setRightStick(x: number, y: number) {
-    this.rightX.setValue(x);
-    this.rightY.setValue(y);
+    this.set(LANE_RX, axis16(x));
+    this.set(LANE_RY, axis16(y));
   }
   setSticks(leftX: number, leftY: number, rightX: number, rightY: number) {
-    this.leftX.setValue(leftX);
-    this.leftY.setValue(leftY);
-    this.rightX.setValue(rightX);
-    this.rightY.setValue(rightY);
+    this.set(LANE_LX, axis16(leftX));
+    this.set(LANE_LY, axis16(leftY));
+    this.set(LANE_RX, axis16(rightX));
+    this.set(LANE_RY, axis16(rightY));
   }
 }
 
-class StateManager {
+// Merged state of one controller (one master board / console).
+export class StateManager {
+  readonly controller: number;
   instances: Map<string, StateInstance>;
 
-  forceSet: Uint8Array | null = null;
+  // merged lanes and the clock they were written at
+  private merged = new Uint16Array(LANE_DEFAULTS);
+  private mergedStamps = new Float64Array(LANES);
+  private dirty = false;
+  private frame = new Uint8Array(NEUTRAL_FRAME);
+  private forced: Uint8Array | null = null;
+  private changeListeners: (() => void)[] = [];
 
-  constructor() {
+  constructor(controller: number) {
+    this.controller = controller;
     this.instances = new Map();
   }
 
+  // raw 7 (or FRAME16_LEN) byte frame that overrides every instance (replay)
+  get forceSet() {
+    return this.forced;
+  }
+  set forceSet(data: Uint8Array | null) {
+    this.forced = data;
+    this.dirty = true;
+    this.emitChange();
+  }
+
+  // Called whenever the frame may have changed, so the sender can publish
+  // without polling.
+  addChangeListener(listener: () => void) {
+    this.changeListeners.push(listener);
+  }
+
+  removeChangeListener(listener: () => void) {
+    this.changeListeners = this.changeListeners.filter((l) => l !== listener);
+  }
+
+  private emitChange() {
+    for (const listener of this.changeListeners) listener();
+  }
+
+  markDirty() {
+    this.dirty = true;
+    this.emitChange();
+  }
+
   getInstance(id: string): StateInstance {
     if (!this.instances.has(id)) {
-      this.instances.set(id, new StateInstance());
+      this.instances.set(id, new StateInstance(this));
     }
     return this.instances.get(id)!;
   }
 
   createInstance(id: string): StateInstance {
-    const instance = new StateInstance();
+    const instance = new StateInstance(this);
     this.instances.set(id, instance);
     return instance;
   }
 
   deleteInstance(id: string): void {
-    this.instances.delete(id);
+    if (!this.instances.delete(id)) return;
+    // lanes owned by the removed instance fall back to older writers
+    this.merged.set(LANE_DEFAULTS);
+    this.mergedStamps.fill(0);
+    for (const instance of this.instances.values()) instance.dirty = ALL_LANES;
+    this.markDirty();
   }
 
-  buttonStatus2Binary(buttonStatus: {
-    [key in keyof typeof buttonMap]: TimingValue<boolean>;
-  }) {
-    let binary = 0;
-    for (const key in buttonMap) {
-      const bit = buttonMap[key as keyof typeof buttonMap];
-      if (buttonStatus[key as keyof typeof buttonMap].value) {
-        binary |= 1 << bit;
-      }
-    }
-    return binary;
-  }
-
-  getGamepadStatus() {
-    if (this.forceSet) {
-      const data = this.forceSet;
-      const buttons: { [key in keyof typeof buttonMap]: TimingValue<boolean> } =
-        {} as { [key in keyof typeof buttonMap]: TimingValue<boolean> };
-      const buttonVal = data[0] | (data[1] << 8);
-      for (const key in buttonMap) {
-        const bit = buttonMap[key as keyof typeof buttonMap];
-        const isPressed = (buttonVal >> bit) & 1 ? true : false;
-        buttons[key as keyof typeof buttonMap] = new TimingValue<boolean>(
-          isPressed,
-        );
-      }
-      let hiddpad2dpad = 0;
-      const dpadVal = data[2];
-      if (dpadVal === 0)
-        hiddpad2dpad = 8; // Up
-      else if (dpadVal === 1)
-        hiddpad2dpad = 10; // Up-Right
-      else if (dpadVal === 2) hiddpad2dpad = 4;
-      else if (dpadVal === 3)
-        hiddpad2dpad = 6; // Down-Right
-      else if (dpadVal === 4) hiddpad2dpad = 2;
-      else if (dpadVal === 5)
-        hiddpad2dpad = 3; // Down-Left
-      else if (dpadVal === 6) hiddpad2dpad = 1;
-      else if (dpadVal === 7) hiddpad2dpad = 9; // Up-Left
-      const dpad = new TimingValue<number>(hiddpad2dpad);
-      const leftX = new TimingValue<number>(data[3]);
-      const leftY = new TimingValue<number>(data[4]);
-      const rightX = new TimingValue<number>(data[5]);
-      const rightY = new TimingValue<number>(data[6]);
-      return {
-        buttons,
-        dpad,
-        leftX,
-        leftY,
-        rightX,
-        rightY,
-      };
-    }
-    const buttonStatus: {
-      [key in keyof typeof buttonMap]: TimingValue<boolean>;
-    } = {} as { [key in keyof typeof buttonMap]: TimingValue<boolean> };
-    let dpad: TimingValue<number> = new TimingValue<number>(0);
-    let leftX: TimingValue<number> = new TimingValue<number>(128);
-    let leftY: TimingValue<number> = new TimingValue<number>(128);
-    let rightX: TimingValue<number> = new TimingValue<number>(128);
-    let rightY: TimingValue<number> = new TimingValue<number>(128);
-    for (const key in buttonMap) {
-      buttonStatus[key as keyof typeof buttonMap] = new TimingValue<boolean>(
-        false,
-      );
-    }
-
+  private merge() {
     for (const instance of this.instances.values()) {
-      for (const key in buttonMap) {
-        // use newer value
-        if (
-          instance.buttons[key as keyof typeof buttonMap].lastUpdate >
-          buttonStatus[key as keyof typeof buttonMap].lastUpdate
-        ) {
-          buttonStatus[key as keyof typeof buttonMap] =
-            instance.buttons[key as keyof typeof buttonMap];
+      let lanes = instance.dirty;
+      if (!lanes) continue;
+      instance.dirty = 0;
+      for (let lane = 0; lanes; lane++, lanes >>>= 1) {
+        if (!(lanes & 1)) continue;
+        const stamp = instance.stamps[lane];
+        if (stamp > this.mergedStamps[lane]) {
+          this.mergedStamps[lane] = stamp;
+          this.merged[lane] = instance.values[lane];
         }
       }
+    }
+  }
 
-      if (instance.dpad.lastUpdate > dpad.lastUpdate) {
-        dpad = instance.dpad;
-      }
-      if (instance.leftX.lastUpdate > leftX.lastUpdate) {
-        leftX = instance.leftX;
-      }
-      if (instance.leftY.lastUpdate > leftY.lastUpdate) {
-        leftY = instance.leftY;
-      }
-      if (instance.rightX.lastUpdate > rightX.lastUpdate) {
-        rightX = instance.rightX;
-      }
-      if (instance.rightY.lastUpdate > rightY.lastUpdate) {
-        rightY = instance.rightY;
-      }
+  // Wire frame (Buttons0, Buttons1, DPAD, LX, LY, RX, RY) followed by the
+  // low bytes of LX, LY, RX, RY, FRAME16_LEN bytes. Only rebuilt after a
+  // change; the returned array is reused, copy it to keep it.
+  getFrame(): Uint8Array {
+    if (!this.dirty) return this.frame;
+    this.dirty = false;
+    this.merge();
+
+    if (this.forced) {
+      this.frame.fill(0, FRAME_LEN);
+      this.frame.set(this.forced.subarray(0, FRAME16_LEN));
+      return this.frame;
     }
 
-    return {
-      buttons: buttonStatus,
-      dpad,
-      leftX,
-      leftY,
-      rightX,
-      rightY,
-    };
+    const m = this.merged;
+    let buttons = 0;
+    for (let lane = 0; lane < BUTTON_LANES; lane++) buttons |= m[lane] << lane;
+    this.frame[0] = buttons & 0xff;
+    this.frame[1] = buttons >> 8;
+    this.frame[2] = DPAD_TO_HID[m[LANE_DPAD]];
+    for (let i = 0; i < 4; i++) {
+      this.frame[3 + i] = m[LANE_LX + i] >> 8;
+      this.frame[FRAME_LEN + i] = m[LANE_LX + i] & 0xff;
+    }
+    return this.frame;
   }
 }
 
-export const stateManager = new StateManager();
+export const controllers = Array.from(
+  { length: MAX_CONTROLLERS },
+  (_, controller) => new StateManager(controller),
+);
+
+// controller 0, the only one with a single master board
+export const stateManager = controllers[0];
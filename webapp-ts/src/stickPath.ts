@@ -0,0 +1,101 @@
+// Stick paths, interpolated by the master for every USB report (see the stick
+// path section of boardlink.h). A sweep or a rotation is a single frame on
+// the link instead of a value every host tick:
+//
+//   ns.path.line("left", [128, 128], [255, 128], 200, { ease: "out" });
+//   ns.path.circle("right", 127, 2, 3000); // 2 turns/s for 3 s
+//
+// Segments of a stick run back to back. Once the last one ends the stick
+// stays on its end point until the script moves it again, so finish where
+// the stick should rest.
+import { type Ease, PATH_ARC, PATH_CLEAR, PATH_LINE } from "./protocol";
+import { sendPath } from "./sender";
+
+export type Stick = "left" | "right";
+export type Point = readonly [number, number];
+export type PathOptions = {
+  ease?: Ease;
+  // host clock time (ms, see ns.clock) to start at instead of right after
+  // the stick's previous segment
+  atMs?: number;
+};
+
+const CENTER: Point = [128, 128];
+
+function stickIndex(stick: Stick) {
+  return stick === "right" ? 1 : 0;
+}
+
+export function pathLine(
+  controller: number,
+  stick: Stick,
+  from: Point,
+  to: Point,
+  durationMs: number,
+  opts: PathOptions = {},
+) {
+  const seg = {
+    stick: stickIndex(stick),
+    shape: PATH_LINE,
+    ease: opts.ease ?? "linear",
+    durationUs: durationMs * 1000,
+    a: from,
+    b: to,
+    angle0: 0,
+    sweep: 0,
+  };
+  return sendPath(controller, seg, opts.atMs);
+}
+
+// Ellipse around center, from fromTurns (0 = right, 0.25 = up) over
+// sweepTurns (negative = clockwise).
+export function pathArc(
+  controller: number,
+  stick: Stick,
+  center: Point,
+  radius: number | Point,
+  fromTurns: number,
+  sweepTurns: number,
+  durationMs: number,
+  opts: PathOptions = {},
+) {
+  const seg = {
+    stick: stickIndex(stick),
+    shape: PATH_ARC,
+    ease: opts.ease ?? "linear",
+    durationUs: durationMs * 1000,
+    a: center,
+    b: typeof radius === "number" ? ([radius, radius] as const) : radius,
+    angle0: fromTurns,
+    sweep: sweepTurns,
+  };
+  return sendPath(controller, seg, opts.atMs);
+}
+
+// Around the center at turnsPerSec, starting on the right.
+export function pathCircle(
+  controller: number,
+  stick: Stick,
+  radius: number,
+  turnsPerSec: number,
+  durationMs: number,
+  opts: PathOptions = {},
+) {
+  const turns = (turnsPerSec * durationMs) / 1000;
+  return pathArc(controller, stick, CENTER, radius, 0, turns, durationMs, opts);
+}
+
+// Drops every queued segment of both sticks, they stay where they are.
+export function pathClear(controller: number) {
+  const seg = {
+    stick: 0,
+    shape: PATH_CLEAR,
+    ease: "linear" as const,
+    durationUs: 0,
+    a: CENTER,
+    b: CENTER,
+    angle0: 0,
+    sweep: 0,
+  };
+  return sendPath(controller, seg);
+}
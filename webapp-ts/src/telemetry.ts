@@ -0,0 +1,295 @@
+import { deviceClock, hostMicros } from "./clock";
+import { addSerialLog } from "./log";
+import {
+  AGE_BUCKET0_US,
+  EVENT_NAMES,
+  LINK_TEST_MODES,
+  MAX_CONTROLLERS,
+  profileEdgeUs,
+  TF_USB_MOUNTED,
+  TF_USB_PAD,
+  USB_MOUNTED,
+  USB_SOF_LOCKED,
+  USB_SUSPENDED,
+  type Histogram,
+  type LinkTestReport,
+  type MasterProfile,
+  type MasterStatus,
+  type ReportTrace,
+} from "./protocol";
+import type { MasterRates, TelemetryMessage } from "./telemetry.worker";
+
+const worker = new Worker(new URL("./telemetry.worker.ts", import.meta.url), {
+  type: "module",
+});
+
+const telemetryView = document.getElementById("telemetry") as HTMLDivElement;
+
+let batchHtml = "";
+let syncHtml = "";
+const masterHtml: string[] = [];
+const profileHtml: string[] = [];
+const linkTestHtml: string[] = [];
+
+// latest status block per controller
+export const masterStatus: (MasterStatus | null)[] = new Array(
+  MAX_CONTROLLERS,
+).fill(null);
+
+// latest USB report profile per controller (one second each)
+export const masterProfile: (MasterProfile | null)[] = new Array(
+  MAX_CONTROLLERS,
+).fill(null);
+
+// latest link test window per controller (HARUNA_LINK_TEST masters)
+export const masterLinkTest: (LinkTestReport | null)[] = new Array(
+  MAX_CONTROLLERS,
+).fill(null);
+
+export type MasterStatusListener = (
+  status: MasterStatus,
+  rates: MasterRates | null,
+) => void;
+let masterStatusListeners: MasterStatusListener[] = [];
+
+export function addMasterStatusListener(listener: MasterStatusListener) {
+  masterStatusListeners.push(listener);
+}
+
+export function removeMasterStatusListener(listener: MasterStatusListener) {
+  masterStatusListeners = masterStatusListeners.filter((l) => l !== listener);
+}
+
+export type TraceListener = (trace: ReportTrace) => void;
+let traceListeners: TraceListener[] = [];
+
+// Report trace blocks (see encodeTrace), returns an unsubscribe function.
+export function addTraceListener(listener: TraceListener) {
+  traceListeners.push(listener);
+  return () => {
+    traceListeners = traceListeners.filter((l) => l !== listener);
+  };
+}
+
+export function feedTelemetry(chunk: Uint8Array) {
+  // stamped here, the worker may be busy when it gets to the chunk
+  const receivedUs = hostMicros();
+  // copy out of the reader's buffer so it can be transferred
+  const buf = chunk.slice().buffer;
+  worker.postMessage({ chunk: buf, receivedUs }, [buf]);
+}
+
+function row(label: string, value: string) {
+  return `<div class="telemetry-row"><span>${label}</span><span>${value}</span></div>`;
+}
+
+function hex(bytes: Uint8Array, len: number) {
+  return Array.from(bytes.subarray(0, Math.min(len, bytes.length)))
+    .map((b) => b.toString(16).padStart(2, "0"))
+    .join(" ");
+}
+
+function render() {
+  if (!telemetryView) return;
+  let html = batchHtml + syncHtml;
+  for (let c = 0; c < MAX_CONTROLLERS; c++) {
+    html +=
+      (masterHtml[c] ?? "") + (profileHtml[c] ?? "") + (linkTestHtml[c] ?? "");
+  }
+  telemetryView.innerHTML = html;
+}
+
+function aliveList(mask: number) {
+  const alive: number[] = [];
+  for (let c = 0; c < MAX_CONTROLLERS; c++) if (mask & (1 << c)) alive.push(c);
+  return alive.length ? alive.join(", ") : "none";
+}
+
+// "<125us 3, <250us 40, ..." for the non-empty buckets
+function ageHistogram(hist: Uint8Array) {
+  const parts: string[] = [];
+  hist.forEach((count, n) => {
+    if (!count) return;
+    const label =
+      n < hist.length - 1
+        ? `<${AGE_BUCKET0_US << n}us`
+        : `>=${AGE_BUCKET0_US << (n - 1)}us`;
+    parts.push(`${label} ${count}`);
+  });
+  return parts.length ? parts.join(", ") : "-";
+}
+
+// "min 990 / avg 1000 / max 1010 us | <1500us 998, <3000us 2"
+function histogram(h: Histogram) {
+  const parts: string[] = [];
+  h.count.forEach((count, n) => {
+    if (!count) return;
+    const label =
+      n < h.count.length - 1
+        ? `<${profileEdgeUs(n)}us`
+        : `>=${profileEdgeUs(n - 1)}us`;
+    parts.push(`${label} ${count}`);
+  });
+  const range = `min ${h.minUs} / avg ${h.avgUs} / max ${h.maxUs} us`;
+  return parts.length ? `${range} | ${parts.join(", ")}` : "-";
+}
+
+function bootMs(ms: number) {
+  return ms ? `${ms} ms` : "-";
+}
+
+function onBatch(msg: Extract<TelemetryMessage, { kind: "batch" }>) {
+  const { telemetry, rates, events, lines, crcErrors } = msg;
+
+  for (const line of lines) addSerialLog(`Received: ${line}`, "info");
+  for (const ev of events) {
+    const name = EVENT_NAMES[ev.code] ?? `event ${ev.code}`;
+    addSerialLog(
+      `[${(ev.tUs / 1000).toFixed(1)}ms] ${name} (${ev.arg})`,
+      [2, 3, 4, 7, 8].includes(ev.code) ? "error" : "info",
+    );
+  }
+
+  if (!telemetry) return;
+  batchHtml =
+    row("Master poll", rates ? `${rates.rdreq.toFixed(0)} /s` : "-") +
+    row("Host frames", rates ? `${rates.hostFrames.toFixed(1)} /s` : "-") +
+    row(
+      "Drops",
+      rates ? `${rates.drops.toFixed(1)} /s (${telemetry.drops})` : "-",
+    ) +
+    row(
+      "Parse errors",
+      rates ? `${rates.parseErr.toFixed(1)} /s (${telemetry.parseErr})` : "-",
+    ) +
+    row("Queue depth", `${telemetry.queueDepth}`) +
+    row(
+      "Slave worst case",
+      `isr ${telemetry.isrMaxUs} us, loop ${telemetry.loopMaxUs} us`,
+    ) +
+    row("USB", telemetry.flags & TF_USB_MOUNTED ? "mounted" : "-") +
+    row("USB pad", telemetry.flags & TF_USB_PAD ? "connected" : "-") +
+    row("Masters alive", aliveList(telemetry.mastersAlive)) +
+    row(
+      "Slave boot -> link / USB",
+      `${bootMs(telemetry.bootLinkMs)} / ${bootMs(telemetry.bootUsbMs)}`,
+    ) +
+    row("CRC errors (host)", `${crcErrors}`);
+  render();
+}
+
+function onMaster(msg: Extract<TelemetryMessage, { kind: "master" }>) {
+  const { status, rates } = msg;
+  const c = status.controller;
+  masterStatus[c] = status;
+  for (const listener of masterStatusListeners) listener(status, rates);
+
+  const usb =
+    status.usbState & USB_SUSPENDED
+      ? "suspended"
+      : status.usbState & USB_MOUNTED
+        ? "mounted"
+        : "not mounted";
+  const sof = status.usbState & USB_SOF_LOCKED ? ", SOF locked" : "";
+  masterHtml[c] =
+    row(`Controller ${c}`, "") +
+    row("Console USB", usb + sof) +
+    row(
+      "Console poll",
+      `${status.pollUsLast} us (avg ${status.pollUsAvg} us)`,
+    ) +
+    row(
+      "Reports sent / skipped",
+      rates
+        ? `${rates.sent.toFixed(0)} / ${rates.skipped.toFixed(0)} /s`
+        : `${status.framesSent} / ${status.framesSkipped}`,
+    ) +
+    row(
+      "Master worst case",
+      `report ${status.reportMaxUs} us, loop ${status.loopMaxUs} us`,
+    ) +
+    row("Scheduled late (max)", `${status.schedLateMaxUs} us`) +
+    row("Data age", `avg ${status.ageAvgUs} us, max ${status.ageMaxUs} us`) +
+    row("Data age histogram", ageHistogram(status.ageHist)) +
+    row("Boot -> first report", bootMs(status.bootReportMs)) +
+    row(
+      `Output report #${status.outReportSeq}`,
+      status.outReportLen
+        ? `id ${status.outReportId}: ${hex(status.outReport, status.outReportLen)}`
+        : "-",
+    );
+  render();
+}
+
+function onProfile(msg: Extract<TelemetryMessage, { kind: "profile" }>) {
+  const { profile } = msg;
+  const c = profile.controller;
+  masterProfile[c] = profile;
+  profileHtml[c] =
+    row("Console poll interval (1s)", histogram(profile.poll)) +
+    row("Report queued -> fetched", histogram(profile.queue)) +
+    row("Sends skipped (busy)", `${profile.skipped}`);
+  render();
+}
+
+function percent(n: number, of: number) {
+  return of ? `${((100 * n) / of).toFixed(2)}%` : "-";
+}
+
+function onLinkTest(msg: Extract<TelemetryMessage, { kind: "linkTest" }>) {
+  const r = msg.report;
+  const c = r.controller;
+  masterLinkTest[c] = r;
+  const seconds = r.windowUs / 1e6 || 1;
+  const mode =
+    Object.keys(LINK_TEST_MODES).find(
+      (k) => LINK_TEST_MODES[k as keyof typeof LINK_TEST_MODES] === r.mode,
+    ) ?? `${r.mode}`;
+  const errors = r.transactions - r.ok;
+  linkTestHtml[c] =
+    row(
+      `Link test ${c}`,
+      `${(r.baud / 1000).toFixed(0)} kHz, ${r.len} bytes, ${mode}, ` +
+        (r.rateHz ? `${r.rateHz} /s` : "back to back"),
+    ) +
+    row(
+      "Transactions",
+      `${(r.transactions / seconds).toFixed(0)} /s, ` +
+        `${((r.ok * r.len) / seconds / 1000).toFixed(1)} kB/s`,
+    ) +
+    row(
+      "Errors / NAK / timeout",
+      `${percent(errors, r.transactions)} / ` +
+        `${percent(r.nak, r.transactions)} / ${r.timeout}, ` +
+        `bad data ${r.badData}`,
+    ) +
+    row(
+      "Latency p50 / p90 / p99 / max",
+      `${r.latP50Us} / ${r.latP90Us} / ${r.latP99Us} / ${r.latMaxUs} us`,
+    ) +
+    row("Slave writes ok / bad", `${r.slaveRxOk} / ${r.slaveRxBad}`);
+  render();
+}
+
+function onTrace(msg: Extract<TelemetryMessage, { kind: "trace" }>) {
+  for (const listener of traceListeners) listener(msg.trace);
+}
+
+function onSync(msg: Extract<TelemetryMessage, { kind: "sync" }>) {
+  deviceClock.addSample(msg.reply, msg.receivedUs);
+  const { rttUs, offsetUs } = deviceClock;
+  syncHtml = row(
+    "Clock sync",
+    `rtt ${rttUs.toFixed(0)} us, offset ${offsetUs.toFixed(0)} us`,
+  );
+  render();
+}
+
+worker.onmessage = (e: MessageEvent<TelemetryMessage>) => {
+  if (e.data.kind === "master") onMaster(e.data);
+  else if (e.data.kind === "profile") onProfile(e.data);
+  else if (e.data.kind === "trace") onTrace(e.data);
+  else if (e.data.kind === "linkTest") onLinkTest(e.data);
+  else if (e.data.kind === "sync") onSync(e.data);
+  else onBatch(e.data);
+};
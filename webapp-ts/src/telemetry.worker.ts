@@ -0,0 +1,198 @@
+// Decodes the slave -> host CDC stream off the main thread.
+// Input:  { chunk: ArrayBuffer (transferred), receivedUs: host time }
+// Output: TelemetryMessage. Counters/events/text are batched every
+// POST_INTERVAL_MS; master status / profile / trace / link test blocks and
+// clock sync replies are forwarded as soon as they arrive.
+import {
+  D_EVENTS,
+  D_LINK_TEST,
+  D_MASTER_PROFILE,
+  D_MASTER_STATUS,
+  D_SYNC,
+  D_TELEM,
+  D_TRACE,
+  FrameDecoder,
+  LINK_TEST_LEN,
+  MASTER_PROFILE_LEN,
+  MASTER_STATUS_LEN,
+  SYNC_LEN,
+  TELEM_LEN,
+  TRACE_LEN,
+  parseEvents,
+  parseLinkTest,
+  parseMasterProfile,
+  parseMasterStatus,
+  parseSync,
+  parseTelemetry,
+  parseTrace,
+  type LinkTestReport,
+  type MasterProfile,
+  type MasterStatus,
+  type ReportTrace,
+  type SyncReply,
+  type Telemetry,
+  type TelemetryEvent,
+} from "./protocol";
+
+export type TelemetryRates = {
+  rdreq: number;
+  hostFrames: number;
+  parseErr: number;
+  drops: number;
+  stop: number;
+};
+
+export type MasterRates = {
+  sent: number;
+  skipped: number;
+};
+
+export type TelemetryMessage =
+  | {
+      kind: "batch";
+      telemetry: Telemetry | null;
+      rates: TelemetryRates | null;
+      events: TelemetryEvent[];
+      lines: string[];
+      crcErrors: number;
+    }
+  | {
+      kind: "master";
+      status: MasterStatus;
+      rates: MasterRates | null;
+    }
+  | { kind: "profile"; profile: MasterProfile }
+  | { kind: "trace"; trace: ReportTrace }
+  | { kind: "linkTest"; report: LinkTestReport }
+  | {
+      kind: "sync";
+      reply: SyncReply;
+      // host time the chunk holding the reply was read
+      receivedUs: number;
+    };
+
+const POST_INTERVAL_MS = 250;
+
+let last: Telemetry | null = null;
+let rates: TelemetryRates | null = null;
+let pendingEvents: TelemetryEvent[] = [];
+let pendingLines: string[] = [];
+let crcErrors = 0;
+let dirty = false;
+
+const lastMaster = new Map<number, MasterStatus>();
+let chunkReceivedUs = 0;
+
+function perSecond(cur: number, prev: number, dtUs: number) {
+  return ((cur - prev) >>> 0) * (1e6 / dtUs);
+}
+
+const decoder = new FrameDecoder(
+  (type, payload) => {
+    if (type === D_TELEM && payload.byteLength >= TELEM_LEN) {
+      const t = parseTelemetry(payload);
+      if (last) {
+        const dt = (t.tUs - last.tUs) >>> 0;
+        if (dt > 0) {
+          rates = {
+            rdreq: perSecond(t.rdreq, last.rdreq, dt),
+            hostFrames: perSecond(t.hostFrames, last.hostFrames, dt),
+            parseErr: perSecond(t.parseErr, last.parseErr, dt),
+            drops: perSecond(t.drops, last.drops, dt),
+            stop: perSecond(t.stop, last.stop, dt),
+          };
+        }
+      }
+      last = t;
+      dirty = true;
+    } else if (type === D_EVENTS) {
+      pendingEvents.push(...parseEvents(payload));
+      dirty = true;
+    } else if (
+      type === D_MASTER_STATUS &&
+      payload.byteLength >= MASTER_STATUS_LEN
+    ) {
+      const status = parseMasterStatus(payload);
+      const prev = lastMaster.get(status.controller);
+      let masterRates: MasterRates | null = null;
+      if (prev) {
+        const dt = (status.tUs - prev.tUs) >>> 0;
+        if (dt > 0) {
+          masterRates = {
+            sent: perSecond(status.framesSent, prev.framesSent, dt),
+            skipped: perSecond(status.framesSkipped, prev.framesSkipped, dt),
+          };
+        }
+      }
+      lastMaster.set(status.controller, status);
+      const msg: TelemetryMessage = {
+        kind: "master",
+        status,
+        rates: masterRates,
+      };
+      self.postMessage(msg);
+    } else if (
+      type === D_MASTER_PROFILE &&
+      payload.byteLength >= MASTER_PROFILE_LEN
+    ) {
+      const msg: TelemetryMessage = {
+        kind: "profile",
+        profile: parseMasterProfile(payload),
+      };
+      self.postMessage(msg);
+    } else if (type === D_TRACE && payload.byteLength >= TRACE_LEN) {
+      const msg: TelemetryMessage = {
+        kind: "trace",
+        trace: parseTrace(payload),
+      };
+      self.postMessage(msg);
+    } else if (
+      type === D_LINK_TEST &&
+      payload.byteLength >= LINK_TEST_LEN
+    ) {
+      const msg: TelemetryMessage = {
+        kind: "linkTest",
+        report: parseLinkTest(payload),
+      };
+      self.postMessage(msg);
+    } else if (type === D_SYNC && payload.byteLength >= SYNC_LEN) {
+      const msg: TelemetryMessage = {
+        kind: "sync",
+        reply: parseSync(payload),
+        receivedUs: chunkReceivedUs,
+      };
+      self.postMessage(msg);
+    }
+  },
+  (line) => {
+    pendingLines.push(line);
+    dirty = true;
+  },
+  () => {
+    crcErrors++;
+    dirty = true;
+  },
+);
+
+self.onmessage = (
+  e: MessageEvent<{ chunk: ArrayBuffer; receivedUs: number }>,
+) => {
+  chunkReceivedUs = e.data.receivedUs;
+  decoder.push(new Uint8Array(e.data.chunk));
+};
+
+setInterval(() => {
+  if (!dirty) return;
+  dirty = false;
+  const msg: TelemetryMessage = {
+    kind: "batch",
+    telemetry: last,
+    rates,
+    events: pendingEvents,
+    lines: pendingLines,
+    crcErrors,
+  };
+  pendingEvents = [];
+  pendingLines = [];
+  self.postMessage(msg);
+}, POST_INTERVAL_MS);
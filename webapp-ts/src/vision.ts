@@ -0,0 +1,256 @@
+// Camera probes for automation scripts. Frames are evaluated in
+// vision.worker.ts, every probe is updated once per video frame.
+//
+//   const vision = new Vision(videoElement);
+//   vision.probe("hp", { kind: "region", x: 100, y: 40, w: 30, h: 6 });
+//   await vision.waitFor("hp", (p) => p.g > 200);
+import type { VisionMessage, VisionRequest } from "./vision.worker";
+import {
+  PROBE_PIXEL,
+  PROBE_REGION,
+  PROBE_TEMPLATE,
+  PROBE_WORDS,
+  RESULT_WORDS,
+} from "./visionKernel";
+
+export type Rgb = { r: number; g: number; b: number };
+
+export type ProbeSpec =
+  | { kind: "pixel"; x: number; y: number }
+  | { kind: "region"; x: number; y: number; w: number; h: number }
+  | {
+      // best match of template inside the (x, y, w, h) search window
+      kind: "template";
+      x: number;
+      y: number;
+      w: number;
+      h: number;
+      template: ImageData;
+    };
+
+export type ProbeResult = Rgb & {
+  // template: mean absolute difference per channel (0 = exact match)
+  score: number;
+  // pixel/region: clipped position, template: best match position
+  x: number;
+  y: number;
+  // frame capture time (ms, video timeline) and host clock ms it was read
+  timestamp: number;
+  receivedMs: number;
+};
+
+type TrackProcessor = new (init: { track: MediaStreamTrack }) => {
+  readable: ReadableStream<VideoFrame>;
+};
+
+export function colorDistance(a: Rgb, b: Rgb) {
+  return Math.sqrt((a.r - b.r) ** 2 + (a.g - b.g) ** 2 + (a.b - b.b) ** 2);
+}
+
+export class Vision {
+  private worker: Worker;
+  private specs = new Map<string, ProbeSpec>();
+  private templateIds = new Map<ImageData, number>();
+  private nextTemplateId = 1;
+  private nextWaitId = 1;
+  private order: string[] = [];
+  private version = 0;
+  private latest = new Map<string, ProbeResult>();
+  private listeners: ((vision: Vision) => void)[] = [];
+  kernel = "";
+
+  constructor(video: HTMLVideoElement) {
+    this.worker = new Worker(new URL("./vision.worker.ts", import.meta.url), {
+      type: "module",
+    });
+    this.worker.onmessage = (e: MessageEvent<VisionMessage>) =>
+      this.onMessage(e.data);
+    this.attach(video);
+  }
+
+  private request(msg: VisionRequest, transfer: Transferable[] = []) {
+    this.worker.postMessage(msg, transfer);
+  }
+
+  private attach(video: HTMLVideoElement) {
+    const stream = video.srcObject;
+    const track =
+      stream instanceof MediaStream ? stream.getVideoTracks()[0] : undefined;
+    const Processor = (
+      globalThis as typeof globalThis & {
+        MediaStreamTrackProcessor?: TrackProcessor;
+      }
+    ).MediaStreamTrackProcessor;
+    if (track && Processor) {
+      const { readable } = new Processor({ track });
+      this.request({ kind: "frames", readable }, [readable]);
+      return;
+    }
+
+    // no MediaStreamTrackProcessor: one bitmap per presented video frame
+    const pump = async (_: number, meta: VideoFrameCallbackMetadata) => {
+      if (video.videoWidth) {
+        const bitmap = await createImageBitmap(video);
+        const timestamp = meta.captureTime ?? meta.presentationTime;
+        this.request({ kind: "bitmap", bitmap, timestamp }, [bitmap]);
+      }
+      video.requestVideoFrameCallback(pump);
+    };
+    video.requestVideoFrameCallback(pump);
+  }
+
+  private onMessage(msg: VisionMessage) {
+    if (msg.kind === "ready") {
+      this.kernel = msg.kernel;
+      return;
+    }
+    // results for an older probe set
+    if (msg.version !== this.version) return;
+    const f32 = new Float32Array(msg.results);
+    const i32 = new Int32Array(msg.results);
+    this.order.forEach((id, i) => {
+      const o = i * RESULT_WORDS;
+      this.latest.set(id, {
+        r: f32[o],
+        g: f32[o + 1],
+        b: f32[o + 2],
+        score: f32[o + 3],
+        x: i32[o + 4],
+        y: i32[o + 5],
+        timestamp: msg.timestamp,
+        receivedMs: msg.receivedMs,
+      });
+    });
+    for (const listener of this.listeners) listener(this);
+  }
+
+  private templateId(template: ImageData) {
+    let id = this.templateIds.get(template);
+    if (id === undefined) {
+      id = this.nextTemplateId++;
+      this.templateIds.set(template, id);
+      const data = template.data.slice().buffer;
+      this.request(
+        {
+          kind: "template",
+          id,
+          width: template.width,
+          height: template.height,
+          data,
+        },
+        [data],
+      );
+    }
+    return id;
+  }
+
+  private sync() {
+    this.order = [...this.specs.keys()];
+    const probes = new Int32Array(this.order.length * PROBE_WORDS);
+    const used = new Set<ImageData>();
+    this.order.forEach((id, i) => {
+      const spec = this.specs.get(id)!;
+      const o = i * PROBE_WORDS;
+      probes[o + 1] = spec.x;
+      probes[o + 2] = spec.y;
+      if (spec.kind === "pixel") {
+        probes[o] = PROBE_PIXEL;
+        return;
+      }
+      probes[o] = spec.kind === "region" ? PROBE_REGION : PROBE_TEMPLATE;
+      probes[o + 3] = spec.w;
+      probes[o + 4] = spec.h;
+      if (spec.kind === "template") {
+        used.add(spec.template);
+        probes[o + 5] = this.templateId(spec.template);
+        probes[o + 6] = spec.template.width;
+        probes[o + 7] = spec.template.height;
+      }
+    });
+    for (const [template, id] of this.templateIds) {
+      if (used.has(template)) continue;
+      this.templateIds.delete(template);
+      this.request({ kind: "deleteTemplate", id });
+    }
+    this.version++;
+    this.request(
+      {
+        kind: "probes",
+        version: this.version,
+        probes,
+        count: this.order.length,
+      },
+      [probes.buffer],
+    );
+  }
+
+  // Adds or replaces a probe. Results start with the next frame.
+  probe(id: string, spec: ProbeSpec) {
+    this.specs.set(id, spec);
+    this.latest.delete(id);
+    this.sync();
+  }
+
+  remove(id: string) {
+    if (!this.specs.delete(id)) return;
+    this.latest.delete(id);
+    this.sync();
+  }
+
+  get(id: string) {
+    return this.latest.get(id) ?? null;
+  }
+
+  // Called after every processed frame, returns an unsubscribe function.
+  onFrame(listener: (vision: Vision) => void) {
+    this.listeners.push(listener);
+    return () => {
+      this.listeners = this.listeners.filter((l) => l !== listener);
+    };
+  }
+
+  // Resolves with the first result of probe id that satisfies predicate.
+  waitFor(
+    id: string,
+    predicate: (result: ProbeResult) => boolean,
+    timeoutMs = Infinity,
+  ) {
+    return new Promise<ProbeResult>((resolve, reject) => {
+      let timer: number | undefined;
+      const off = this.onFrame(() => {
+        const result = this.get(id);
+        if (!result || !predicate(result)) return;
+        off();
+        clearTimeout(timer);
+        resolve(result);
+      });
+      if (Number.isFinite(timeoutMs)) {
+        timer = window.setTimeout(() => {
+          off();
+          reject(new Error(`vision: timeout waiting for ${id}`));
+        }, timeoutMs);
+      }
+    });
+  }
+
+  // Uses a temporary pixel probe, removed once the color matched.
+  async waitForColor(
+    x: number,
+    y: number,
+    target: Rgb,
+    tolerance = 30,
+    timeoutMs = Infinity,
+  ) {
+    const id = `waitForColor:${this.nextWaitId++}`;
+    this.probe(id, { kind: "pixel", x, y });
+    try {
+      return await this.waitFor(
+        id,
+        (p) => colorDistance(p, target) <= tolerance,
+        timeoutMs,
+      );
+    } finally {
+      this.remove(id);
+    }
+  }
+}
@@ -0,0 +1,154 @@
+// Evaluates image probes on every camera frame, off the page's main thread.
+// Input:  VisionRequest. Frames arrive as a ReadableStream<VideoFrame>
+//         (MediaStreamTrackProcessor) or one ImageBitmap per frame.
+// Output: VisionMessage. One "results" message per processed frame.
+// Only the bounding box of all probes is read back from the frame.
+import { hostMicros } from "./clock";
+import {
+  loadKernel,
+  PROBE_PIXEL,
+  PROBE_WORDS,
+  type VisionKernel,
+} from "./visionKernel";
+
+export type VisionRequest =
+  | { kind: "frames"; readable: ReadableStream<VideoFrame> }
+  | { kind: "bitmap"; bitmap: ImageBitmap; timestamp: number }
+  | { kind: "probes"; version: number; probes: Int32Array; count: number }
+  | {
+      kind: "template";
+      id: number;
+      width: number;
+      height: number;
+      data: ArrayBuffer;
+    }
+  | { kind: "deleteTemplate"; id: number };
+
+export type VisionMessage =
+  | { kind: "ready"; kernel: string }
+  | {
+      kind: "results";
+      version: number;
+      timestamp: number; // ms, frame capture time when known
+      receivedMs: number; // host clock ms the frame reached the worker
+      results: ArrayBuffer; // count * RESULT_WORDS
+    };
+
+let kernel: VisionKernel | null = null;
+let probes = new Int32Array(0);
+let count = 0;
+let version = 0;
+let canvas: OffscreenCanvas | null = null;
+let context: OffscreenCanvasRenderingContext2D | null = null;
+
+const kernelReady = loadKernel(
+  new URL("/vision.wasm", self.location.origin).href,
+).then((k) => {
+  kernel = k;
+  self.postMessage({ kind: "ready", kernel: k.name } satisfies VisionMessage);
+});
+
+// Union of all probe rectangles, clipped to the frame.
+function probeBounds(width: number, height: number) {
+  let x0 = width;
+  let y0 = height;
+  let x1 = 0;
+  let y1 = 0;
+  for (let i = 0; i < count; i++) {
+    const o = i * PROBE_WORDS;
+    const pixel = probes[o] === PROBE_PIXEL;
+    x0 = Math.min(x0, probes[o + 1]);
+    y0 = Math.min(y0, probes[o + 2]);
+    x1 = Math.max(x1, probes[o + 1] + (pixel ? 1 : probes[o + 3]));
+    y1 = Math.max(y1, probes[o + 2] + (pixel ? 1 : probes[o + 4]));
+  }
+  x0 = Math.max(0, x0);
+  y0 = Math.max(0, y0);
+  x1 = Math.min(width, x1);
+  y1 = Math.min(height, y1);
+  if (x1 <= x0 || y1 <= y0) return null;
+  return { x: x0, y: y0, w: x1 - x0, h: y1 - y0 };
+}
+
+function process(
+  source: CanvasImageSource,
+  width: number,
+  height: number,
+  timestamp: number,
+) {
+  if (!kernel || count === 0) return;
+  const receivedMs = hostMicros() / 1000;
+  const box = probeBounds(width, height);
+  if (!box) return;
+
+  if (!canvas || canvas.width < box.w || canvas.height < box.h) {
+    canvas = new OffscreenCanvas(box.w, box.h);
+    context = canvas.getContext("2d", { willReadFrequently: true });
+  }
+  if (!context) return;
+  context.drawImage(source, box.x, box.y, box.w, box.h, 0, 0, box.w, box.h);
+  const data = context.getImageData(0, 0, box.w, box.h).data;
+
+  const results = kernel.run(
+    { data, ox: box.x, oy: box.y, width: box.w, height: box.h },
+    probes,
+    count,
+  );
+  const msg: VisionMessage = {
+    kind: "results",
+    version,
+    timestamp,
+    receivedMs,
+    results,
+  };
+  self.postMessage(msg, { transfer: [results] });
+}
+
+async function readFrames(readable: ReadableStream<VideoFrame>) {
+  await kernelReady;
+  const reader = readable.getReader();
+  while (true) {
+    const { value: frame, done } = await reader.read();
+    if (done) break;
+    try {
+      process(
+        frame,
+        frame.displayWidth,
+        frame.displayHeight,
+        frame.timestamp / 1000,
+      );
+    } finally {
+      frame.close();
+    }
+  }
+}
+
+self.onmessage = (e: MessageEvent<VisionRequest>) => {
+  const msg = e.data;
+  switch (msg.kind) {
+    case "frames":
+      readFrames(msg.readable);
+      break;
+    case "bitmap":
+      process(msg.bitmap, msg.bitmap.width, msg.bitmap.height, msg.timestamp);
+      msg.bitmap.close();
+      break;
+    case "probes":
+      probes = msg.probes;
+      count = msg.count;
+      version = msg.version;
+      break;
+    case "template":
+      kernelReady.then(() =>
+        kernel?.setTemplate(msg.id, {
+          width: msg.width,
+          height: msg.height,
+          data: new Uint8Array(msg.data),
+        }),
+      );
+      break;
+    case "deleteTemplate":
+      kernelReady.then(() => kernel?.deleteTemplate(msg.id));
+      break;
+  }
+};
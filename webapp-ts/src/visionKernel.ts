@@ -0,0 +1,282 @@
+// Probe evaluation for vision.worker.ts. Uses vision/vision.cpp compiled to
+// WebAssembly (public/vision.wasm, built by vision/build.sh) and falls back
+// to the same algorithms in plain TS when the module is missing.
+//
+// Probe and result records are 8 x 32 bit words, laid out like the structs
+// in vision.cpp.
+
+export const PROBE_PIXEL = 0;
+export const PROBE_REGION = 1;
+export const PROBE_TEMPLATE = 2;
+
+export const PROBE_WORDS = 8; // kind, x, y, w, h, tmpl, tw, th
+export const RESULT_WORDS = 8; // r, g, b, score (f32), x, y (i32), pad
+
+export type Template = { width: number; height: number; data: Uint8Array };
+
+// Crop of the current frame; (ox, oy) is the frame position of data[0].
+export type FrameCrop = {
+  data: Uint8ClampedArray;
+  ox: number;
+  oy: number;
+  width: number;
+  height: number;
+};
+
+export interface VisionKernel {
+  readonly name: string;
+  setTemplate(id: number, template: Template): void;
+  deleteTemplate(id: number): void;
+  // probes: count * PROBE_WORDS, word 5 is the template id.
+  // Returns count * RESULT_WORDS (view it as Float32 and Int32).
+  run(frame: FrameCrop, probes: Int32Array, count: number): ArrayBuffer;
+}
+
+type VisionExports = {
+  memory: WebAssembly.Memory;
+  vision_alloc(bytes: number): number;
+  vision_reset(): void;
+  vision_run(
+    rgba: number,
+    stride: number,
+    ox: number,
+    oy: number,
+    width: number,
+    height: number,
+    probes: number,
+    count: number,
+    results: number,
+  ): void;
+};
+
+class WasmKernel implements VisionKernel {
+  readonly name = "wasm-simd";
+  private exports: VisionExports;
+  private templates = new Map<number, Template>();
+  private templatePtr = new Map<number, number>();
+  private frameBytes = 0;
+  private probeCount = 0;
+  private framePtr = 0;
+  private probePtr = 0;
+  private resultPtr = 0;
+
+  constructor(exports: VisionExports) {
+    this.exports = exports;
+  }
+
+  setTemplate(id: number, template: Template) {
+    this.templates.set(id, template);
+    this.layout(this.frameBytes, this.probeCount, true);
+  }
+
+  deleteTemplate(id: number) {
+    if (this.templates.delete(id)) {
+      this.layout(this.frameBytes, this.probeCount, true);
+    }
+  }
+
+  // Everything lives in one bump arena; it is rebuilt when something has to
+  // grow, which only happens when the probe set or the crop size changes.
+  private layout(frameBytes: number, probeCount: number, force = false) {
+    if (
+      !force &&
+      frameBytes <= this.frameBytes &&
+      probeCount <= this.probeCount
+    ) {
+      return;
+    }
+    const e = this.exports;
+    e.vision_reset();
+    this.frameBytes = Math.max(frameBytes, this.frameBytes);
+    this.probeCount = Math.max(probeCount, this.probeCount);
+    this.framePtr = e.vision_alloc(this.frameBytes);
+    this.probePtr = e.vision_alloc(this.probeCount * PROBE_WORDS * 4);
+    this.resultPtr = e.vision_alloc(this.probeCount * RESULT_WORDS * 4);
+    this.templatePtr.clear();
+    for (const [id, t] of this.templates) {
+      const ptr = e.vision_alloc(t.data.length);
+      new Uint8Array(e.memory.buffer, ptr, t.data.length).set(t.data);
+      this.templatePtr.set(id, ptr);
+    }
+    if (!this.framePtr || !this.probePtr || !this.resultPtr) {
+      throw new Error("vision: out of memory");
+    }
+  }
+
+  run(frame: FrameCrop, probes: Int32Array, count: number) {
+    this.layout(frame.data.length, count);
+    const e = this.exports;
+    new Uint8Array(e.memory.buffer, this.framePtr, frame.data.length).set(
+      frame.data,
+    );
+    const p = new Int32Array(
+      e.memory.buffer,
+      this.probePtr,
+      count * PROBE_WORDS,
+    );
+    p.set(probes.subarray(0, count * PROBE_WORDS));
+    for (let i = 0; i < count; i++) {
+      const o = i * PROBE_WORDS;
+      if (p[o] === PROBE_TEMPLATE) {
+        p[o + 5] = this.templatePtr.get(probes[o + 5]) ?? 0;
+        if (!p[o + 5]) p[o + 6] = p[o + 7] = 0; // unknown template
+      }
+    }
+    e.vision_run(
+      this.framePtr,
+      frame.width,
+      frame.ox,
+      frame.oy,
+      frame.width,
+      frame.height,
+      this.probePtr,
+      count,
+      this.resultPtr,
+    );
+    const bytes = count * RESULT_WORDS * 4;
+    return e.memory.buffer.slice(this.resultPtr, this.resultPtr + bytes);
+  }
+}
+
+class JsKernel implements VisionKernel {
+  readonly name = "js";
+  private templates = new Map<number, Template>();
+
+  setTemplate(id: number, template: Template) {
+    this.templates.set(id, template);
+  }
+
+  deleteTemplate(id: number) {
+    this.templates.delete(id);
+  }
+
+  run(frame: FrameCrop, probes: Int32Array, count: number) {
+    const buf = new ArrayBuffer(count * RESULT_WORDS * 4);
+    const f32 = new Float32Array(buf);
+    const i32 = new Int32Array(buf);
+    for (let i = 0; i < count; i++) {
+      const o = i * PROBE_WORDS;
+      const r = i * RESULT_WORDS;
+      const kind = probes[o];
+      if (kind === PROBE_PIXEL) {
+        const clip = clipRect(frame, probes[o + 1], probes[o + 2], 1, 1);
+        if (!clip) continue;
+        const at = pixelOffset(frame, clip.x, clip.y);
+        f32[r] = frame.data[at];
+        f32[r + 1] = frame.data[at + 1];
+        f32[r + 2] = frame.data[at + 2];
+        i32[r + 4] = clip.x;
+        i32[r + 5] = clip.y;
+      } else if (kind === PROBE_REGION) {
+        regionAverage(frame, probes, o, f32, i32, r);
+      } else if (kind === PROBE_TEMPLATE) {
+        templateMatch(frame, probes, o, this.templates, f32, i32, r);
+      }
+    }
+    return buf;
+  }
+}
+
+function clipRect(
+  frame: FrameCrop,
+  x: number,
+  y: number,
+  w: number,
+  h: number,
+) {
+  const x0 = Math.max(x, frame.ox);
+  const y0 = Math.max(y, frame.oy);
+  const x1 = Math.min(x + w, frame.ox + frame.width);
+  const y1 = Math.min(y + h, frame.oy + frame.height);
+  if (x1 <= x0 || y1 <= y0) return null;
+  return { x: x0, y: y0, w: x1 - x0, h: y1 - y0 };
+}
+
+function probeRect(frame: FrameCrop, probes: Int32Array, o: number) {
+  const [x, y, w, h] = probes.subarray(o + 1, o + 5);
+  return clipRect(frame, x, y, w, h);
+}
+
+function pixelOffset(frame: FrameCrop, x: number, y: number) {
+  return ((y - frame.oy) * frame.width + (x - frame.ox)) * 4;
+}
+
+function regionAverage(
+  frame: FrameCrop,
+  probes: Int32Array,
+  o: number,
+  f32: Float32Array,
+  i32: Int32Array,
+  r: number,
+) {
+  const c = probeRect(frame, probes, o);
+  if (!c) return;
+  let sr = 0;
+  let sg = 0;
+  let sb = 0;
+  for (let y = c.y; y < c.y + c.h; y++) {
+    let at = pixelOffset(frame, c.x, y);
+    for (let x = 0; x < c.w; x++, at += 4) {
+      sr += frame.data[at];
+      sg += frame.data[at + 1];
+      sb += frame.data[at + 2];
+    }
+  }
+  const n = c.w * c.h;
+  f32[r] = sr / n;
+  f32[r + 1] = sg / n;
+  f32[r + 2] = sb / n;
+  i32[r + 4] = c.x;
+  i32[r + 5] = c.y;
+}
+
+function templateMatch(
+  frame: FrameCrop,
+  probes: Int32Array,
+  o: number,
+  templates: Map<number, Template>,
+  f32: Float32Array,
+  i32: Int32Array,
+  r: number,
+) {
+  const t = templates.get(probes[o + 5]);
+  const c = probeRect(frame, probes, o);
+  f32[r + 3] = 255;
+  if (!t || !c || c.w < t.width || c.h < t.height) return;
+
+  let best = Infinity;
+  let bx = c.x;
+  let by = c.y;
+  for (let cy = c.y; cy + t.height <= c.y + c.h; cy++) {
+    for (let cx = c.x; cx + t.width <= c.x + c.w; cx++) {
+      let sad = 0;
+      for (let row = 0; row < t.height && sad < best; row++) {
+        let a = pixelOffset(frame, cx, cy + row);
+        let b = row * t.width * 4;
+        for (let x = 0; x < t.width; x++, a += 4, b += 4) {
+          sad +=
+            Math.abs(frame.data[a] - t.data[b]) +
+            Math.abs(frame.data[a + 1] - t.data[b + 1]) +
+            Math.abs(frame.data[a + 2] - t.data[b + 2]);
+        }
+      }
+      if (sad < best) {
+        best = sad;
+        bx = cx;
+        by = cy;
+      }
+    }
+  }
+  f32[r + 3] = best / (t.width * t.height * 3);
+  i32[r + 4] = bx;
+  i32[r + 5] = by;
+}
+
+export async function loadKernel(url: string): Promise<VisionKernel> {
+  try {
+    const { instance } = await WebAssembly.instantiateStreaming(fetch(url));
+    return new WasmKernel(instance.exports as unknown as VisionExports);
+  } catch {
+    return new JsKernel();
+  }
+}
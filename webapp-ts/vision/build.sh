@@ -0,0 +1,12 @@
+#!/bin/sh
+# Builds public/vision.wasm from vision.cpp.
+# Needs clang with the wasm32 target (LLVM >= 13), no emscripten/libc.
+# Without public/vision.wasm the app falls back to src/visionKernel.ts.
+set -e
+cd "$(dirname "$0")"
+mkdir -p ../public
+${CLANG:-clang} --target=wasm32 -O3 -msimd128 -nostdlib -fno-exceptions -fno-rtti \
+    -std=c++17 -Wall -Wextra \
+    -Wl,--no-entry -Wl,--export-dynamic -Wl,--strip-all \
+    -o ../public/vision.wasm vision.cpp
+echo "wrote public/vision.wasm ($(wc -c < ../public/vision.wasm) bytes)"
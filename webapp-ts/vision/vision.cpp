@@ -0,0 +1,238 @@
+// Image probes for camera driven scripts, compiled to WebAssembly (see
+// build.sh). Freestanding: no libc, memory is handed out by vision_alloc()
+// and owned by src/vision.worker.ts.
+//
+// A frame is RGBA8, `stride` pixels per row. Probes and results are fixed
+// size records shared with src/visionKernel.ts (PROBE_WORDS/RESULT_WORDS).
+
+#include <stdint.h>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+#define EXPORT extern "C" __attribute__((visibility("default")))
+
+extern "C" uint8_t __heap_base; // end of static data, set by wasm-ld
+
+namespace
+{
+    enum ProbeKind : uint32_t
+    {
+        PROBE_PIXEL = 0,    // rgb at (x, y)
+        PROBE_REGION = 1,   // average rgb over (x, y, w, h)
+        PROBE_TEMPLATE = 2, // best match of a template inside (x, y, w, h)
+    };
+
+    struct Probe
+    {
+        uint32_t kind;
+        int32_t x, y, w, h;
+        uint32_t tmpl; // PROBE_TEMPLATE: offset of the RGBA template
+        uint32_t tw, th;
+    };
+
+    struct Result
+    {
+        float r, g, b;
+        float score; // template: mean absolute difference per channel, 0 = exact
+        int32_t x, y;
+        uint32_t pad[2];
+    };
+
+    static_assert(sizeof(Probe) == 32, "Probe layout is shared with TS");
+    static_assert(sizeof(Result) == 32, "Result layout is shared with TS");
+
+    struct Frame
+    {
+        const uint8_t *rgba;
+        uint32_t stride; // pixels
+        int32_t ox, oy;  // frame position of rgba[0] (crop origin)
+        int32_t width, height;
+
+        const uint8_t *at(int32_t x, int32_t y) const
+        {
+            return rgba + ((uint32_t)(y - oy) * stride + (uint32_t)(x - ox)) * 4u;
+        }
+    };
+
+    uintptr_t heap_top = 0;
+
+    inline int32_t clamp(int32_t v, int32_t lo, int32_t hi)
+    {
+        return v < lo ? lo : (v > hi ? hi : v);
+    }
+
+    // Clip (x, y, w, h) to the frame, returns false when nothing is left.
+    bool clip(const Frame &f, int32_t &x, int32_t &y, int32_t &w, int32_t &h)
+    {
+        int32_t x1 = clamp(x + w, f.ox, f.ox + f.width);
+        int32_t y1 = clamp(y + h, f.oy, f.oy + f.height);
+        x = clamp(x, f.ox, f.ox + f.width);
+        y = clamp(y, f.oy, f.oy + f.height);
+        w = x1 - x;
+        h = y1 - y;
+        return w > 0 && h > 0;
+    }
+
+    void region_average(const Frame &f, const Probe &p, Result &out)
+    {
+        int32_t x = p.x, y = p.y, w = p.w, h = p.h;
+        if (!clip(f, x, y, w, h))
+            return;
+
+        uint32_t sr = 0, sg = 0, sb = 0;
+        for (int32_t row = 0; row < h; row++)
+        {
+            const uint8_t *px = f.at(x, y + row);
+            int32_t i = 0;
+#ifdef __wasm_simd128__
+            const v128_t mask = wasm_i32x4_splat(0xFF);
+            v128_t ar = wasm_i32x4_splat(0), ag = ar, ab = ar;
+            for (; i + 4 <= w; i += 4)
+            {
+                v128_t v = wasm_v128_load(px + i * 4);
+                ar = wasm_i32x4_add(ar, wasm_v128_and(v, mask));
+                ag = wasm_i32x4_add(ag, wasm_v128_and(wasm_u32x4_shr(v, 8), mask));
+                ab = wasm_i32x4_add(ab, wasm_v128_and(wasm_u32x4_shr(v, 16), mask));
+            }
+            sr += wasm_u32x4_extract_lane(ar, 0) + wasm_u32x4_extract_lane(ar, 1) +
+                  wasm_u32x4_extract_lane(ar, 2) + wasm_u32x4_extract_lane(ar, 3);
+            sg += wasm_u32x4_extract_lane(ag, 0) + wasm_u32x4_extract_lane(ag, 1) +
+                  wasm_u32x4_extract_lane(ag, 2) + wasm_u32x4_extract_lane(ag, 3);
+            sb += wasm_u32x4_extract_lane(ab, 0) + wasm_u32x4_extract_lane(ab, 1) +
+                  wasm_u32x4_extract_lane(ab, 2) + wasm_u32x4_extract_lane(ab, 3);
+#endif
+            for (; i < w; i++)
+            {
+                sr += px[i * 4 + 0];
+                sg += px[i * 4 + 1];
+                sb += px[i * 4 + 2];
+            }
+        }
+        float n = (float)w * (float)h;
+        out.r = (float)sr / n;
+        out.g = (float)sg / n;
+        out.b = (float)sb / n;
+        out.x = x;
+        out.y = y;
+    }
+
+    // Sum of absolute differences of one template row (alpha ignored).
+    uint32_t row_sad(const uint8_t *a, const uint8_t *b, uint32_t pixels)
+    {
+        uint32_t sad = 0;
+        uint32_t i = 0;
+#ifdef __wasm_simd128__
+        const v128_t rgb = wasm_i32x4_splat(0x00FFFFFF);
+        v128_t acc = wasm_i32x4_splat(0);
+        for (; i + 4 <= pixels; i += 4)
+        {
+            v128_t va = wasm_v128_load(a + i * 4);
+            v128_t vb = wasm_v128_load(b + i * 4);
+            v128_t d = wasm_v128_or(wasm_u8x16_sub_sat(va, vb), wasm_u8x16_sub_sat(vb, va));
+            d = wasm_v128_and(d, rgb);
+            acc = wasm_i32x4_add(acc, wasm_u32x4_extadd_pairwise_u16x8(wasm_u16x8_extadd_pairwise_u8x16(d)));
+        }
+        sad = wasm_u32x4_extract_lane(acc, 0) + wasm_u32x4_extract_lane(acc, 1) +
+              wasm_u32x4_extract_lane(acc, 2) + wasm_u32x4_extract_lane(acc, 3);
+#endif
+        for (; i < pixels; i++)
+        {
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                int32_t d = (int32_t)a[i * 4 + c] - (int32_t)b[i * 4 + c];
+                sad += (uint32_t)(d < 0 ? -d : d);
+            }
+        }
+        return sad;
+    }
+
+    void template_match(const Frame &f, const Probe &p, Result &out)
+    {
+        int32_t x = p.x, y = p.y, w = p.w, h = p.h;
+        if (!clip(f, x, y, w, h) || w < (int32_t)p.tw || h < (int32_t)p.th || p.tw == 0 || p.th == 0)
+        {
+            out.score = 255.0f;
+            return;
+        }
+
+        const uint8_t *tmpl = (const uint8_t *)(uintptr_t)p.tmpl;
+        uint32_t best = 0xFFFFFFFFu;
+        int32_t bx = x, by = y;
+        for (int32_t cy = y; cy + (int32_t)p.th <= y + h; cy++)
+        {
+            for (int32_t cx = x; cx + (int32_t)p.tw <= x + w; cx++)
+            {
+                uint32_t sad = 0;
+                // stop as soon as this position is worse than the best so far
+                for (uint32_t row = 0; row < p.th && sad < best; row++)
+                    sad += row_sad(f.at(cx, cy + (int32_t)row), tmpl + row * p.tw * 4u, p.tw);
+                if (sad < best)
+                {
+                    best = sad;
+                    bx = cx;
+                    by = cy;
+                }
+            }
+        }
+        out.score = (float)best / (float)(p.tw * p.th * 3u);
+        out.x = bx;
+        out.y = by;
+    }
+}
+
+// Bump allocator, 16 byte aligned. Returns 0 when memory can't grow.
+EXPORT uint32_t vision_alloc(uint32_t bytes)
+{
+    if (heap_top == 0)
+        heap_top = (uintptr_t)&__heap_base;
+    uintptr_t start = (heap_top + 15u) & ~(uintptr_t)15u;
+    uintptr_t end = start + bytes;
+    uintptr_t have = __builtin_wasm_memory_size(0) * 65536u;
+    if (end > have && __builtin_wasm_memory_grow(0, (end - have + 65535u) / 65536u) == (uintptr_t)-1)
+        return 0;
+    heap_top = end;
+    return (uint32_t)start;
+}
+
+// Releases everything handed out by vision_alloc().
+EXPORT void vision_reset(void)
+{
+    heap_top = 0;
+}
+
+EXPORT void vision_run(const uint8_t *rgba, uint32_t stride, int32_t ox, int32_t oy, int32_t width, int32_t height,
+                       const Probe *probes, uint32_t count, Result *results)
+{
+    const Frame f = {rgba, stride, ox, oy, width, height};
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const Probe &p = probes[i];
+        Result &out = results[i];
+        out = Result{};
+        switch (p.kind)
+        {
+        case PROBE_PIXEL:
+        {
+            int32_t x = p.x, y = p.y, w = 1, h = 1;
+            if (clip(f, x, y, w, h))
+            {
+                const uint8_t *px = f.at(x, y);
+                out.r = px[0];
+                out.g = px[1];
+                out.b = px[2];
+                out.x = x;
+                out.y = y;
+            }
+            break;
+        }
+        case PROBE_REGION:
+            region_average(f, p, out);
+            break;
+        case PROBE_TEMPLATE:
+            template_match(f, p, out);
+            break;
+        }
+    }
+}
@@ -0,0 +1,14 @@
+import { defineConfig } from "vite";
+
+// Cross-origin isolation makes SharedArrayBuffer available to the sender
+// worker (src/sender.ts). Hosting for the built app needs the same headers,
+// without them frames are handed to the worker with postMessage instead.
+const isolation = {
+  "Cross-Origin-Opener-Policy": "same-origin",
+  "Cross-Origin-Embedder-Policy": "require-corp",
+};
+
+export default defineConfig({
+  server: { headers: isolation },
+  preview: { headers: isolation },
+});